@@ -21,11 +21,14 @@
 
 #include <yarp/os/RateThread.h>
 #include <yarp/os/Semaphore.h>
-#include <yarp/os/BufferedPort.h>
+#include <yarp/os/Bottle.h>
+#include <yarp/os/Port.h>
+#include <yarp/os/PortReader.h>
+#include <yarp/os/Portable.h>
+#include <yarp/os/Mutex.h>
 #include <yarp/sig/Matrix.h>
 
 #include<Eigen/Core>
-#include<Eigen/LU>
 
 
 #include "yarpWholeBodyInterface/yarpWbiUtil.h"
@@ -44,6 +47,22 @@ namespace yarpWbi
     const int BASE_VEL_ESTIMATE_SIZE  = 6;
     const int BASE_ACC_ESTIMATE_SIZE  = 6;
 
+    /**
+     * Compute the velocity of the floating base from the velocity of the joints,
+     * assuming that the link of the jacobian is fixed in the world.
+     *
+     * The base velocity solves J_b*v_b = -J_j*dq. With the mixed representation
+     * of the base velocity used by the wbi the base block J_b of the jacobian
+     * is [I X; 0 I], so the system is solved in closed form instead of factorizing J_b.
+     * In debug builds this structure is asserted.
+     *
+     * @param jacobian 6x(6+dof) row major jacobian of the link fixed in the world
+     * @param dof number of joints
+     * @param dq joint velocities
+     * @param base_vel_estimate resulting base velocity (6x1, linear and angular)
+     */
+    void computeBaseVelocityOfFixedLink(const double * jacobian, const int dof, const double * dq, double * base_vel_estimate);
+
     /**
      * Class that performs local estimation of the floating base state (position, velocity, acceleration)
      *
@@ -67,8 +86,6 @@ namespace yarpWbi
 
         Eigen::Matrix<double,6,Eigen::Dynamic,Eigen::RowMajor> complete_jacobian;
 
-        Eigen::PartialPivLU<Eigen::MatrixXd::PlainObject> luDecompositionOfBaseJacobian;
-
     public:
         localFloatingBaseStateEstimator(wbi::iWholeBodyModel * _wholeBodyModel=0, int _dof=0);
 
@@ -106,36 +123,98 @@ namespace yarpWbi
 
 
     /**
-     * Helper class for remoteFloatingBaseStateEstimator, providing a callback to directly
-     * fill remoteFloatingBaseStateEstimator.
+     * Model used by remoteFloatingBaseStateEstimator to propagate the last
+     * received floating base state to the time at which it is requested.
+     */
+    enum floatingBaseStateExtrapolation
+    {
+        NO_EXTRAPOLATION,            /*<! The state is returned as received */
+        SECOND_ORDER_EXTRAPOLATION,  /*<! Constant linear and angular acceleration */
+        CONSTANT_TWIST_EXTRAPOLATION /*<! Constant twist, i.e. a screw motion on SE(3) */
+    };
+
+    /**
+     * Floating base state in the binary format read by remoteFloatingBaseStateEstimator
+     * when its binaryFormat option is enabled.
      *
+     * The message is serialized as a single binary block with a fixed layout:
+     *  - tag (int, FLOATING_BASE_STATE_MESSAGE_TAG)
+     *  - sequence number (int)
+     *  - timestamp (double, time at which the source estimated the state)
+     *  - base position (16 double, row major homogeneous transformation)
+     *  - base velocity (6 double)
+     *  - base acceleration (6 double)
+     *
+     * The content of the position, velocity and acceleration is the
+     * one described in the remoteFloatingBaseStateEstimator class.
      */
-    class remoteFloatingBaseStatePortProcessor : public yarp::os::TypedReaderCallback<yarp::os::Bottle>
+    class floatingBaseStateMessage: public yarp::os::Portable
     {
-            yarp::sig::Matrix base_pos_mat;
-            yarp::sig::Vector base_vel_vec;
-            yarp::sig::Vector base_acc_vec;
+    public:
+        int sequenceNumber;
+        double timestamp;
+        double basePosition[BASE_POS_ESTIMATE_SIZE];
+        double baseVelocity[BASE_VEL_ESTIMATE_SIZE];
+        double baseAcceleration[BASE_ACC_ESTIMATE_SIZE];
 
-            yarp::os::Mutex & mutex;
-            double * base_pos_estimate_buf;
-            double * base_vel_estimate_buf;
-            double * base_acc_estimate_buf;
-            bool   * measureAvailableFlag;
+        floatingBaseStateMessage();
 
-            double * lastTimestamp;
+        virtual bool read(yarp::os::ConnectionReader & connection);
+        virtual bool write(yarp::os::ConnectionWriter & connection);
+    };
+
+    /**
+     * Helper class for remoteFloatingBaseStateEstimator, reading the messages received by its port.
+     *
+     * The received states are handed to the readers through two slots protected by a sequence lock:
+     * each message is deserialized directly in the slot that is not published, that is then published
+     * by switching the index of the latest slot. The port thread never waits for the readers, and the
+     * readers never wait for the port thread: a reader copies the state again only if it was overwritten
+     * during the copy, that requires two messages to be received while it is copying.
+     * Binary messages that are not newer than the published one (duplicated or received out of order)
+     * are not published.
+     */
+    class remoteFloatingBaseStatePortProcessor : public yarp::os::PortReader
+    {
+            struct stateSlot
+            {
+                floatingBaseStateMessage state;
+                double receiptTimestamp;
+                volatile int version;   // odd while the slot is written
+            };
+
+            stateSlot slots[2];
+            volatile int latestSlot;    // index of the latest received state, -1 if none was received
+            bool binaryFormat;
+            // sequence number and source timestamp of the published state (used only by the thread of the port)
+            int lastSequenceNumber;
+            double lastSourceTimestamp;
+            yarp::os::Bottle bottleBuffer;
+
+            /** True if the state is older than the published one */
+            bool isStale(const floatingBaseStateMessage & state) const;
+
+            /** Parse the Bottle format described in remoteFloatingBaseStateEstimator */
+            bool readBottle(yarp::os::ConnectionReader & connection, floatingBaseStateMessage & state);
 
         public:
-            remoteFloatingBaseStatePortProcessor(yarp::os::Mutex & mutex);
+            remoteFloatingBaseStatePortProcessor();
+
+            /** Select the format of the messages: floatingBaseStateMessage if true, Bottle otherwise */
+            void setBinaryFormat(bool binaryFormat);
 
-            void setBuffers(double * base_pos_estimate_buf,
-                            double * base_vel_estimate_buf,
-                            double * base_acc_estimate_buf,
-                            double * lastTimestamp
-                           );
+            /** Forget the received states, to be called when the port is not receiving */
+            void reset();
 
-            void setFlags(bool * measureAvailableFlag);
+            virtual bool read(yarp::os::ConnectionReader & connection);
 
-            virtual void onRead(yarp::os::Bottle& b);
+            /**
+             * Copy the latest received state, without blocking.
+             * @param state the latest state, with the timestamp set by its source
+             * @param receiptTimestamp time at which the state was received
+             * @return false if no state has been received yet, true otherwise.
+             */
+            bool getLatestState(floatingBaseStateMessage & state, double & receiptTimestamp) const;
     };
 
 
@@ -158,7 +237,20 @@ namespace yarpWbi
      *
      * This format is bound to eventually change, but for now it is this one.
      *
+     * If the binaryFormat option is enabled, the state is instead read from messages with the fixed
+     * binary layout of floatingBaseStateMessage, that are deserialized without any parsing.
+     * Messages sent on a text connection are always parsed with the Bottle format.
+     *
      *  For more info on this convention, please check: http://wiki.icub.org/codyco/dox/html/dynamics_notation.html
+     *
+     * As the state is received with a delay, it can be propagated to the time at which it is requested
+     * with the extrapolation option:
+     *  * none: the state is returned as received (default).
+     *  * acceleration: the velocity and the position are integrated assuming a constant acceleration.
+     *  * constantTwist: the base moves with the received twist, i.e. along a screw motion on SE(3).
+     * The extrapolation horizon is the time elapsed since the state was estimated by its source (with the Bottle
+     * format, since it was received), saturated to maxExtrapolationHorizon seconds (default 0.1). The clocks of
+     * the source and of the reader are assumed to be synchronized. The acceleration is never modified.
      */
     class remoteFloatingBaseStateEstimator
     {
@@ -166,25 +258,24 @@ namespace yarpWbi
         remoteFloatingBaseStatePortProcessor callbackHandler;
 
     protected:
-        yarp::os::BufferedPort<yarp::os::Bottle> inputPort;
+        yarp::os::Port inputPort;
 
         yarp::os::ConstString local;
         yarp::os::ConstString remote;
 
-        yarp::os::Mutex buff_mutex;
-
-        double base_pos_estimate[BASE_POS_ESTIMATE_SIZE];
-        double base_vel_estimate[BASE_VEL_ESTIMATE_SIZE];
-        double base_acc_estimate[BASE_ACC_ESTIMATE_SIZE];
-
-        bool measureAvailable; // this flag is false if a measure is not available,
-                               // for example if it has not have been reader of a
-                               // timeout has been detected
+        yarp::os::Mutex buff_mutex; // protects the port during open and close
 
         double timeoutLimit_in_seconds;
-        double lastTimestamp;
+        volatile bool timeoutDetected;
 
-        void updateTimeout();
+        floatingBaseStateExtrapolation extrapolation;
+        double maxExtrapolationHorizon;
+
+        /**
+         * Get the latest received state, if it was received less than timeoutLimit seconds ago.
+         * @return false if a state is not available (not received yet or timeout), true otherwise.
+         */
+        bool getLatestState(floatingBaseStateMessage & state);
 
     public:
         remoteFloatingBaseStateEstimator();
@@ -204,9 +295,28 @@ namespace yarpWbi
             Check the class info for more informations. **/
         bool getBaseAcceleration(double * base_acc_estimate);
 
+        /** Gets the Base position, velocity and acceleration (all of the same message) for the
+            remote floating base published source, without blocking, extrapolated to the current time
+            if the extrapolation option is enabled.
+            If sourceTimestamp is not null, it is set to the time at which the source estimated the state
+            (with the Bottle format, that does not carry it, the time at which the state was received).
+            Check the class info for more informations. **/
         bool getBaseState(double * base_pos_estimate,
-                               double * base_vel_estimate,
-                               double * base_acc_estimate);
+                          double * base_vel_estimate,
+                          double * base_acc_estimate,
+                          double * sourceTimestamp = 0,
+                          double * extrapolationHorizon = 0);
+
+        /** Gets the Base position, velocity and acceleration, extrapolated to the specified time
+            with the model selected by the extrapolation option.
+            If extrapolationHorizon is not null, it is set to the time (in seconds) for which the
+            received state has been extrapolated (0 if the extrapolation is disabled). **/
+        bool getBaseStateAt(const double time,
+                            double * base_pos_estimate,
+                            double * base_vel_estimate,
+                            double * base_acc_estimate,
+                            double * sourceTimestamp = 0,
+                            double * extrapolationHorizon = 0);
 
 
         bool close();
@@ -23,6 +23,8 @@
 #include <yarp/dev/PolyDriver.h>
 #include <wbi/wbi.h>
 #include <vector>
+#include <string>
+#include <map>
 #include <cstdio>
 
 /* CODE UNDER DEVELOPMENT */
@@ -56,14 +58,88 @@ namespace yarpWbi
      * @param robotName Name of the robot to connect to.
      * @param pd Pointer to the poly driver to instanciate.
      * @param bodyPartName Name of the body part for which to open the poly driver.
+     * @param deviceName Name of the YARP device to open (default: remote_controlboard).
+     * @param streamingCarrier If not empty, the command port of the driver is opened with writeStrict off
+     *                         and connected with this carrier.
      * @return True if the operation succeeded, false otherwise. */
     bool openPolyDriver(const std::string &localName,
                         const std::string &robotName,
                           yarp::dev::PolyDriver *&pd,
-                        const std::string &bodyPartName);
+                        const std::string &bodyPartName,
+                        const std::string &deviceName = "remote_controlboard",
+                        const std::string &streamingCarrier = "");
+
+    /**
+     * Get the name of the device used to access the control boards,
+     * specified by the controlBoardDevice option (default: remote_controlboard).
+     */
+    std::string getControlBoardDeviceName(const yarp::os::Searchable & wbi_yarp_properties);
 
     bool closePolyDriver(yarp::dev::PolyDriver *&pd);
 
+    /**
+     * Open the driver of a control board, using the device specified by the controlBoardDevice option.
+     *
+     * If the shareControlBoardDrivers option is true, the drivers are shared by all
+     * the users in the process (e.g. yarpWholeBodyActuators, yarpWholeBodySensors and yarpWholeBodyModel):
+     * the driver of a robot part is opened by the first user, and it is reused (counting its users) until all
+     * of them have called closeControlBoardDriver.
+     * The drivers opened with a streamingCarrier (see openPolyDriver) are shared only by the users
+     * that asked for the same carrier.
+     * @return True if the operation succeeded, false otherwise.
+     */
+    bool openControlBoardDriver(const std::string &localName,
+                                const std::string &robotName,
+                                yarp::dev::PolyDriver *&pd,
+                                const std::string &bodyPartName,
+                                const yarp::os::Searchable & wbi_yarp_properties,
+                                const std::string &streamingCarrier = "");
+
+    /**
+     * Release a driver opened with openControlBoardDriver, closing it
+     * if it is not shared or if it has no other user, and set pd to 0.
+     */
+    bool closeControlBoardDriver(yarp::dev::PolyDriver *&pd);
+
+
+    /**
+     * Task executed by runTasksInParallel, e.g. the opening of a device or of a port.
+     */
+    class parallelTask
+    {
+    public:
+        virtual ~parallelTask() {}
+
+        /** @return True if the task succeeded, false otherwise. */
+        virtual bool execute() = 0;
+
+        /** Description of the task, used in the error messages and in the timing reports */
+        virtual std::string getDescription() const = 0;
+    };
+
+    /**
+     * Execute the tasks with at most nrOfWorkers threads (the calling thread included),
+     * and wait for all of them to be completed.
+     * With nrOfWorkers less or equal to 1 the tasks are executed in order in the calling thread.
+     * @param durations if not 0, it is filled with the execution time (in seconds) of each task
+     * @return True if all the tasks succeeded, false otherwise.
+     */
+    bool runTasksInParallel(const std::vector<parallelTask*> & tasks,
+                            const int nrOfWorkers,
+                            std::vector<double> * durations=0);
+
+    /**
+     * Execute the startup tasks (opening of devices and ports) of a component.
+     *
+     * If the parallelStartup option is true the tasks are executed by startupWorkers
+     * threads (default: 8), and the time spent in each task is printed, otherwise
+     * they are executed in order in the calling thread.
+     * @param component name of the component, used in the timing report
+     * @return True if all the tasks succeeded, false otherwise.
+     */
+    bool runStartupTasks(const std::string & component,
+                         const std::vector<parallelTask*> & tasks,
+                         const yarp::os::Searchable & wbi_yarp_properties);
 
     /*
     bool loadControlBoardsFromConfig(yarp::os::Property & wbi_yarp_properties,
@@ -80,6 +156,35 @@ namespace yarpWbi
                                          KDL::CoDyCo::TreeSerialization& serialization);
 
 
+    /**
+     * Index of the elements of a group of the configuration (e.g. WBI_YARP_JOINTS or WBI_ID_LISTS),
+     * built with a single pass on the group.
+     *
+     * yarp::os::Bottle::find scans the whole group, so resolving all the joints or sensors of
+     * a configuration with it is quadratic in their number, while a lookup in the index is logarithmic.
+     * The index refers to the Bottle of the group, that must outlive it and must not be modified.
+     */
+    class configurationGroupIndex
+    {
+    private:
+        const yarp::os::Bottle * group;
+        std::map<std::string,int> elements; // name -> position of the (name value) element in the group
+
+    public:
+        configurationGroupIndex();
+        explicit configurationGroupIndex(const yarp::os::Bottle & group);
+
+        void build(const yarp::os::Bottle & group);
+
+        /**
+         * Same as yarp::os::Bottle::find on the group.
+         * @return the value of the element with the specified name, or a null value if it is not in the group.
+         */
+        yarp::os::Value & find(const std::string & name) const;
+
+        bool check(const std::string & name) const;
+    };
+
     bool loadJointsControlBoardFromConfig(yarp::os::Property & wbi_yarp_properties,
                                           const wbi::IDList & jointIdList,
                                           std::vector<std::string> & controlBoardNames,
@@ -93,11 +198,20 @@ namespace yarpWbi
                                     const wbi::IDList & jointIdList,
                                     std::vector<std::string> & controlBoardNames);
 
+    bool appendNewControlBoardsToVector(const configurationGroupIndex & joints_config_index,
+                                        const wbi::IDList & jointIdList,
+                                        std::vector<std::string> & controlBoardNames);
+
     bool getControlBoardAxisList(yarp::os::Bottle & joints_config,
                                                           const wbi::IDList &jointIdList,
                                                           const std::vector<std::string>& controlBoardNames,
                                                           std::vector< std::pair<int,int> > & controlBoardAxisList);
 
+    bool getControlBoardAxisList(const configurationGroupIndex & joints_config_index,
+                                 const wbi::IDList &jointIdList,
+                                 const std::vector<std::string>& controlBoardNames,
+                                 std::vector< std::pair<int,int> > & controlBoardAxisList);
+
     std::vector< int > getControlBoardList(const std::vector< std::pair<int,int> > & controlBoardAxisList);
 
     bool loadSensorPortsFromConfig(yarp::os::Property & wbi_yarp_properties,
@@ -202,6 +316,139 @@ namespace yarpWbi
                                              const yarp::os::Value& listSpecification,
                                              wbi::IDList& idList);
 
+    /**
+     * Full hardware and compiler memory barrier, used to publish data
+     * shared between threads (or processes) without locks.
+     */
+    void memoryBarrier();
+
+    /**
+     * Minimal wrapper around a memory mapped file.
+     *
+     * The mapping is established once in open, after which the content
+     * of the file can be accessed through data() without any further system call.
+     * @note memory mapping is currently supported only on POSIX systems.
+     */
+    class memoryMappedFile
+    {
+    private:
+        int fileDescriptor;
+        char * mappedData;
+        size_t mappedSize;
+        bool writable;
+
+        //Copy is not allowed
+        memoryMappedFile(const memoryMappedFile &);
+        memoryMappedFile & operator=(const memoryMappedFile &);
+
+    public:
+        memoryMappedFile();
+        ~memoryMappedFile();
+
+        /**
+         * Create (or truncate) the file at the specified path, resize it
+         * to size bytes and map it in read/write mode.
+         * @return true if the operation succeeded, false otherwise.
+         */
+        bool create(const std::string & path, size_t size);
+
+        /**
+         * Map an existing file in read only mode.
+         * @return true if the operation succeeded, false otherwise.
+         */
+        bool openReadOnly(const std::string & path);
+
+        /**
+         * Unmap the file.
+         * @param finalSize if the file was opened with create and finalSize is
+         *                  greater than 0, the file is truncated to finalSize bytes
+         * @return true if the operation succeeded, false otherwise.
+         */
+        bool close(size_t finalSize = 0);
+
+        bool isOpen() const;
+        char * data();
+        const char * data() const;
+        size_t size() const;
+    };
+
+    /**
+     * Histogram of latencies, with bins of exponentially increasing width.
+     * The upper bound of the first bin is 10 us, and each following bin doubles it,
+     * while the last bin contains all the latencies greater than about 0.16 s.
+     */
+    struct latencyHistogram
+    {
+        enum { NR_OF_BINS = 16 };
+
+        long long counts[NR_OF_BINS];
+        long long nrOfSamples;
+        double sum;
+        double max;
+
+        latencyHistogram();
+        void reset();
+        void add(const double latency);
+
+        double getMean() const;
+
+        /**
+         * Get an upper bound of the specified percentile (between 0 and 1) of the latencies,
+         * i.e. the upper bound of the bin in which the percentile falls.
+         */
+        double getPercentile(const double percentile) const;
+
+        /** Upper bound (in seconds) of the specified bin */
+        static double getBinUpperBound(const int bin);
+    };
+
+    /**
+     * Fixed size history of the timestamped readings of a sensor,
+     * used to align readings of sensors sampled at different times.
+     */
+    class sensorReadingsHistory
+    {
+    private:
+        int dataSize;
+        int capacity;
+        int nrOfSamples;
+        int newest;                 // index of the newest sample in the circular buffer
+        std::vector<double> samples;
+        std::vector<double> stamps;
+
+        int bufferIndex(const int sample) const; // from chronological (0 is the oldest) to buffer index
+
+    public:
+        sensorReadingsHistory();
+
+        /** Allocate the history for readings of dataSize values, clearing it. */
+        void resize(const int dataSize, const int capacity);
+        void clear();
+
+        /**
+         * Add a reading to the history.
+         * @return false if the reading was not added because it is not newer than the newest one.
+         */
+        bool push(const double * data, const double stamp);
+
+        int size() const;
+        double getNewestStamp() const; ///< 0 if the history is empty
+
+        /**
+         * Get the reading at the specified time, computed from the two samples
+         * closest to it. Outside the interval covered by the history the
+         * oldest (or the newest) sample is returned, without extrapolating.
+         * @param linear if true the samples are linearly interpolated, otherwise the nearest one is used
+         * @param stamp if not 0, it is set to the stamp of the nearest sample
+         * @param axisAngleOrientation if true, the first 4 values of the reading are an orientation
+         *                             in axis-angle (x, y, z, angle) and, if linear is true, they are
+         *                             interpolated with a slerp (e.g. IMU readings)
+         * @return false if the history is empty, true otherwise.
+         */
+        bool getReadingAt(const double time, const bool linear, double * data, double * stamp=0,
+                          const bool axisAngleOrientation=false) const;
+    };
+
 
 } // end namespace yarpWbi
 
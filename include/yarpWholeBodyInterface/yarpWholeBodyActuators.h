@@ -20,12 +20,15 @@
 #define WBACTUATORS_YARP_H
 
 #include "yarpWholeBodyInterface/yarpWbiUtil.h"
+#include "yarpWholeBodyInterface/yarpWholeBodyOutputStage.h"
 
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/IVelocityControl2.h>
 #include <yarp/os/RateThread.h>
 #include <yarp/os/Semaphore.h>
+#include <yarp/os/Mutex.h>
 #include <yarp/os/BufferedPort.h>
+#include <yarp/os/Bottle.h>
 #include <iCub/ctrl/adaptWinPolyEstimator.h>
 #include <iCub/ctrl/filters.h>
 #include <iCub/skinDynLib/skinContactList.h>
@@ -69,6 +72,83 @@ namespace yarpWbi
 
     typedef std::vector< std::vector<yarpWBAControlledJoint> > yarpWBAControlledJointsControlBoardList;
 
+    /**
+     * Interface used by an entry of the command plan.
+     */
+    enum yarpWBACommandInterface
+    {
+        COMMAND_POSITION,
+        COMMAND_POSITION_DIRECT,
+        COMMAND_VELOCITY,
+        COMMAND_TORQUE,
+        COMMAND_PWM,
+        COMMAND_CONTROL_MODE,       //< setControlMode (IControlMode2 and IInteractionMode), not used in the command plan
+        COMMAND_PID,                //< setPIDGains, not used in the command plan
+        NR_OF_COMMAND_INTERFACES
+    };
+
+    /**
+     * Statistics on the commands sent through an interface of a control board.
+     */
+    struct actuatorsCommandHealth
+    {
+        std::string controlBoard;               ///< name of the control board
+        yarpWBACommandInterface commandInterface;
+        long long nrOfCommands;                 ///< total number of commands
+        long long nrOfFailedCommands;           ///< commands for which the interface returned false
+        latencyHistogram commandLatency;        ///< time between the send of a command and its return
+        double lastSendTime;                    ///< -1 if no command was sent
+        double lastReturnTime;                  ///< -1 if no command was sent
+
+        actuatorsCommandHealth();
+        void reset();
+        void addCommand(const bool success, const double sendTime, const double returnTime);
+        double getSuccessRate() const;
+        /** Name of the interface (e.g. torque, control mode) */
+        std::string getInterfaceName() const;
+    };
+
+    /**
+     * Entry of the command plan of yarpWholeBodyActuators: one call
+     * to a control board interface, sending the references of nrOfAxes axes.
+     *
+     * The axes and the indices of the corresponding wbi references are stored
+     * in the flat arrays of the plan, starting at firstIndex. If allAxes is true the
+     * entry controls all the axes of the control board, in the order of the control board.
+     */
+    struct yarpWBACommandPlanEntry
+    {
+        int wbi_controlboard_id;
+        yarpWBACommandInterface commandInterface;
+        bool allAxes;
+        int nrOfAxes;
+        int firstIndex;
+        double scale; //< conversion from wbi to yarp units
+    };
+
+    /**
+     * Precompiled list of the calls needed by setControlReference, rebuilt
+     * only when the control mode of some joint changes. The entries are sorted by control board.
+     */
+    class yarpWholeBodyActuatorsCommandPlan
+    {
+    public:
+        std::vector<yarpWBACommandPlanEntry> entries;
+        std::vector<int> firstEntryOfControlBoard; //< size: number of control boards + 1
+        std::vector<int> axes;
+        std::vector<int> referenceIndices;
+        std::vector<double> references; //< buffer of the references in yarp units
+        std::vector<int> filteredAxes; //< buffers of the axes actually sent, if the references are deduplicated
+        std::vector<double> filteredReferences;
+
+        void clear(const int nrOfControlBoards);
+        void addEntry(const int wbi_controlboard_id,
+                      const yarpWBACommandInterface commandInterface,
+                      const std::vector<yarpWBAControlledJoint> & joints,
+                      const int totalAxesInControlBoard,
+                      const double scale);
+    };
+
     /**
      * Helper class for efficiently storing information about joints controlled
      * by the yarpWholeBodyActuactors interfaces, divided for controlboards
@@ -86,6 +166,27 @@ namespace yarpWbi
         bool reset(const int nrOfControlBoards);
     };
 
+    class controlBoardCommandWorker;
+    class controlReferenceSender;
+
+    /**
+     * Statistics of the references queued by setControlReference when
+     * the nonBlockingControlReference option is enabled.
+     */
+    struct controlReferenceQueueStats
+    {
+        long long nrOfQueuedReferences;   ///< references passed to setControlReference
+        long long nrOfSentReferences;     ///< references sent by the sender thread
+        long long nrOfDroppedReferences;  ///< references overwritten by a newer one, or queued before a change of control mode, before being sent
+        long long nrOfFailedReferences;   ///< references refused by some control board
+        int queueDepth;                   ///< references waiting to be sent (0 or 1)
+        latencyHistogram queueLatency;    ///< time between the call of setControlReference and the start of the send
+
+        controlReferenceQueueStats();
+        void reset();
+    };
+    class PIDList;
+
     /**
      * Class for communicating with motor control boards of robot supporting a yarp interface.
      *
@@ -98,6 +199,31 @@ namespace yarpWbi
      * | Parameter name | Type | Units | Default Value | Required | Description | Notes |
      * |:--------------:|:------:|:-----:|:-------------:|:--------:|:-----------:|:-----:|
      * |  robot         | string |  -    |    -         | yes |  Prefix of all the yarp ports of the accessed controlboards. | This parameter does not modify the YARP_ROBOT_NAME variable |
+     * |  controlBoardDevice | string |  -    | remote_controlboard | no |  YARP device used to access the controlboards. | Used also by yarpWholeBodySensors and yarpWholeBodyModel, mainly for testing against in-process fake devices. |
+     * |  shareControlBoardDrivers | bool |  -    | false | no |  If true, the drivers of the controlboards are shared by yarpWholeBodyActuators, yarpWholeBodySensors and yarpWholeBodyModel, so a single connection is opened for each controlboard in the process. | See openControlBoardDriver. The local ports are named after the first interface that opens each controlboard. |
+     * |  parallelStartup | bool |  -    | false | no |  If true, the controlboards (and, in yarpWholeBodySensors, the ports of the F/T sensors and of the IMUs) are opened in parallel during init, and the time spent opening each of them is printed. | See runStartupTasks. |
+     * |  startupWorkers | int |  -    | 8 | no |  Maximum number of threads used by parallelStartup. | |
+     * |  lazyDeviceOpening | bool |  -    | false | no |  If true, yarpWholeBodySensors opens the devices of each sensor type at its first read, and yarpWholeBodyInterface initializes the actuators at the first command. | The first read (or command) takes the time needed to open the devices. |
+     *
+     * The options specific to the actuators should be placed in the WBI_ACTUATORS_OPTIONS group.
+     *
+     * # WBI_ACTUATORS_OPTIONS
+     *
+     * | Parameter name | Type | Units | Default Value | Required | Description | Notes |
+     * |:--------------:|:------:|:-----:|:-------------:|:--------:|:-----------:|:-----:|
+     * | parallelCommandDispatch | bool | - | false | No | If true, the references of setControlReference(ref) are sent to each control board by a dedicated thread. | Enables setControlReferenceAsync. |
+     * | streamingReferences | bool | - | false | No | If true, the drivers of the control boards are opened with writeStrict off, so their command port (connected to /${robot}/${controlboard}/command:i) does not wait for the previous message to be delivered. | The direct position, velocity and torque messages no longer carry a sequence number and a timestamp each, and a message not delivered before the next one is dropped. Position and pwm references are still sent through the RPC interfaces. With shareControlBoardDrivers, these drivers are shared only with the users asking for the same carrier. |
+     * | streamingReferencesCarrier | string | - | udp | No | Carrier of the command ports of the control boards drivers, if streamingReferences is true. | |
+     * | nonBlockingControlReference | bool | - | false | No | If true, setControlReference(ref) copies the references in a slot and returns immediately, and a dedicated thread sends the latest references to the control boards. | References overwritten before being sent, or queued before a change of control mode, are dropped (see getControlReferenceQueueStats). setControlReferenceAsync is not available. |
+     * | referenceDeduplication | bool | - | false | No | If true, setControlReference(ref) does not send the references that differ from the last one sent to the same joint by no more than referenceDeadband. | If a control board interface is used for all its axes, all of them are sent as soon as one changes. |
+     * | referenceDeadband | double or list of doubles | rad, rad/s, Nm or pwm | 0.0 | No | Deadband used by referenceDeduplication, either for all the joints or for each joint (in the order of the actuators list). | With the default value only identical references are suppressed. |
+     * | referenceKeepAlivePeriod | double | s | 0.1 | No | A reference is sent anyway if no reference was sent to the joint for this period. | |
+     * | referenceSmoothingTimeConstant | double or list of doubles | s | 0.0 | No | Time constant of the first order filter applied to the references of setControlReference(ref), for all the joints or for each joint. | 0 disables the filter. See referenceOutputStage. |
+     * | referenceMaxRate | double or list of doubles | rad/s, rad/s^2, Nm/s or pwm/s | - | No | Maximum rate of change of the references of setControlReference(ref), for all the joints or for each joint. | Not limited if not specified or not positive. |
+     * | referenceMaxAcceleration | double or list of doubles | rad/s^2, rad/s^3, Nm/s^2 or pwm/s^2 | - | No | Maximum second derivative of the references of setControlReference(ref), for all the joints or for each joint. | Not limited if not specified or not positive. |
+     * | referenceDecimation | int | - | 1 | No | The references of setControlReference(ref) are sent to the control boards only once every referenceDecimation calls. | The filters are updated at every call. |
+     * | commandStatsPort | bool | - | false | No | If true, the command statistics (see getCommandHealth) are published on the /${name}/commandStats:o port. | Each message contains a list (controlBoard interface nrOfCommands nrOfFailedCommands meanLatency p50Latency p99Latency maxLatency) for each interface used, with the latencies in seconds. |
+     * | commandStatsPeriod | double | s | 1.0 | No | Minimum period between two messages on the commandStats:o port. | The statistics are published by setControlReference(ref). |
      *
      * \todo document the other parameters
      *
@@ -123,18 +249,93 @@ namespace yarpWbi
         std::vector< int >                 totalAxesInControlBoard;
         // total number of axes in each controlBoard controlled by the wbi
         std::vector< int >                 totalControlledAxesInControlBoard;
+        // buffer for the pids of a controlBoard (size: the largest value of totalAxesInControlBoard)
+        std::vector< yarp::dev::Pid >      boardPidsBuffer;
+        // buffers of the joints of a controlBoard switched by setControlModeAllJoints (size: the largest value of totalAxesInControlBoard)
+        std::vector< int >                 modeSwitchJoints;
+        std::vector< int >                 modeSwitchAxes;
+        std::vector< int >                 modeSwitchControlModes;
+        std::vector< yarp::dev::InteractionModeEnum > modeSwitchInteractionModes;
+        std::vector< double >              modeSwitchReferences;
         // total number
         // structure containing information of joints controlled in each mode for each controlboard
         yarpWholeBodyActuatorsControlledJoints controlledJointsForControlBoard;
 
+        // calls to be performed by setControlReference(ref), rebuilt with controlledJointsForControlBoard
+        yarpWholeBodyActuatorsCommandPlan commandPlan;
+
+        /** Rebuild commandPlan from controlledJointsForControlBoard */
+        void updateCommandPlan();
+
+        // suppression of the references equal to the last one sent (if referenceDeduplication is enabled)
+        bool referenceDeduplication;
+        double referenceKeepAlivePeriod;
+        std::vector<double> referenceDeadband;         // for each joint, in wbi units
+        std::vector<double> lastSentReferences;        // for each joint, in wbi units
+        std::vector<double> lastSentReferencesTime;    // for each joint
+
+        bool loadReferenceDeduplicationOptions(const yarp::os::Bottle & actuators_opt_bot);
+
+        // filters and decimation applied to the references of all the joints
+        referenceOutputStage outputStage;
+
         // current control mode of each joint (size: jointIdList.size())
         std::vector<wbi::ControlMode>        currentCtrlModes;
 
         // Map containing parameters to be read at initialization time
         yarp::os::Property wbi_yarp_properties;
 
+        // persistent threads sending the references of each control board (if parallelCommandDispatch is enabled)
+        bool parallelCommandDispatch;
+        std::vector<controlBoardCommandWorker*> commandWorkers;
+        // true if the workers are sending references not joined yet
+        bool controlReferencePending;
+        // copy of the references sent by setControlReferenceAsync
+        std::vector<double> asyncReferences;
+
+        // carrier of the command ports of the control boards drivers (empty if streamingReferences is disabled)
+        std::string streamingReferencesCarrier;
+
+        // command statistics, indexed by wbi control board id and yarpWBACommandInterface
+        std::vector< std::vector<actuatorsCommandHealth> > commandHealth;
+        yarp::os::BufferedPort<yarp::os::Bottle> * commandStatsPort;
+        double commandStatsPeriod;
+        double lastCommandStatsPublishTime;
+
+        /** Called with commandMutex locked, or by the workers sending the references dispatched with it locked */
+        void addCommand(const int wbi_controlboard_id, const yarpWBACommandInterface commandInterface,
+                        const bool success, const double sendTime);
+        /** Called with commandMutex locked */
+        std::vector<actuatorsCommandHealth> collectCommandHealth();
+        /** Called with commandMutex locked */
+        void writeCommandHealth();
+
+        // thread sending the latest references (if nonBlockingControlReference is enabled)
+        bool nonBlockingControlReference;
+        controlReferenceSender * referenceSender;
+        // held while the references are sent, the control modes change or the command statistics are updated
+        yarp::os::Mutex commandMutex;
+
+        /** Send the references of all the joints (setControlReference(ref) in blocking mode), called with commandMutex locked */
+        bool sendControlReference(const double *ref);
+        /** Send the reference of a single joint, called with commandMutex locked */
+        bool setControlReferenceSingleJoint(const double *ref, int joint);
+        /**
+         * Send the references queued for the sender thread, unless the control modes
+         * changed after they were queued (in that case discarded is set to true).
+         */
+        bool sendQueuedControlReference(const double *ref, const int generation, bool & discarded);
+        friend class controlReferenceSender;
+
+        void startCommandWorkers();
+        void stopCommandWorkers();
+        void dispatchControlReference(const double *ref);
+        bool joinControlReference();
+        /** Wait for the workers to send the references dispatched by setControlReferenceAsync, if any */
+        bool waitDispatchedControlReference();
+
          // yarp drivers vector whose index is given by relative index of the bodyPartNames vector
-        std::vector<yarp::dev::IPositionControl*>     ipos;
+        std::vector<yarp::dev::IPositionControl2*>    ipos;
         std::vector<yarp::dev::IPositionDirect*>      ipositionDirect;
         std::vector<yarp::dev::ITorqueControl*>       itrq;
         std::vector<yarp::dev::IImpedanceControl*>    iimp;
@@ -148,10 +349,12 @@ namespace yarpWbi
          * Open the yarp PolyDriver relative to control board bodyPartNames[bodyPart].
          */
         bool openControlBoardDrivers(int bodyPart);
+        friend class controlBoardOpeningTask;
 
         /**
          * Method called to update the internal data structures,
-         * at initialization or when a control board control mode changes
+         * at initialization or when a control board control mode changes.
+         * Called with commandMutex locked.
          */
         bool updateControlledJointsForEachControlBoard();
 
@@ -163,6 +366,7 @@ namespace yarpWbi
 
         /** Set the proportional, derivative and integrale gain for the current joint(s) controller.
          * If you want to leave some values unchanged simply pass NULL to the corresponding gain
+         * If joint is negative, the gains of the torque controlled joints are sent with one call for each control board.
          * @param pValue Value(s) of the proportional gain.
          * @param dValue Value(s) of the derivative gain.
          * @param iValue Value(s) of the integral gain.
@@ -181,6 +385,35 @@ namespace yarpWbi
          */
         bool setControlModeSingleJoint(wbi::ControlMode controlMode, double *ref, int joint);
 
+        /**
+         * Private, all joints version of setControlMode: the control modes
+         * are changed with one setControlModes call for each control board.
+         * The references (if ref is not null) are sent only to the joints whose
+         * control mode changed, with one call for each control board.
+         */
+        bool setControlModeAllJoints(wbi::ControlMode controlMode, double *ref);
+
+        /**
+         * Send the references of the joints of the specified control board.
+         * @param ref references of all the joints of the interface.
+         */
+        bool setControlReferenceForControlBoard(const int wbi_controlboard_id, const double *ref);
+        friend class controlBoardCommandWorker;
+
+        /**
+         * Send already scaled references to some axes of a control board with the call of the specified interface.
+         * @param allAxes if true, axes is ignored and references contains the references of all the axes of the control board.
+         */
+        bool sendReferencesToControlBoard(const int wbi_controlboard_id, const yarpWBACommandInterface commandInterface,
+                                          const bool allAxes, const int nrOfAxes, const int *axes, const double *references);
+
+        /**
+         * Read (write) the torque pids of all the axes of a control board with a single call.
+         * @param boardPids buffer of totalAxesInControlBoard[wbi_controlboard_id] pids
+         */
+        bool getTorquePidsOfControlBoard(const int wbi_controlboard_id, yarp::dev::Pid *boardPids);
+        bool setTorquePidsOfControlBoard(const int wbi_controlboard_id, const yarp::dev::Pid *boardPids);
+
         bool setInteractionModeSingleJoint(yarp::dev::InteractionModeEnum mode, int joint, wbi::Error *error);
 
         bool setImpedanceStiffness(double stiffness, int joint, wbi::Error *error);
@@ -240,6 +473,51 @@ namespace yarpWbi
          */
         virtual bool setControlReference(double *ref, int joint=-1);
 
+        /**
+         * Start sending the references of all the joints, returning immediately.
+         * The references are sent in parallel to all the control boards (the
+         * parallelCommandDispatch option must be enabled) and they are copied, so ref can be reused.
+         * @return false if parallelCommandDispatch is not enabled, true otherwise.
+         */
+        bool setControlReferenceAsync(double *ref);
+
+        /**
+         * Wait for the references sent by setControlReferenceAsync (or queued by setControlReference,
+         * if nonBlockingControlReference is enabled) to be delivered.
+         * @return true if all the control boards accepted the references, false otherwise.
+         */
+        bool waitControlReference();
+
+        /**
+         * Get the statistics of the references queued by setControlReference.
+         * @return false if nonBlockingControlReference is not enabled, true otherwise.
+         */
+        bool getControlReferenceQueueStats(controlReferenceQueueStats & stats) const;
+
+        /**
+         * Get the statistics of the commands sent to each interface of each control board.
+         * Only the interfaces that have been used are returned.
+         * The references dispatched by setControlReferenceAsync are waited for.
+         */
+        std::vector<actuatorsCommandHealth> getCommandHealth();
+
+        /**
+         * Get the statistics of the commands sent to an interface of a control board.
+         * @return false if no control board with the specified name is used, or if no command
+         *         was sent to the interface since the statistics were reset, true otherwise.
+         */
+        bool getCommandHealth(const std::string & controlBoard, const yarpWBACommandInterface commandInterface,
+                              actuatorsCommandHealth & health);
+
+        /** Reset all the command statistics. */
+        void resetCommandHealth();
+
+        /**
+         * Publish the command statistics on the commandStats:o port.
+         * @return false if the commandStatsPort option is not enabled, true otherwise.
+         */
+        bool publishCommandHealth();
+
         /**
          * Set a parameter (e.g. a gain) of one or more joint controllers.
          * @param paramId Id of the parameter.
@@ -260,6 +538,19 @@ namespace yarpWbi
          */
         bool setPIDGains(yarp::dev::Pid *pids, wbi::ControlMode controlMode, int joint = -1);
 
+        /**
+         * Set the torque pids of all the joints, with one message for each control board
+         * (two if the interface does not control all the axes of the control board).
+         *
+         * The gains are applied to all the control boards or to none: if a control board
+         * refuses them, the previous gains of the control boards already updated are restored.
+         * Motor torque parameters contained in the list are not set (see setMotorTorqueParameters).
+         *
+         * @param gains torque pids, one for each joint of the interface
+         * @return true if operation succeeded, false otherwise.
+         */
+        bool applyGainSchedule(const PIDList & gains);
+
         /**
          * Get the pids for the specified control mode for a specific joint or a list of joints
          *
@@ -291,6 +582,16 @@ namespace yarpWbi
          */
         bool getMotorTorqueParameters(yarp::dev::MotorTorqueParameters *motorParameters, const int joint = -1);
 
+        /**
+         * Set stiffness and damping of the impedance controllers of all the joints.
+         * @note IImpedanceControl has no multi-axis call, so a message is sent for each joint,
+         *       but the current impedance is not read back as in setControlProperty.
+         * @param stiffness stiffness of each joint
+         * @param damping damping of each joint
+         * @return true if operation succeeded, false otherwise.
+         */
+        bool setImpedances(const double *stiffness, const double *damping);
+
         /**
          * Set a generic property to the underlined controllers.
          * Currently only setting interaction mode is supported.
@@ -58,12 +58,26 @@ namespace yarpWbi
 
     /**
      * Class to communicate with yarp-powered robot.
+     *
+     * If the lazyDeviceOpening option is true, init does not initialize the actuators
+     * interface (that opens all the control boards): it is initialized by the first
+     * setControlMode, setControlReference or setControlParam call. The sensors
+     * used by the states interface are opened lazily as well (see yarpWholeBodySensors).
+     * If that first call would happen inside a control loop, call warmUp before starting the loop.
      */
     class yarpWholeBodyInterface : public wbi::wholeBodyInterface
     {
     private:
         yarp::os::Mutex wbiMutex;
 
+        bool lazyActuatorsInit;
+        bool actuatorsInitDone;
+        bool actuatorsInitFailed;
+        yarp::os::Mutex actuatorsInitMutex; // not wbiMutex, that can be held by the caller
+
+        /** Initialize the actuators interface, if it was not done by init */
+        bool initActuators();
+
     protected:
         yarpWholeBodyActuators  *actuatorInt;
         yarpWholeBodyModel      *modelInt;
@@ -108,6 +122,14 @@ namespace yarpWbi
         virtual ~yarpWholeBodyInterface();
         virtual bool init();
         virtual bool close();
+
+        /**
+         * Initialize the actuators and open the devices of all the added sensors,
+         * if lazyDeviceOpening postponed them. Call it after init and before the control loop.
+         * @return true if the actuators and all the sensors are ready, false otherwise.
+         */
+        bool warmUp();
+
         virtual bool removeJoint(const wbi::ID &j);
         virtual bool addJoint(const wbi::ID &j);
         virtual int addJoints(const wbi::IDList &j);
@@ -64,11 +64,16 @@ namespace yarpWbi
      * |:--------------:|:------:|:-----:|:-------------:|:--------:|:-----------:|:-----:|
      * | urdf | - | - | - | Yes | File name of the urdf file to load for getting the model of the robot. | The file name will be opened by the ResourceFinder::findFile call, using the search rules of the ResourceFinder, that you can find in http://wiki.icub.org/yarpdoc/yarp_resource_finder_tutorials.html |
      * | getLimitsFromControlBoard | string | - | - | No | Get limits from the real robot instead of the URDF model. |  |
+     * | modelCacheDirectory | string | - | - | No | If present, the parsed model is cached in a binary file in this directory, and loaded from it in place of the urdf file if the content of the urdf was not modified. | The cache is identified by a hash of the urdf file, so a modified urdf automatically creates a new cache. The directory should already exist. |
      *
      *  Given that the limits in the URDF file could be outdated with respect to the real robot,
      * limits can be loaded by the real robot, by passing to the yarpWholeBodyModel the getLimitsFromControlBoard
      * option. In that case the ControlBoard of the robot will be opened, using the same parameters used by the
      * yarpWholeBodyActuators interface.
+     * The limits are read from all the control boards in parallel during init and then cached, so
+     * getJointLimits does not communicate with the robot: if the limits are changed on the robot,
+     * call refreshJointLimits to read them again.
+     * If the limits of some control board can not be read during init, init fails.
      */
     class yarpWholeBodyModel: public wbi::iWholeBodyModel
     {
@@ -108,6 +113,7 @@ namespace yarpWbi
         yarp::sig::Matrix adjMatrixBuffer;
         yarp::sig::Matrix HresultBuffer;
         yarp::sig::Matrix reducedJacobianBuffer;
+        yarp::sig::Matrix completeJacobianBuffer;
    
 
         // *** Variables needed for opening IControlLimits interfaces
@@ -121,11 +127,27 @@ namespace yarpWbi
         std::vector<yarp::dev::PolyDriver*>       dd;
         std::vector<yarp::dev::IControlLimits*>   ilim;
 
+        // joint limits (rad) read from the control boards
+        bool jointLimitsCached;
+        std::vector<double> jointLimitsMin;
+        std::vector<double> jointLimitsMax;
+        // limits being read by refreshJointLimits, copied in jointLimitsMin/Max if all the control boards succeed
+        std::vector<double> fetchedJointLimitsMin;
+        std::vector<double> fetchedJointLimitsMax;
+
 
         std::vector<int> wbiToiDynTreeJointId;
 
         bool openDrivers(int bp);
 
+        /**
+         * Create the model from the urdf file or, if the modelCacheDirectory option
+         * is set and the cache of the urdf exists, from the cache (see yarpWholeBodyModelCache.h).
+         */
+        iCub::iDynTree::DynTree * createModel(const std::string & urdf_file_path,
+                                              const std::vector<std::string> & joint_names,
+                                              const std::string & kinematic_base_link_name);
+
         bool convertBasePose(const wbi::Frame &xBase, yarp::sig::Matrix & H_world_base);
         bool convertBaseVelocity(const double *dxB, yarp::sig::Vector & v_b, yarp::sig::Vector & omega_b);
         bool convertBaseAcceleration(const double *ddxB, yarp::sig::Vector & a_b, yarp::sig::Vector & domega_b);
@@ -140,7 +162,12 @@ namespace yarpWbi
 
         bool closeDrivers();
 
-        bool getJointLimitFromControlBoard(double *qMin, double *qMax, int joint);
+        /**
+         * Read the limits of the joints of a control board (opening and closing its driver)
+         * and store them in fetchedJointLimitsMin and fetchedJointLimitsMax.
+         */
+        bool fetchJointLimitsOfControlBoard(const int bp);
+        friend class jointLimitsFetcher;
 
         /**
          * Helper function: convert a pos offset 3D vector in a 4x4 homogeneours
@@ -205,6 +232,14 @@ namespace yarpWbi
          * @return True if the operation succeeded, false otherwise. */
         virtual bool getJointLimits(double *qMin, double *qMax, int joint=-1);
 
+        /**
+         * Read again the joint limits from the control boards, if the getLimitsFromControlBoard
+         * option is set. If the limits of some control board can not be read, the previously
+         * cached ones of all the joints are kept.
+         * @return True if the limits of all the joints were read, false otherwise.
+         */
+        bool refreshJointLimits();
+
         /** Compute homogenous transformation matrix that appliend on a vector expressed in the specified frame it transform it in the world.
          * @param q Joint angles (rad).
          * @param xBase homogeneous transformation that applied on a 4d homogeneous position vector expressed in the base frame transforms it in the world frame (world_H_base).
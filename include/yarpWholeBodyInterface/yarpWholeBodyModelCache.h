@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef WBI_MODEL_CACHE_H
+#define WBI_MODEL_CACHE_H
+
+#include <string>
+#include <vector>
+
+namespace KDL {
+    class Tree;
+}
+
+namespace yarpWbi
+{
+    /**
+     * Compute the 64 bit FNV-1a hash of the content of a file.
+     * @return false if the file can not be read, true otherwise.
+     */
+    bool computeFileHash(const std::string & path, unsigned long long & hash);
+
+    /**
+     * Name of the cache file of the model whose URDF has the specified hash,
+     * i.e. ${directory}/yarpWholeBodyModel-${hash}.bin
+     */
+    std::string getModelCacheFileName(const std::string & directory, const unsigned long long urdfHash);
+
+    /**
+     * Save the parsed model in a binary cache file.
+     *
+     * The file contains a header (magic string, format version and hash of the URDF),
+     * the name of the root of the tree, the segments of the tree (with their joint,
+     * frame and inertia) in an order such that each parent precedes its children, and the
+     * position limits of the degrees of freedom of the model.
+     *
+     * The file is written with a temporary name and then renamed, so processes
+     * loading the model at the same time never read a partially written cache.
+     *
+     * @return true if the cache was written, false otherwise.
+     */
+    bool saveModelCache(const std::string & cacheFile,
+                        const unsigned long long urdfHash,
+                        const KDL::Tree & tree,
+                        const std::vector<double> & jointBoundMin,
+                        const std::vector<double> & jointBoundMax);
+
+    /**
+     * Load a model saved by saveModelCache, memory mapping the cache file.
+     * @return false if the file does not exist, if it was generated from a different URDF
+     *         (or by a different version of the library) or if it is corrupted, true otherwise.
+     */
+    bool loadModelCache(const std::string & cacheFile,
+                        const unsigned long long urdfHash,
+                        KDL::Tree & tree,
+                        std::vector<double> & jointBoundMin,
+                        std::vector<double> & jointBoundMax);
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef WBI_OUTPUT_STAGE_H
+#define WBI_OUTPUT_STAGE_H
+
+#include <Eigen/Core>
+
+namespace yarp {
+    namespace os {
+        class Bottle;
+    }
+}
+
+namespace yarpWbi
+{
+    /**
+     * Output stage applied by yarpWholeBodyActuators to the references
+     * of all the joints before sending them to the control boards.
+     *
+     * For each joint, the reference is first filtered with a first order low pass filter
+     * (time constant referenceSmoothingTimeConstant) and then its rate of change and
+     * acceleration are limited to referenceMaxRate and referenceMaxAcceleration. When the
+     * acceleration is limited, the output decelerates in time to reach the reference without overshoot.
+     *
+     * All the operations are performed on the whole vector of references, whose buffers are allocated
+     * in configure. The period of the filters is the time elapsed between two calls to process.
+     *
+     * Independently of the filters, the references can be decimated, i.e. sent only once every
+     * referenceDecimation calls to setControlReference, while the filters are updated at every call.
+     */
+    class referenceOutputStage
+    {
+    private:
+        int nrOfJoints;
+        bool filtering;
+        bool initialized;
+        double lastTime;
+        int decimation;
+        int decimationCounter;
+
+        Eigen::ArrayXd smoothingTimeConstant;
+        Eigen::ArrayXd maxRate;
+        Eigen::ArrayXd maxAcceleration;
+
+        Eigen::ArrayXd smoothed;
+        Eigen::ArrayXd output;
+        Eigen::ArrayXd velocity;
+        Eigen::ArrayXd error;
+        Eigen::ArrayXd maxVelocity;
+        Eigen::ArrayXd needsReset;  // 1 for the joints whose state should be set to the next reference
+
+    public:
+        referenceOutputStage();
+
+        /**
+         * Configure the stage with the options of the WBI_ACTUATORS_OPTIONS group.
+         * Each option can be a single value, for all the joints, or a list with a value for each joint.
+         * @return false if some option is not valid, true otherwise.
+         */
+        bool configure(const yarp::os::Bottle & actuators_opt_bot, const int nrOfJoints);
+
+        /** True if any filter or the decimation are enabled */
+        bool isEnabled() const;
+
+        /** True if any filter is enabled */
+        bool isFiltering() const;
+
+        /**
+         * Forget the state of the filters: at the next call of process
+         * the output is set to the reference.
+         */
+        void reset();
+
+        /**
+         * Forget the state of the filter of a joint (e.g. after a change of its control mode).
+         */
+        void resetJoint(const int joint);
+
+        /**
+         * Set the state of the filter of a joint, to be used when the
+         * reference of a single joint is sent bypassing the stage.
+         */
+        void setJoint(const int joint, const double reference);
+
+        /**
+         * Filter the references of all the joints.
+         * @param ref references, in the wbi units
+         * @param now current time in seconds
+         * @return the filtered references (valid until the next call)
+         */
+        const double * process(const double * ref, const double now);
+
+        /**
+         * Advance the decimation counter.
+         * @return true if the references should be sent in this call, false otherwise.
+         */
+        bool decimationTick();
+    };
+}
+
+#endif
@@ -20,12 +20,14 @@
 #define WBSENSORS_ICUB_H
 
 #include "yarpWholeBodyInterface/yarpWbiUtil.h"
+#include "yarpWholeBodyInterface/yarpWholeBodySensorsLog.h"
 
 #include <yarp/dev/ControlBoardInterfaces.h>
 #include <yarp/dev/IVelocityControl2.h>
 #include <yarp/os/RateThread.h>
 #include <yarp/os/Semaphore.h>
 #include <yarp/os/BufferedPort.h>
+#include <yarp/os/Mutex.h>
 #include <iCub/ctrl/adaptWinPolyEstimator.h>
 #include <iCub/ctrl/filters.h>
 #include <iCub/iDynTree/TorqueEstimationTree.h>
@@ -73,13 +75,68 @@ namespace yarpWbi
 
 
 
+    /** Methods to align the readings of a snapshot to its reference time. */
+    enum SnapshotAlignment
+    {
+        SNAPSHOT_NEAREST, ///< use the reading closest to the reference time
+        SNAPSHOT_LINEAR   ///< linearly interpolate the two readings closest to the reference time
+    };
+
+    /**
+     * Readings of all the sensors added to a yarpWholeBodySensors,
+     * aligned to a common reference time.
+     */
+    struct wholeBodySensorsSnapshot
+    {
+        double referenceTime;
+        ///< aligned readings, indexed by wbi::SensorType (empty for the sensor types without sensors)
+        std::vector< std::vector<double> > data;
+        ///< stamp of the reading closest to the reference time, for each sensor
+        std::vector< std::vector<double> > stamps;
+    };
+
+    /**
+     * Statistics on the reads of a control board or of a sensor port.
+     */
+    struct sensorsReadHealth
+    {
+        std::string name;                 ///< name of the control board or of the port
+        long long nrOfReads;              ///< total number of reads
+        long long nrOfFailedReads;        ///< reads that returned no new data (including timeouts)
+        long long nrOfTimeouts;           ///< blocking reads that failed for timeout
+        latencyHistogram readLatency;     ///< time spent in each read (including the waits of blocking reads)
+        double lastDataAge;               ///< now minus stamp of the data at the last successful read, -1 if not available
+        double maxDataAge;                ///< maximum of lastDataAge
+
+        sensorsReadHealth();
+        void reset();
+        void addRead(const bool success, const double latency, const double dataAge=-1.0);
+        void addTimeout(const double latency);
+        double getSuccessRate() const;
+    };
+
     /**
      * Class for reading the sensors of a yarp robot.
      *
      * You can configure this object with a yarp::os::Property object, that you can
      * pass to the constructor. Alternativly you can set the Property through the setYarpWbiProperties method,
      * but in that case you have to set the property before calling the init method.
-     * 
+     *
+     * The options specific to the sensors should be placed in the WBI_SENSORS_OPTIONS group.
+     *
+     * # WBI_SENSORS_OPTIONS
+     *
+     * | Parameter name | Type | Units | Default Value | Required | Description | Notes |
+     * |:--------------:|:------:|:-----:|:-------------:|:--------:|:-----------:|:-----:|
+     * | sensorsLogFile | string | - | - | No | If present, all the readings obtained with readSensor and readSensors are recorded (with their timestamps) in a binary log at the specified path. | The format of the log is described in yarpWholeBodySensorsLog.h . |
+     * | sensorsLogMaxSizeInMB | double | MB | 512 | No | Size of the file preallocated for the log. When the file is full, new readings are not recorded. | |
+     * | snapshotHistoryLength | int | - | 10 | No | Number of readings of each sensor stored to align the readings returned by readSensorsSnapshot. | |
+     *
+     * If the lazyDeviceOpening option (not in the WBI_SENSORS_OPTIONS group, see yarpWholeBodyActuators) is true,
+     * init does not open any control board or port: the devices needed by each sensor type are
+     * opened by the first readSensor(s) call of that type, and kept open until close.
+     * That call opens PolyDrivers and ports, taking hundreds of milliseconds: if it would happen
+     * inside a control loop, call warmUp before starting the loop.
      *
      */
     class yarpWholeBodySensors: public wbi::iWholeBodySensors
@@ -148,12 +205,58 @@ namespace yarpWbi
         //  from another sensor, such as the IMU)
         std::vector< AccelerometerRuntimeInfo > accelerometersReferenceIndeces;
 
+        // binary log of the readings (0 if logging is disabled)
+        yarpWholeBodySensorsLogWriter * sensorsLog;
+        std::vector<double> sensorsLogStamps; // buffer for the stamps, if not requested by the caller
+
+        bool openSensorsLog();
+
+        // lazy opening of the devices (lazyDeviceOpening option): the devices used by each
+        // sensor type are opened at its first read (sensorTypeOpened is indexed by wbi::SensorType,
+        // written with lazyOpeningMutex locked after a memoryBarrier and checked without the lock)
+        bool lazyDeviceOpening;
+        std::vector<char> sensorTypeOpened;
+        yarp::os::Mutex lazyOpeningMutex;
+        std::vector<std::string> ftPortNames;
+        std::vector<std::string> imuPortNames;
+
+        /** Open the devices of the sensors of the specified type, if they are not open yet */
+        bool openSensorsOfType(const wbi::SensorType st);
+        bool ensureSensorsOpen(const wbi::SensorType st);
+
+        // read statistics (the key of controlBoardsReadHealth is the wbi numeric controlboard id,
+        // the one of the ports vectors is the wbi numeric sensor id)
+        std::vector<sensorsReadHealth> controlBoardsReadHealth;
+        std::vector<sensorsReadHealth> ftPortsReadHealth;
+        std::vector<sensorsReadHealth> imuPortsReadHealth;
+        // protects the read statistics, that can be accessed by other threads (e.g. for monitoring)
+        mutable yarp::os::Mutex readHealthMutex;
+
+        void recordRead(sensorsReadHealth & health, const bool success, const double latency, const double dataAge=-1.0);
+        void recordTimeout(sensorsReadHealth & health, const double latency);
+        const sensorsReadHealth * findReadHealth(const std::string & name) const; // to be called with readHealthMutex locked
+
+        // histories used by readSensorsSnapshot, indexed by wbi::SensorType and sensor numeric id
+        std::vector< std::vector<sensorReadingsHistory> > snapshotHistories;
+        std::vector< std::vector<double> > snapshotReadings;
+        std::vector< std::vector<double> > snapshotReadingsStamps;
+
+        int getNrOfReadSensors(const wbi::SensorType st);
+        bool allocateSnapshotHistories();
+        bool readSensorsForSnapshot(const wbi::SensorType st, bool blocking);
+        bool readAlignedSensors(wholeBodySensorsSnapshot & snapshot, const bool useReferenceTime, double referenceTime,
+                                SnapshotAlignment alignment, bool blocking);
 
 
         //ControlBoard oriented sensors
         bool openPwm(const int controlBoard);
         bool openEncoder(const int controlBoard);
         bool openTorqueSensor(const int controlBoard);
+        /** Open all the sensors (encoders, pwm, torques) read from a control board */
+        bool openControlBoardSensors(const int controlBoard);
+        /** Read the number of axes of a control board, if not known yet */
+        bool readControlBoardAxes(const int controlBoard);
+        friend class sensorsStartupTask;
 
         //
         bool loadAccelerometerInfoFromConfig(const yarp::os::Searchable & opts,
@@ -197,6 +300,13 @@ namespace yarpWbi
         virtual bool init();
         virtual bool close();
 
+        /**
+         * Open the devices of all the sensors added, if the lazyDeviceOpening option is true
+         * (otherwise they are already opened by init).
+         * @return True if all the devices were opened, false otherwise.
+         */
+        bool warmUp();
+
         /**
          * Set the properties of the yarpWbiActuactors interface
          * Note: this function must be called before init, otherwise it takes no effect
@@ -268,6 +378,44 @@ namespace yarpWbi
          * @return True if the reading succeeded, false otherwise.
          */
         virtual bool readSensors(const wbi::SensorType st, double *data, double *stamps=0, bool blocking=true);
+
+        /**
+         * Get the read statistics of all the opened control boards and sensor ports.
+         */
+        std::vector<sensorsReadHealth> getReadHealth() const;
+
+        /**
+         * Get the read statistics of a control board or of a sensor port.
+         * @param name name of the control board (e.g. left_leg) or of the port (e.g. /icub/left_leg/analog:o)
+         * @return false if no control board or port with the specified name is opened, true otherwise.
+         */
+        bool getReadHealth(const std::string & name, sensorsReadHealth & health) const;
+
+        /**
+         * Reset all the read statistics.
+         * @note the read statistics can be accessed while another thread is reading the sensors.
+         */
+        void resetReadHealth();
+
+        /**
+         * Read all the added sensors, aligning their readings to a common reference time.
+         * The reference time is the oldest among the stamps of the newest reading of each sensor,
+         * so that no reading needs to be extrapolated.
+         * @param snapshot Output snapshot.
+         * @param alignment Method used to align the readings to the reference time.
+         * @param blocking If true, the reading is blocking, otherwise it is not.
+         * @return True if all the readings succeeded, false otherwise.
+         */
+        virtual bool readSensorsSnapshot(wholeBodySensorsSnapshot & snapshot,
+                                         SnapshotAlignment alignment=SNAPSHOT_LINEAR, bool blocking=true);
+
+        /**
+         * Read all the added sensors, aligning their readings to the specified reference time.
+         * @note readings are not extrapolated: if referenceTime is outside the
+         *       time interval stored for a sensor, its oldest (or newest) reading is used.
+         */
+        virtual bool readSensorsSnapshotAt(wholeBodySensorsSnapshot & snapshot, const double referenceTime,
+                                           SnapshotAlignment alignment=SNAPSHOT_LINEAR, bool blocking=true);
     };
 
 }
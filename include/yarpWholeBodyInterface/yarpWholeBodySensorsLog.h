@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef WBSENSORS_LOG_H
+#define WBSENSORS_LOG_H
+
+#include "yarpWholeBodyInterface/yarpWbiUtil.h"
+
+#include <wbi/wbiConstants.h>
+
+#include <vector>
+#include <string>
+
+namespace wbi {
+    class IDList;
+}
+
+namespace yarpWbi
+{
+    const int SENSORS_LOG_MAGIC = 0x53494257; ///< "WBIS" in little endian
+    const int SENSORS_LOG_VERSION = 1;
+    const int SENSORS_LOG_MAX_SENSOR_TYPES = 16;
+
+    /**
+     * Header at the beginning of a sensors log file.
+     *
+     * The file is organized as:
+     *  - the sensorsLogFileHeader
+     *  - a block of namesBlockSize bytes with the names of the logged sensors,
+     *    one line per sensor in the format "sensorTypeIndex sensorName"
+     *  - a sequence of records, starting at dataOffset and ending at writeOffset.
+     *
+     * Every record is a sensorsLogRecordHeader followed by the data of all the
+     * sensors of its type (nrOfSensors*dataSize doubles) and by their
+     * timestamps (nrOfSensors doubles), so all the records of a given
+     * type have the same size (recordSize[sensorType]).
+     *
+     * A reading of a single sensor is logged as a complete record of its type,
+     * in which the other sensors keep the last logged reading (and timestamp).
+     * The sensors that were never read have all their data and timestamp set to 0.
+     */
+    struct sensorsLogFileHeader
+    {
+        int magic;
+        int version;
+        int nrOfSensorTypes;
+        int namesBlockSize;
+        long long dataOffset;
+        long long writeOffset;    ///< end of the last complete record
+        long long capacity;
+        long long droppedRecords; ///< records not logged because the file was full
+        int nrOfSensors[SENSORS_LOG_MAX_SENSOR_TYPES];
+        int recordSize[SENSORS_LOG_MAX_SENSOR_TYPES];
+        long long nrOfRecords[SENSORS_LOG_MAX_SENSOR_TYPES];
+    };
+
+    struct sensorsLogRecordHeader
+    {
+        int sensorType;
+        int nrOfSensors;
+        double readTime; ///< local time at which the readSensors call returned
+    };
+
+    /**
+     * Append-only writer of the sensors log.
+     *
+     * The file is preallocated and memory mapped in open, so that
+     * logRecord does not allocate memory and does not perform any system call.
+     */
+    class yarpWholeBodySensorsLogWriter
+    {
+    private:
+        memoryMappedFile logFile;
+        sensorsLogFileHeader * header;
+        std::vector< std::vector<double> > lastData;   // last logged readings, indexed by sensor type
+        std::vector< std::vector<double> > lastStamps; // last logged stamps, indexed by sensor type
+
+        bool appendRecord(const wbi::SensorType st, const double readTime);
+
+    public:
+        yarpWholeBodySensorsLogWriter();
+        ~yarpWholeBodySensorsLogWriter();
+
+        /**
+         * Create the log file.
+         * @param path path of the log file
+         * @param capacityInBytes maximum size of the log file
+         * @param sensorLists list of the sensors that will be logged for each wbi::SensorType
+         * @return true if the operation succeeded, false otherwise.
+         */
+        bool open(const std::string & path,
+                  const size_t capacityInBytes,
+                  const std::vector<wbi::IDList> & sensorLists);
+
+        /**
+         * Append a record with the readings of all the sensors of a given type.
+         * @param st type of the logged sensors
+         * @param readTime time at which the readings were obtained
+         * @param data readings, as returned by readSensors
+         * @param stamps timestamps of the readings, if 0 readTime is used for all the sensors
+         * @return true if the record was appended, false otherwise (e.g. the log is full).
+         */
+        bool logRecord(const wbi::SensorType st, const double readTime,
+                       const double * data, const double * stamps);
+
+        /**
+         * Append a record with the reading of a single sensor.
+         * @param st type of the logged sensor
+         * @param sensor numeric id of the sensor
+         * @param readTime time at which the reading was obtained
+         * @param data reading, as returned by readSensor
+         * @param stamp timestamp of the reading, if 0 readTime is used
+         * @return true if the record was appended, false otherwise (e.g. the log is full).
+         */
+        bool logSensorRecord(const wbi::SensorType st, const int sensor, const double readTime,
+                             const double * data, const double * stamp);
+
+        bool close();
+
+        bool isOpen() const;
+
+        /** Number of records that were not logged because the file was full */
+        long long getNrOfDroppedRecords() const;
+    };
+
+    /**
+     * Reader of a sensors log written by yarpWholeBodySensorsLogWriter.
+     *
+     * The log is memory mapped in open, and the offsets of the records of each
+     * sensor type are indexed, so that the records can be accessed randomly
+     * without copies.
+     */
+    class yarpWholeBodySensorsLogReader
+    {
+    private:
+        memoryMappedFile logFile;
+        const sensorsLogFileHeader * header;
+        wbi::IDList emptyList;
+        std::vector<wbi::IDList> sensorLists;
+        std::vector< std::vector<long long> > recordOffsets; // indexed by sensor type
+        std::vector<long long> allRecordOffsets;             // all the records, in log order
+
+        const sensorsLogRecordHeader * recordHeader(const long long offset) const;
+
+    public:
+        yarpWholeBodySensorsLogReader();
+        ~yarpWholeBodySensorsLogReader();
+
+        bool open(const std::string & path);
+        bool close();
+        bool isOpen() const;
+
+        /** List of the sensors of type st in the log */
+        const wbi::IDList & getSensorList(const wbi::SensorType st) const;
+
+        /** Number of records of type st */
+        int getNrOfRecords(const wbi::SensorType st) const;
+
+        /** Number of records of all types */
+        int getNrOfRecords() const;
+
+        double getRecordTime(const wbi::SensorType st, const int record) const;
+        const double * getRecordData(const wbi::SensorType st, const int record) const;
+        const double * getRecordStamps(const wbi::SensorType st, const int record) const;
+
+        /**
+         * Access to the records of all types, in the order in which they were logged.
+         */
+        double getRecordTime(const int record) const;
+        wbi::SensorType getRecordSensorType(const int record) const;
+
+        /** Time of the first and of the last record in the log */
+        double getStartTime() const;
+        double getEndTime() const;
+    };
+
+    /**
+     * Number of doubles in the reading of a single sensor of type st.
+     */
+    int sensorsLogDataSize(const wbi::SensorType st);
+}
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef WBSENSORS_REPLAY_H
+#define WBSENSORS_REPLAY_H
+
+#include "yarpWholeBodyInterface/yarpWholeBodySensors.h"
+#include "yarpWholeBodyInterface/yarpWholeBodySensorsLog.h"
+
+#include <vector>
+
+namespace yarpWbi
+{
+    /**
+     * Sensors interface that serves the readings recorded in a sensors log
+     * (see the sensorsLogFile option of yarpWholeBodySensors), without
+     * opening any control board or port.
+     *
+     * The options of this class should be placed in the WBI_SENSORS_OPTIONS group.
+     *
+     * # WBI_SENSORS_OPTIONS
+     *
+     * | Parameter name | Type | Units | Default Value | Required | Description | Notes |
+     * |:--------------:|:------:|:-----:|:-------------:|:--------:|:-----------:|:-----:|
+     * | replayLogFile | string | - | - | Yes | Path of the sensors log to replay. | All the added sensors must be present in the log. The accelerometers that are not in the log (or that were never read while recording) are replayed from the IMUs they are derived from (see the WBI_YARP_ACCELEROMETERS group). |
+     * | replayMode | string | - | realtime | No | One of realtime, fast or stepped (see ReplayMode). | |
+     * | replaySpeed | double | - | 1.0 | No | Ratio between the replay time and the wall clock time, used only by the realtime mode. | |
+     *
+     */
+    class yarpWholeBodySensorsReplay: public yarpWholeBodySensors
+    {
+    public:
+        enum ReplayMode
+        {
+            /** The log time advances with the wall clock (scaled by replaySpeed),
+                the readings are the last ones recorded before the current log time. */
+            REPLAY_REAL_TIME,
+            /** Each readSensors call returns the next record of its sensor type. */
+            REPLAY_AS_FAST_AS_POSSIBLE,
+            /** The log time advances only when calling step or setReplayTime. */
+            REPLAY_STEPPED
+        };
+
+    protected:
+        yarpWholeBodySensorsLogReader logReader;
+        ReplayMode replayMode;
+        double replaySpeed;
+        double replayTime;                 // current time, in the log time axis
+        double replayWallClockStart;       // wall clock time corresponding to the start of the log
+        bool replayStarted;
+        int lastSteppedRecord;             // last record (of any type) reached by step
+        std::vector<int> currentRecord;    // current record of each sensor type, -1 if none
+        std::vector< std::vector<int> > sensorIndexInLog; // map from the wbi numeric id to the index in the log
+        bool replayAccelerometersFromIMUs; // true if the accelerometers are read from the records of their IMUs
+
+        const wbi::IDList & getReplayedSensorList(const wbi::SensorType st);
+        int updateCurrentRecord(const wbi::SensorType st, bool advance, bool blocking);
+        void copyRecord(const wbi::SensorType st, const int record, const int sensor,
+                        double *data, double *stamps);
+        void copyAccelerometersFromIMURecord(const int imuRecord, const int sensor,
+                                             double *data, double *stamps);
+        bool readAccelerometersFromIMUs(const int sensor, double *data, double *stamps, bool blocking);
+
+    public:
+        yarpWholeBodySensorsReplay(const char* _name,
+                                   const yarp::os::Property & _yarp_wbi_properties=yarp::os::Property());
+
+        virtual ~yarpWholeBodySensorsReplay();
+
+        virtual bool init();
+        virtual bool close();
+
+        virtual bool readSensor(const wbi::SensorType st, const int sensor,
+                                double *data, double *stamps=0, bool blocking=true);
+
+        virtual bool readSensors(const wbi::SensorType st, double *data, double *stamps=0, bool blocking=true);
+
+        /**
+         * Advance the replay time to the time of the next record in the log.
+         * @return false if the end of the log has been reached, true otherwise.
+         */
+        bool step();
+
+        /**
+         * Set the replay time (in the log time axis).
+         * @note in realtime mode the replay continues from the specified time.
+         */
+        bool setReplayTime(const double time);
+
+        double getReplayTime() const;
+
+        /** True if all the records of the log have been replayed */
+        bool isReplayFinished() const;
+    };
+}
+
+#endif
@@ -132,6 +132,8 @@ namespace yarpWbi
             yarp::sig::Vector lastBasePos;                // last Base Position
             yarp::sig::Vector lastBaseVel;                // last Base Velocity
             yarp::sig::Vector lastBaseAcc;                // last Base Acceleration
+            double lastBaseStateStamp;                    // time at which the last remote Base state was estimated by its source
+            double lastBaseStateExtrapolationHorizon;     // time for which the last remote Base state has been extrapolated
         }
         estimates;
 
@@ -204,6 +206,9 @@ namespace yarpWbi
      * | estimatorPeriod| double | milliseconds | 10 | No | Period (in milliseconds) of the estimator thread | For undeliyng limitations of the yarp::os::RateThread class, this period should not be lower of 1.0 ms . |
      * | estimateBaseState | -   | -            | -  | No | Necessary for estimation of root roto translation and velocity. If not present these estimates will always return 0  | | 
      * | externalFloatingBaseStatePort     | string | - | - | - | If present, reads the floating base state (position, velocities and acceleration from an external port, using the format described in remoteFloatingBaseStateEstimator class. | Not compatible with localWorldReferenceFrame option  |
+     * | externalFloatingBaseStateBinaryFormat | bool | - | false | No | If true, the floating base state read from externalFloatingBaseStatePort is in the binary format of floatingBaseStateMessage, instead of a Bottle. | |
+     * | externalFloatingBaseStateExtrapolation | string | - | none | No | Model used to extrapolate the floating base state read from externalFloatingBaseStatePort to the time at which it is read: none, acceleration or constantTwist (see remoteFloatingBaseStateEstimator). | |
+     * | externalFloatingBaseStateMaxExtrapolationHorizon | double | seconds | 0.1 | No | Maximum time for which the floating base state read from externalFloatingBaseStatePort is extrapolated. | |
      * | localWorldReferenceFrame | string | - | - | No | If present, specifies the default frame for computation of the world-to-root rototranslation.  | Not compatible with the externalFloatingBaseStatePort |
      * | cutOffFrequencyTorqueInHz  | double | Hz | 3.0 | No | Specify the cutoff frequency of the first order filter used to filter joint torque measurements, motor torque measurements and pwm | |
      * | cutOffFrequencyVelocitiesInHz | double | Hz | (If not present, no filter is used) | No | If present, specify the cutoff frequency of the first order filter used to filter joint velocities measurements. If not present, no filter is used. | |
@@ -270,6 +275,12 @@ namespace yarpWbi
         virtual bool init();
         virtual bool close();
 
+        /**
+         * Open the devices of all the sensors used by the added estimates, if they are opened lazily
+         * (see yarpWholeBodySensors::warmUp).
+         */
+        bool warmUp();
+
         /**
          * Set the properties of the yarpWbiActuactors interface
          * Note: this function must be called before init, otherwise it takes no effect
@@ -340,6 +351,13 @@ namespace yarpWbi
          * @param value Value of the parameter to set.
          * @return True if the operation succeeded, false otherwise. */
         virtual bool setEstimationParameter(const wbi::EstimateType et, const wbi::EstimationParameter ep, const void *value);
+
+        /** Get the timing of the last base state read from the remote floating base estimator,
+         * to check how old the base state returned by getEstimates is.
+         * @param stamp Time at which the last base state was estimated by its source.
+         * @param extrapolationHorizon Time for which that base state has been extrapolated.
+         * @return True if the base state is given by the remote estimator, false otherwise. */
+        bool getBaseStateTiming(double & stamp, double & extrapolationHorizon);
     };
 
 
@@ -18,21 +18,146 @@
 #include "floatingBaseEstimators.h"
 
 #include <wbi/wbiUtil.h>
+#include <yarp/os/Bottle.h>
 #include <yarp/os/LockGuard.h>
 #include <yarp/os/Log.h>
+#include <yarp/os/Network.h>
 #include <yarp/os/Time.h>
+#include <yarp/os/Vocab.h>
+#include <yarp/os/ConnectionReader.h>
+#include <yarp/os/ConnectionWriter.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+// Tag at the beginning of each floatingBaseStateMessage, to detect senders using a different format
+#define FLOATING_BASE_STATE_MESSAGE_TAG VOCAB4('f','b','s','1')
 
 namespace yarpWbi
 {
 
+/** Skew symmetric matrix such that skew(w)*v = w x v */
+static inline Eigen::Matrix3d skew(const Eigen::Vector3d & w)
+{
+    Eigen::Matrix3d S;
+    S <<  0.0, -w(2),  w(1),
+         w(2),   0.0, -w(0),
+        -w(1),  w(0),   0.0;
+    return S;
+}
+
+/**
+ * Compute exp(skew(phi)) (the rotation of an angle |phi| around phi) and, if V is not null,
+ * the integral of exp(skew(phi)*s) for s in [0,1], i.e. the left jacobian of SO(3).
+ */
+static void so3Exponential(const Eigen::Vector3d & phi, Eigen::Matrix3d & R, Eigen::Matrix3d * V)
+{
+    double theta = phi.norm();
+    double sinc, cosc, sincc;  // sin(theta)/theta, (1-cos(theta))/theta^2, (theta-sin(theta))/theta^3
+    if( theta < 1e-3 )
+    {
+        double theta2 = theta*theta;
+        sinc  = 1.0 - theta2/6.0;
+        cosc  = 0.5 - theta2/24.0;
+        sincc = 1.0/6.0 - theta2/120.0;
+    }
+    else
+    {
+        sinc  = sin(theta)/theta;
+        cosc  = (1.0-cos(theta))/(theta*theta);
+        sincc = (theta-sin(theta))/(theta*theta*theta);
+    }
+
+    Eigen::Matrix3d K = skew(phi);
+    Eigen::Matrix3d K2 = K*K;
+    R = Eigen::Matrix3d::Identity() + sinc*K + cosc*K2;
+    if( V )
+    {
+        *V = Eigen::Matrix3d::Identity() + cosc*K + sincc*K2;
+    }
+}
+
+/**
+ * Propagate the floating base state of a time horizon, with the conventions of remoteFloatingBaseStateEstimator:
+ * the angular velocity and acceleration are expressed in the world frame, so the rotation is premultiplied.
+ */
+static void extrapolateFloatingBaseState(floatingBaseStateMessage & state,
+                                         const floatingBaseStateExtrapolation extrapolation,
+                                         const double h)
+{
+    Eigen::Map< Eigen::Matrix<double,4,4,Eigen::RowMajor> > H(state.basePosition);
+    Eigen::Map<Eigen::Vector3d> v(state.baseVelocity);
+    Eigen::Map<Eigen::Vector3d> w(state.baseVelocity+3);
+    Eigen::Map<Eigen::Vector3d> a(state.baseAcceleration);
+    Eigen::Map<Eigen::Vector3d> dw(state.baseAcceleration+3);
+
+    Eigen::Matrix3d deltaR, V;
+    Eigen::Vector3d position = H.topRightCorner<3,1>();
+    Eigen::Matrix3d rotation = H.topLeftCorner<3,3>();
+
+    if( extrapolation == SECOND_ORDER_EXTRAPOLATION )
+    {
+        // rotation vector of the Magnus expansion truncated at the first commutator term
+        so3Exponential(w*h + 0.5*dw*h*h - (h*h*h/12.0)*w.cross(dw),deltaR,0);
+        position += v*h + 0.5*a*h*h;
+        v += a*h;
+        w += dw*h;
+    }
+    else if( extrapolation == CONSTANT_TWIST_EXTRAPOLATION )
+    {
+        // with a constant twist the velocity of the origin of the base is dp/dt = exp(skew(w)*t)*v
+        so3Exponential(w*h,deltaR,&V);
+        position += h*V*v;
+        v = deltaR*v;
+    }
+    else
+    {
+        return;
+    }
+
+    H.topLeftCorner<3,3>() = deltaR*rotation;
+    H.topRightCorner<3,1>() = position;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 /// localFloatingBaseStateEstimator methods
 //////////////////////////////////////////////////////////////////////////////
 
+void computeBaseVelocityOfFixedLink(const double * jacobian, const int dof, const double * dq, double * base_vel_estimate)
+{
+    typedef Eigen::Matrix<double,6,Eigen::Dynamic,Eigen::RowMajor> JacobianType;
+    Eigen::Map<const JacobianType> jacobianWrapper(jacobian, 6, dof+6);
+
+#ifndef NDEBUG
+    // base block of the jacobian in the mixed representation: [I X; 0 I], with X = -skew(r)
+    const double structureTolerance = 1e-9;
+    assert((jacobianWrapper.block<3,3>(0,0).isIdentity(structureTolerance)));
+    assert((jacobianWrapper.block<3,3>(3,0).isZero(structureTolerance)));
+    assert((jacobianWrapper.block<3,3>(3,3).isIdentity(structureTolerance)));
+    assert((jacobianWrapper.block<3,3>(0,3) + jacobianWrapper.block<3,3>(0,3).transpose()).isZero(structureTolerance));
+#endif
+
+    // The link is fixed in the world, so J_b*v_b + J_j*dq = 0. With J_b = [I X; 0 I], X = -skew(r) and r
+    // the position of the link with respect to the base origin, the base velocity is computed
+    // in closed form from (l;w) = J_j*dq:
+    //    omega_b = -w
+    //    v_b     = -l - X*omega_b = -l - r x w
+    Eigen::Map<const Eigen::VectorXd> dqVect(dq, dof);
+    Eigen::Map< Eigen::Matrix<double,6,1> > baseVelocityWrapper(base_vel_estimate);
+    Eigen::Matrix<double,6,1> linkVelocityDueToJoints;
+
+    linkVelocityDueToJoints.noalias() = jacobianWrapper.rightCols(dof) * dqVect;
+
+    baseVelocityWrapper.tail<3>() = -linkVelocityDueToJoints.tail<3>();
+    baseVelocityWrapper.head<3>() = -linkVelocityDueToJoints.head<3>()
+                                    + jacobianWrapper.block<3,3>(0,3) * linkVelocityDueToJoints.tail<3>();
+}
+
 localFloatingBaseStateEstimator::localFloatingBaseStateEstimator(wbi::iWholeBodyModel * _wholeBodyModel, int _dof):
     wholeBodyModel(NULL),
-    robot_reference_frame_link(-1),
-    luDecompositionOfBaseJacobian(6)
+    robot_reference_frame_link(-1)
 {
     init(_wholeBodyModel,_dof);
 }
@@ -84,15 +209,12 @@ bool localFloatingBaseStateEstimator::computeBaseVelocity(double* qj, double* dq
 {
     if (!wholeBodyModel) return false;
 
-    complete_jacobian.setZero();
-    Eigen::Map<Eigen::VectorXd> dqjVect(dqj, dof);
-    Eigen::Map<Eigen::VectorXd> baseVelocityWrapper(base_vel_estimate, 6);
-    baseVelocityWrapper.setZero();
-
-    wholeBodyModel->computeJacobian(qj, world_H_rootLink, robot_reference_frame_link, complete_jacobian.data());
-    luDecompositionOfBaseJacobian.compute(complete_jacobian.leftCols<6>());
+    if( !wholeBodyModel->computeJacobian(qj, world_H_rootLink, robot_reference_frame_link, complete_jacobian.data()) )
+    {
+        return false;
+    }
 
-    baseVelocityWrapper =-luDecompositionOfBaseJacobian.solve(complete_jacobian.rightCols(dof) * dqjVect);
+    computeBaseVelocityOfFixedLink(complete_jacobian.data(), dof, dqj, base_vel_estimate);
 
     return true;
 }
@@ -103,14 +225,11 @@ bool localFloatingBaseStateEstimator::computeBaseVelocity(double* qj, double* dq
 //////////////////////////////////////////////////////////////////////////////
 
 remoteFloatingBaseStateEstimator::remoteFloatingBaseStateEstimator():
-    callbackHandler(this->buff_mutex),
-    measureAvailable(false)
+    timeoutLimit_in_seconds(1.0),
+    timeoutDetected(false),
+    extrapolation(NO_EXTRAPOLATION),
+    maxExtrapolationHorizon(0.1)
 {
-    callbackHandler.setBuffers(this->base_pos_estimate,
-                               this->base_vel_estimate,
-                               this->base_acc_estimate,
-                               &(this->lastTimestamp));
-    callbackHandler.setFlags(&(this->measureAvailable));
 }
 
 
@@ -122,6 +241,32 @@ bool remoteFloatingBaseStateEstimator::open(yarp::os::Searchable &config)
 
     timeoutLimit_in_seconds = config.check("timeoutLimit", yarp::os::Value(1.0), "time limit after which a timeout is raised").asDouble();
 
+    std::string extrapolationName = config.check("extrapolation", yarp::os::Value("none"), "model used to extrapolate the state to the time at which it is read").asString().c_str();
+    if( extrapolationName == "none" )
+    {
+        extrapolation = NO_EXTRAPOLATION;
+    }
+    else if( extrapolationName == "acceleration" )
+    {
+        extrapolation = SECOND_ORDER_EXTRAPOLATION;
+    }
+    else if( extrapolationName == "constantTwist" )
+    {
+        extrapolation = CONSTANT_TWIST_EXTRAPOLATION;
+    }
+    else
+    {
+        yError("remoteFloatingBaseEstimator::open() error unknown extrapolation %s (none, acceleration or constantTwist)", extrapolationName.c_str());
+        return false;
+    }
+
+    maxExtrapolationHorizon = config.check("maxExtrapolationHorizon", yarp::os::Value(0.1), "maximum time for which the state is extrapolated").asDouble();
+
+    bool binaryFormat = config.check("binaryFormat") && config.find("binaryFormat").asBool();
+    callbackHandler.setBinaryFormat(binaryFormat);
+    callbackHandler.reset();
+    timeoutDetected = false;
+
 
     local.clear();
     remote.clear();
@@ -140,12 +285,13 @@ bool remoteFloatingBaseStateEstimator::open(yarp::os::Searchable &config)
         return false;
     }
 
+    // the messages are deserialized directly by callbackHandler, in the thread of the port
+    inputPort.setReader(callbackHandler);
     if (!inputPort.open(local.c_str()))
     {
         yError("remoteFloatingBaseEstimator::open() error could not open port %s, check network",local.c_str());
         return false;
     }
-    inputPort.useCallback(callbackHandler);
 
     bool ok=yarp::os::Network::connect(remote.c_str(), local.c_str(), carrier.c_str());
     if (!ok)
@@ -165,123 +311,184 @@ bool remoteFloatingBaseStateEstimator::close()
     return true;
 }
 
-bool remoteFloatingBaseStateEstimator::getBasePosition(double* _base_pos_estimate)
+bool remoteFloatingBaseStateEstimator::getLatestState(floatingBaseStateMessage & state)
 {
-    yarp::os::LockGuard guard(buff_mutex);
-    updateTimeout();
-    if( measureAvailable )
+    double receiptTimestamp = 0.0;
+    if( !callbackHandler.getLatestState(state,receiptTimestamp) )
     {
-        memcpy(_base_pos_estimate,this->base_pos_estimate,BASE_POS_ESTIMATE_SIZE*sizeof(double));
-        return true;
+        return false;
     }
-    else
+
+    if( (yarp::os::Time::now() - receiptTimestamp) > timeoutLimit_in_seconds )
     {
-        yWarning("remoteFloatingBaseStateEstimator::getBasePosition called, but no floating base pos estimate is available");
+        if( !timeoutDetected )
+        {
+            yError("remoteFloatingBaseStateEstimator::getLatestState() : timeout detected");
+            timeoutDetected = true;
+        }
         return false;
     }
+
+    timeoutDetected = false;
+    return true;
+}
+
+bool remoteFloatingBaseStateEstimator::getBasePosition(double* _base_pos_estimate)
+{
+    double base_vel_estimate[BASE_VEL_ESTIMATE_SIZE];
+    double base_acc_estimate[BASE_ACC_ESTIMATE_SIZE];
+    return getBaseState(_base_pos_estimate,base_vel_estimate,base_acc_estimate);
 }
 
 bool remoteFloatingBaseStateEstimator::getBaseVelocity(double* _base_vel_estimate)
 {
-    yarp::os::LockGuard guard(buff_mutex);
-    updateTimeout();
-    if( measureAvailable )
-    {
-        memcpy(_base_vel_estimate,this->base_vel_estimate,BASE_VEL_ESTIMATE_SIZE*sizeof(double));
-        return true;
-    }
-    else
-    {
-        yWarning("remoteFloatingBaseStateEstimator::getBaseVelocity called, but no floating base vel estimate is available");
-        return false;
-    }
+    double base_pos_estimate[BASE_POS_ESTIMATE_SIZE];
+    double base_acc_estimate[BASE_ACC_ESTIMATE_SIZE];
+    return getBaseState(base_pos_estimate,_base_vel_estimate,base_acc_estimate);
 }
 
 bool remoteFloatingBaseStateEstimator::getBaseAcceleration(double* _base_acc_estimate)
 {
-    yarp::os::LockGuard guard(buff_mutex);
-    updateTimeout();
-    if( measureAvailable )
-    {
-        memcpy(_base_acc_estimate,this->base_acc_estimate,BASE_ACC_ESTIMATE_SIZE*sizeof(double));
-        return true;
-    }
-    else
-    {
-        yWarning("remoteFloatingBaseStateEstimator::getBaseAcceleration called, but no floating base vel estimate is available");
-        return false;
-    }
+    double base_pos_estimate[BASE_POS_ESTIMATE_SIZE];
+    double base_vel_estimate[BASE_VEL_ESTIMATE_SIZE];
+    return getBaseState(base_pos_estimate,base_vel_estimate,_base_acc_estimate);
 }
 
 bool remoteFloatingBaseStateEstimator::getBaseState(double* _base_pos_estimate,
                                                     double* _base_vel_estimate,
-                                                    double* _base_acc_estimate)
+                                                    double* _base_acc_estimate,
+                                                    double* _sourceTimestamp,
+                                                    double* _extrapolationHorizon)
 {
-    yarp::os::LockGuard guard(buff_mutex);
-    updateTimeout();
-    if( measureAvailable )
-    {
-        memcpy(_base_pos_estimate,this->base_pos_estimate,BASE_POS_ESTIMATE_SIZE*sizeof(double));
-        memcpy(_base_vel_estimate,this->base_vel_estimate,BASE_VEL_ESTIMATE_SIZE*sizeof(double));
-        memcpy(_base_acc_estimate,this->base_acc_estimate,BASE_ACC_ESTIMATE_SIZE*sizeof(double));
-        return true;
-    }
-    else
+    return getBaseStateAt(yarp::os::Time::now(),
+                          _base_pos_estimate,
+                          _base_vel_estimate,
+                          _base_acc_estimate,
+                          _sourceTimestamp,
+                          _extrapolationHorizon);
+}
+
+bool remoteFloatingBaseStateEstimator::getBaseStateAt(const double time,
+                                                      double* _base_pos_estimate,
+                                                      double* _base_vel_estimate,
+                                                      double* _base_acc_estimate,
+                                                      double* _sourceTimestamp,
+                                                      double* _extrapolationHorizon)
+{
+    floatingBaseStateMessage state;
+    if( !getLatestState(state) )
     {
         yWarning("remoteFloatingBaseStateEstimator::getBaseState called, but no floating base state estimate is available");
         return false;
     }
+
+    double horizon = 0.0;
+    if( extrapolation != NO_EXTRAPOLATION )
+    {
+        // a negative horizon can only be caused by the offset between the clocks of the source and of the reader
+        horizon = (std::max)(0.0,(std::min)(time-state.timestamp,maxExtrapolationHorizon));
+        extrapolateFloatingBaseState(state,extrapolation,horizon);
+    }
+
+    memcpy(_base_pos_estimate,state.basePosition,BASE_POS_ESTIMATE_SIZE*sizeof(double));
+    memcpy(_base_vel_estimate,state.baseVelocity,BASE_VEL_ESTIMATE_SIZE*sizeof(double));
+    memcpy(_base_acc_estimate,state.baseAcceleration,BASE_ACC_ESTIMATE_SIZE*sizeof(double));
+    if( _sourceTimestamp )
+    {
+        *_sourceTimestamp = state.timestamp;
+    }
+    if( _extrapolationHorizon )
+    {
+        *_extrapolationHorizon = horizon;
+    }
+    return true;
 }
 
-void remoteFloatingBaseStateEstimator::updateTimeout()
+
+floatingBaseStateMessage::floatingBaseStateMessage():
+    sequenceNumber(0),
+    timestamp(0.0)
 {
-    if( !measureAvailable ) return;
+    memset(basePosition,0,BASE_POS_ESTIMATE_SIZE*sizeof(double));
+    memset(baseVelocity,0,BASE_VEL_ESTIMATE_SIZE*sizeof(double));
+    memset(baseAcceleration,0,BASE_ACC_ESTIMATE_SIZE*sizeof(double));
+}
 
-    double now = yarp::os::Time::now();
-    if( (now - lastTimestamp) > timeoutLimit_in_seconds )
+bool floatingBaseStateMessage::read(yarp::os::ConnectionReader& connection)
+{
+    int tag = connection.expectInt();
+    if( connection.isError() || tag != FLOATING_BASE_STATE_MESSAGE_TAG )
     {
-        yError("remoteFloatingBaseStateEstimator::updateTimeout() : timeout detected");
-        measureAvailable = false;
+        return false;
     }
 
-    return;
-}
+    sequenceNumber = connection.expectInt();
+    timestamp = connection.expectDouble();
 
+    bool ok = connection.expectBlock((char*)basePosition,BASE_POS_ESTIMATE_SIZE*sizeof(double));
+    ok = ok && connection.expectBlock((char*)baseVelocity,BASE_VEL_ESTIMATE_SIZE*sizeof(double));
+    ok = ok && connection.expectBlock((char*)baseAcceleration,BASE_ACC_ESTIMATE_SIZE*sizeof(double));
 
-remoteFloatingBaseStatePortProcessor::remoteFloatingBaseStatePortProcessor(yarp::os::Mutex & _mutex):
-    base_pos_mat(4,4),
-    base_vel_vec(6),
-    base_acc_vec(6),
-    mutex(_mutex),
-    base_pos_estimate_buf(0),
-    base_vel_estimate_buf(0),
-    base_acc_estimate_buf(0),
-    measureAvailableFlag(0)
+    return ok && !connection.isError();
+}
+
+bool floatingBaseStateMessage::write(yarp::os::ConnectionWriter& connection)
 {
+    connection.appendInt(FLOATING_BASE_STATE_MESSAGE_TAG);
+    connection.appendInt(sequenceNumber);
+    connection.appendDouble(timestamp);
+
+    // the blocks are not copied: the message must not be modified until the write is completed
+    connection.appendExternalBlock((const char*)basePosition,BASE_POS_ESTIMATE_SIZE*sizeof(double));
+    connection.appendExternalBlock((const char*)baseVelocity,BASE_VEL_ESTIMATE_SIZE*sizeof(double));
+    connection.appendExternalBlock((const char*)baseAcceleration,BASE_ACC_ESTIMATE_SIZE*sizeof(double));
+
+    return !connection.isError();
 }
 
+remoteFloatingBaseStatePortProcessor::remoteFloatingBaseStatePortProcessor():
+    latestSlot(-1),
+    binaryFormat(false),
+    lastSequenceNumber(0),
+    lastSourceTimestamp(0.0)
+{
+    for(int slot=0; slot < 2; slot++ )
+    {
+        slots[slot].receiptTimestamp = 0.0;
+        slots[slot].version = 0;
+    }
+}
 
+void remoteFloatingBaseStatePortProcessor::setBinaryFormat(bool _binaryFormat)
+{
+    this->binaryFormat = _binaryFormat;
+}
 
-void remoteFloatingBaseStatePortProcessor::setBuffers(double* _base_pos_estimate_buf,
-                                                      double* _base_vel_estimate_buf,
-                                                      double* _base_acc_estimate_buf,
-                                                      double* _lastTimestamp
-                                                     )
+void remoteFloatingBaseStatePortProcessor::reset()
 {
-    base_pos_estimate_buf = _base_pos_estimate_buf;
-    base_vel_estimate_buf = _base_vel_estimate_buf;
-    base_acc_estimate_buf = _base_acc_estimate_buf;
-    lastTimestamp         = _lastTimestamp;
-    return;
+    latestSlot = -1;
+    memoryBarrier();
 }
 
-void remoteFloatingBaseStatePortProcessor::setFlags(bool* _measureAvailableFlag)
+bool remoteFloatingBaseStatePortProcessor::isStale(const floatingBaseStateMessage & state) const
 {
-    this->measureAvailableFlag = _measureAvailableFlag;
+    if( latestSlot < 0 )
+    {
+        return false;
+    }
+
+    // duplicated and reordered messages are older than the published one in both sequence and time,
+    // while a restarted source starts again its sequence numbers but with a newer timestamp
+    return state.sequenceNumber <= lastSequenceNumber && state.timestamp <= lastSourceTimestamp;
 }
 
-bool bot2Matrix(yarp::os::Bottle * p_bot, yarp::sig::Matrix & matrix)
+bool bot2Matrix(yarp::os::Bottle * p_bot, double * matrix)
 {
+    if( !p_bot || p_bot->size() != 3 )
+    {
+        return false;
+    }
+
     int rows = p_bot->get(0).asDouble();
     int cols = p_bot->get(1).asDouble();
     if( rows != 4 || cols != 4 )
@@ -289,43 +496,45 @@ bool bot2Matrix(yarp::os::Bottle * p_bot, yarp::sig::Matrix & matrix)
         return false;
     }
 
-    matrix.resize(rows,cols);
     yarp::os::Bottle * data_bot = p_bot->get(2).asList();
 
-    if( data_bot->size() != rows*cols )
+    if( !data_bot || data_bot->size() != rows*cols )
     {
         return false;
     }
 
-    for(int row =0; row < rows; row++ )
+    for(int el = 0; el < rows*cols; el++ )
     {
-        for(int col = 0; col < cols; col++ )
-        {
-            matrix(row,col) = data_bot->get(cols*row+col).asDouble();
-        }
+        matrix[el] = data_bot->get(el).asDouble();
     }
 
     return true;
 }
 
-bool bot2Vector(yarp::os::Bottle * p_bot, yarp::sig::Vector & vec )
+bool bot2Vector(yarp::os::Bottle * p_bot, double * vec )
 {
-    if( p_bot->size() != 6 )
+    if( !p_bot || p_bot->size() != 6 )
     {
         return false;
     }
 
     for(int i=0; i < 6; i++ )
     {
-        vec(i) = p_bot->get(i).asDouble();
+        vec[i] = p_bot->get(i).asDouble();
     }
 
     return true;
 }
 
-void remoteFloatingBaseStatePortProcessor::onRead(yarp::os::Bottle& b)
+bool remoteFloatingBaseStatePortProcessor::readBottle(yarp::os::ConnectionReader& connection,
+                                                      floatingBaseStateMessage & state)
 {
-    yarp::os::LockGuard guard(mutex);
+    // the bottle is reused, to avoid allocating its content at each message
+    yarp::os::Bottle & b = bottleBuffer;
+    if( !b.read(connection) )
+    {
+        return false;
+    }
 
     // process the bottle
     if( b.size() != 3 ||
@@ -333,32 +542,99 @@ void remoteFloatingBaseStatePortProcessor::onRead(yarp::os::Bottle& b)
         !(b.get(1).isList()) ||
         !(b.get(2).isList()) )
     {
-        yError("remoteFloatingBaseStatePortProcessor::onRead : bottle is not made up of 3 list");
-        return;
+        yError("remoteFloatingBaseStatePortProcessor::read : bottle is not made up of 3 list");
+        return false;
     }
 
-
     // Try to read the base matrix
     bool ok = true;
-    ok = bot2Matrix(b.get(0).asList(),base_pos_mat);
-    ok = ok && bot2Vector(b.get(1).asList(),base_vel_vec);
-    ok = ok && bot2Vector(b.get(2).asList(),base_acc_vec);
+    ok = bot2Matrix(b.get(0).asList(),state.basePosition);
+    ok = ok && bot2Vector(b.get(1).asList(),state.baseVelocity);
+    ok = ok && bot2Vector(b.get(2).asList(),state.baseAcceleration);
 
     if( !ok )
     {
-        yError("remoteFloatingBaseStatePortProcessor::onRead : deserialization failed");
-        return;
+        yError("remoteFloatingBaseStatePortProcessor::read : deserialization failed");
+        return false;
     }
 
-    // copy the data
-    memcpy(base_pos_estimate_buf,base_pos_mat.data(),BASE_POS_ESTIMATE_SIZE*sizeof(double));
-    memcpy(base_vel_estimate_buf,base_vel_vec.data(),BASE_VEL_ESTIMATE_SIZE*sizeof(double));
-    memcpy(base_acc_estimate_buf,base_acc_vec.data(),BASE_ACC_ESTIMATE_SIZE*sizeof(double));
+    // the Bottle format does not carry the time of the estimate
+    state.timestamp = yarp::os::Time::now();
+    return true;
+}
 
-    *lastTimestamp = yarp::os::Time::now();
-    *measureAvailableFlag = true;
+bool remoteFloatingBaseStatePortProcessor::read(yarp::os::ConnectionReader& connection)
+{
+    // read is called only by the thread of the port, so the slot
+    // that is not published can be written without synchronization
+    int writtenSlot = (latestSlot == 0) ? 1 : 0;
+    stateSlot & slot = slots[writtenSlot];
+
+    slot.version++;
+    memoryBarrier();
+
+    // the message is deserialized straight in the buffers of the slot
+    bool ok;
+    bool stale = false;
+    if( binaryFormat && !connection.isTextMode() )
+    {
+        ok = slot.state.read(connection);
+        if( !ok )
+        {
+            yError("remoteFloatingBaseStatePortProcessor::read : the message is not a valid floatingBaseStateMessage");
+        }
+        stale = ok && isStale(slot.state);
+    }
+    else
+    {
+        ok = readBottle(connection,slot.state);
+    }
+    slot.receiptTimestamp = yarp::os::Time::now();
+
+    memoryBarrier();
+    slot.version++;
+
+    // a slot is published only if it contains a complete state, newer than the published one
+    if( ok && !stale )
+    {
+        lastSequenceNumber = slot.state.sequenceNumber;
+        lastSourceTimestamp = slot.state.timestamp;
+        memoryBarrier();
+        latestSlot = writtenSlot;
+    }
 
-    return;
+    return ok;
+}
+
+bool remoteFloatingBaseStatePortProcessor::getLatestState(floatingBaseStateMessage & state, double & receiptTimestamp) const
+{
+    while( true )
+    {
+        int readSlot = latestSlot;
+        if( readSlot < 0 )
+        {
+            return false;
+        }
+        memoryBarrier();
+
+        const stateSlot & slot = slots[readSlot];
+        int versionBeforeCopy = slot.version;
+        if( versionBeforeCopy % 2 != 0 )
+        {
+            // the slot is being rewritten, in the meanwhile the other one was published
+            continue;
+        }
+        memoryBarrier();
+
+        state = slot.state;
+        receiptTimestamp = slot.receiptTimestamp;
+
+        memoryBarrier();
+        if( slot.version == versionBeforeCopy )
+        {
+            return true;
+        }
+    }
 }
 
 
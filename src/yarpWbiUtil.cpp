@@ -22,8 +22,24 @@
 
 #include <yarp/os/Log.h>
 #include <yarp/os/LogStream.h>
+#include <yarp/os/LockGuard.h>
+#include <yarp/os/Mutex.h>
+#include <yarp/os/Thread.h>
+#include <yarp/os/Time.h>
 #include <kdl_codyco/treeserialization.hpp>
 #include <cmath>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 static const std::string WBI_YARP_JOINTS_GROUP = "WBI_YARP_JOINTS";
 const std::string yarpWbi::ErrorDomain = "wbi.yarp.error";
@@ -38,17 +54,28 @@ namespace yarpWbi
 bool openPolyDriver(const std::string &localName,
                     const std::string &robotName,
                     yarp::dev::PolyDriver *&pd,
-                    const std::string &bodyPartName)
+                    const std::string &bodyPartName,
+                    const std::string &deviceName,
+                    const std::string &streamingCarrier)
 {
     std::string localPort  = "/" + localName + "/" + bodyPartName;
     std::string remotePort = "/" + robotName + "/" + bodyPartName;
     yarp::os::Property options;
     options.put("robot",robotName.c_str());
     options.put("part",bodyPartName.c_str());
-    options.put("device","remote_controlboard");
+    options.put("device",deviceName.c_str());
     options.put("local",localPort.c_str());
     options.put("remote",remotePort.c_str());
-    options.put("writeStrict","on");
+    if( streamingCarrier.empty() )
+    {
+        options.put("writeStrict","on");
+    }
+    else
+    {
+        // the command port does not wait for the previous message to be delivered
+        options.put("writeStrict","off");
+        options.put("carrier",streamingCarrier.c_str());
+    }
 
     pd = new yarp::dev::PolyDriver(options);
     if(!pd || !(pd->isValid()))
@@ -59,6 +86,15 @@ bool openPolyDriver(const std::string &localName,
     return true;
 }
 
+std::string getControlBoardDeviceName(const yarp::os::Searchable & wbi_yarp_properties)
+{
+    if( wbi_yarp_properties.check("controlBoardDevice") )
+    {
+        return wbi_yarp_properties.find("controlBoardDevice").asString().c_str();
+    }
+    return "remote_controlboard";
+}
+
 bool closePolyDriver(yarp::dev::PolyDriver *&pd)
 {
     if( !pd || !(pd->isValid()) )
@@ -74,28 +110,316 @@ bool closePolyDriver(yarp::dev::PolyDriver *&pd)
     return ret;
 }
 
+namespace
+{
+    /** Control board driver shared by several users in the same process */
+    struct sharedControlBoardDriver
+    {
+        yarp::dev::PolyDriver * driver;
+        int nrOfUsers;
+    };
+
+    yarp::os::Mutex sharedControlBoardDriversMutex;
+    // the key is device:/robot/part, followed by ?streaming=carrier for the streaming drivers
+    std::map<std::string,sharedControlBoardDriver> sharedControlBoardDrivers;
+}
+
+bool openControlBoardDriver(const std::string &localName,
+                            const std::string &robotName,
+                            yarp::dev::PolyDriver *&pd,
+                            const std::string &bodyPartName,
+                            const yarp::os::Searchable & wbi_yarp_properties,
+                            const std::string &streamingCarrier)
+{
+    std::string deviceName = getControlBoardDeviceName(wbi_yarp_properties);
+    bool shared = wbi_yarp_properties.check("shareControlBoardDrivers")
+                  && wbi_yarp_properties.find("shareControlBoardDrivers").asBool();
+    if( !shared )
+    {
+        return openPolyDriver(localName,robotName,pd,bodyPartName,deviceName,streamingCarrier);
+    }
+
+    // a streaming driver is shared only by the users that asked for the same carrier
+    std::string key = deviceName + ":/" + robotName + "/" + bodyPartName;
+    if( !streamingCarrier.empty() )
+    {
+        key += "?streaming=" + streamingCarrier;
+    }
+    {
+        yarp::os::LockGuard guard(sharedControlBoardDriversMutex);
+        std::map<std::string,sharedControlBoardDriver>::iterator it = sharedControlBoardDrivers.find(key);
+        if( it != sharedControlBoardDrivers.end() )
+        {
+            it->second.nrOfUsers++;
+            pd = it->second.driver;
+            return true;
+        }
+    }
+
+    // the driver is opened without holding the lock, so different parts can be opened in parallel
+    // (the local ports are named after the first user of the driver)
+    yarp::dev::PolyDriver * newDriver = 0;
+    if( !openPolyDriver(localName,robotName,newDriver,bodyPartName,deviceName,streamingCarrier) )
+    {
+        pd = newDriver;
+        return false;
+    }
+
+    yarp::os::LockGuard guard(sharedControlBoardDriversMutex);
+    std::map<std::string,sharedControlBoardDriver>::iterator it = sharedControlBoardDrivers.find(key);
+    if( it != sharedControlBoardDrivers.end() )
+    {
+        // the same part was opened concurrently by another user: use its driver
+        newDriver->close();
+        delete newDriver;
+        it->second.nrOfUsers++;
+        pd = it->second.driver;
+        return true;
+    }
+
+    sharedControlBoardDriver entry;
+    entry.driver = newDriver;
+    entry.nrOfUsers = 1;
+    sharedControlBoardDrivers[key] = entry;
+    pd = newDriver;
+    return true;
+}
+
+bool closeControlBoardDriver(yarp::dev::PolyDriver *&pd)
+{
+    if( !pd )
+    {
+        return true;
+    }
+
+    {
+        yarp::os::LockGuard guard(sharedControlBoardDriversMutex);
+        std::map<std::string,sharedControlBoardDriver>::iterator it;
+        for(it = sharedControlBoardDrivers.begin(); it != sharedControlBoardDrivers.end(); it++ )
+        {
+            if( it->second.driver != pd )
+            {
+                continue;
+            }
+
+            it->second.nrOfUsers--;
+            if( it->second.nrOfUsers > 0 )
+            {
+                pd = 0;
+                return true;
+            }
+            sharedControlBoardDrivers.erase(it);
+            break;
+        }
+    }
+
+    bool ret = pd->close();
+    delete pd;
+    pd = 0;
+    return ret;
+}
+
+namespace
+{
+    /** Tasks shared by the workers of runTasksInParallel */
+    struct parallelTaskQueue
+    {
+        const std::vector<parallelTask*> * tasks;
+        std::vector<char> results;
+        std::vector<double> durations;
+        int nextTask;
+        yarp::os::Mutex mutex;
+
+        void executeNextTasks()
+        {
+            while( true )
+            {
+                int task;
+                {
+                    yarp::os::LockGuard guard(mutex);
+                    task = nextTask++;
+                }
+                if( task >= (int)tasks->size() )
+                {
+                    return;
+                }
+                double start = yarp::os::Time::now();
+                results[task] = (*tasks)[task]->execute();
+                durations[task] = yarp::os::Time::now() - start;
+            }
+        }
+    };
+
+    class parallelTaskWorker: public yarp::os::Thread
+    {
+    private:
+        parallelTaskQueue * queue;
+
+    public:
+        parallelTaskWorker(parallelTaskQueue * _queue): queue(_queue)
+        {
+        }
+
+        virtual void run()
+        {
+            queue->executeNextTasks();
+        }
+    };
+}
+
+bool runTasksInParallel(const std::vector<parallelTask*> & tasks,
+                        const int nrOfWorkers,
+                        std::vector<double> * durations)
+{
+    parallelTaskQueue queue;
+    queue.tasks = &tasks;
+    queue.results.assign(tasks.size(),0);
+    queue.durations.assign(tasks.size(),0.0);
+    queue.nextTask = 0;
+
+    // the calling thread executes the tasks too, so nrOfWorkers-1 threads are started
+    int nrOfThreads = std::min(nrOfWorkers,(int)tasks.size()) - 1;
+    std::vector<parallelTaskWorker*> workers;
+    for(int i=0; i < nrOfThreads; i++ )
+    {
+        parallelTaskWorker * worker = new parallelTaskWorker(&queue);
+        if( !worker->start() )
+        {
+            delete worker;
+            break;
+        }
+        workers.push_back(worker);
+    }
+
+    queue.executeNextTasks();
+
+    for(int i=0; i < (int)workers.size(); i++ )
+    {
+        workers[i]->join();
+        delete workers[i];
+    }
+
+    if( durations )
+    {
+        *durations = queue.durations;
+    }
+
+    bool ok = true;
+    for(int task=0; task < (int)tasks.size(); task++ )
+    {
+        if( !queue.results[task] )
+        {
+            yError() << "yarpWbi::runTasksInParallel: failed" << tasks[task]->getDescription();
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool runStartupTasks(const std::string & component,
+                     const std::vector<parallelTask*> & tasks,
+                     const yarp::os::Searchable & wbi_yarp_properties)
+{
+    bool parallelStartup = wbi_yarp_properties.check("parallelStartup")
+                           && wbi_yarp_properties.find("parallelStartup").asBool();
+    int nrOfWorkers = 1;
+    if( parallelStartup )
+    {
+        nrOfWorkers = wbi_yarp_properties.check("startupWorkers",yarp::os::Value(8)).asInt();
+    }
+
+    std::vector<double> durations;
+    double start = yarp::os::Time::now();
+    bool ok = runTasksInParallel(tasks,nrOfWorkers,&durations);
+    double elapsed = yarp::os::Time::now() - start;
+
+    if( parallelStartup )
+    {
+        yInfo("%s: startup completed in %.3f s with %d workers", component.c_str(), elapsed, nrOfWorkers);
+        for(int task=0; task < (int)tasks.size(); task++ )
+        {
+            yInfo("%s:    %.3f s  %s", component.c_str(), durations[task], tasks[task]->getDescription().c_str());
+        }
+    }
+
+    return ok;
+}
+
 yarp::os::Bottle & getWBIYarpJointsOptions(yarp::os::Property & wbi_yarp_properties)
 {
     return wbi_yarp_properties.findGroup(WBI_YARP_JOINTS_GROUP);
 }
 
+configurationGroupIndex::configurationGroupIndex(): group(0)
+{
+}
+
+configurationGroupIndex::configurationGroupIndex(const yarp::os::Bottle & group): group(0)
+{
+    build(group);
+}
+
+void configurationGroupIndex::build(const yarp::os::Bottle & _group)
+{
+    group = &_group;
+    elements.clear();
+    for(int el=0; el < group->size(); el++ )
+    {
+        yarp::os::Bottle * element = group->get(el).asList();
+        if( element && element->size() > 0 )
+        {
+            // as in Bottle::find, the first element with a given name hides the following ones
+            elements.insert(std::pair<std::string,int>(element->get(0).asString().c_str(),el));
+        }
+    }
+}
+
+yarp::os::Value & configurationGroupIndex::find(const std::string & name) const
+{
+    std::map<std::string,int>::const_iterator it = elements.find(name);
+    if( it == elements.end() )
+    {
+        return yarp::os::Value::getNullValue();
+    }
+
+    yarp::os::Bottle * element = group->get(it->second).asList();
+    if( element->size() == 2 )
+    {
+        return element->get(1);
+    }
+    // elements not in the (name value) form are rare, leave their handling to the Bottle
+    return group->find(name.c_str());
+}
+
+bool configurationGroupIndex::check(const std::string & name) const
+{
+    return elements.find(name) != elements.end();
+}
+
 bool appendNewControlBoardsToVector(yarp::os::Bottle & joints_config,
                                     const wbi::IDList & jointIdList,
                                     std::vector<std::string> & controlBoardNames)
+{
+    return appendNewControlBoardsToVector(configurationGroupIndex(joints_config),jointIdList,controlBoardNames);
+}
+
+bool appendNewControlBoardsToVector(const configurationGroupIndex & joints_config_index,
+                                    const wbi::IDList & jointIdList,
+                                    std::vector<std::string> & controlBoardNames)
 {
     for(int jnt=0; jnt < (int)jointIdList.size(); jnt++ )
     {
         wbi::ID jnt_name;
         jointIdList.indexToID(jnt,jnt_name);
 
-        if( !joints_config.check(jnt_name.toString().c_str()) )
+        if( !joints_config_index.check(jnt_name.toString()) )
         {
             yError() << "wholeBodyInterface error: joint " << jnt_name.toString() <<
                          "not found in WBI_YARP_JOINTS section of configuration file ";
             return false;
         }
 
-        yarp::os::Bottle * ctrlBoard_mapping = joints_config.find(jnt_name.toString().c_str()).asList();
+        yarp::os::Bottle * ctrlBoard_mapping = joints_config_index.find(jnt_name.toString()).asList();
         if( !ctrlBoard_mapping || ctrlBoard_mapping->size() != 2 )
         {
             yError() << "wholeBodyInterface error: joint " << jnt_name.toString() <<
@@ -116,57 +440,49 @@ bool getControlBoardAxisList(yarp::os::Bottle & joints_config,
                                                           const wbi::IDList &jointIdList,
                                                           const std::vector<std::string>& controlBoardNames,
                                                           std::vector< std::pair<int,int> > & controlBoardAxisList)
+{
+    return getControlBoardAxisList(configurationGroupIndex(joints_config),jointIdList,controlBoardNames,controlBoardAxisList);
+}
+
+bool getControlBoardAxisList(const configurationGroupIndex & joints_config_index,
+                             const wbi::IDList &jointIdList,
+                             const std::vector<std::string>& controlBoardNames,
+                             std::vector< std::pair<int,int> > & controlBoardAxisList)
 {
     std::map<std::string,int> controlBoardIds = getControlBoardIdsMap(controlBoardNames);
 
     assert(controlBoardIds.size() == controlBoardNames.size());
 
-    //Error check loop
+    controlBoardAxisList.resize(jointIdList.size());
     for(int wbi_jnt=0; wbi_jnt < (int)jointIdList.size(); wbi_jnt++ )
     {
         wbi::ID wbi_jnt_name;
         jointIdList.indexToID(wbi_jnt,wbi_jnt_name);
 
-        //std::cout << joints_config.toString() << std::endl;
-
-        if( joints_config.find(wbi_jnt_name.toString().c_str()).isNull() )
+        yarp::os::Value & ctrlBoard_mapping_val = joints_config_index.find(wbi_jnt_name.toString());
+        if( ctrlBoard_mapping_val.isNull() )
         {
             yError() << "yarpWbiUtil error: joint " << wbi_jnt_name.toString() << " not found in WBI_YARP_JOINTS section ";
             return false;
         }
 
-        yarp::os::Bottle * ctrlBoard_mapping = joints_config.find(wbi_jnt_name.toString().c_str()).asList();
-
-        if( ctrlBoard_mapping->size() != 2 )
+        yarp::os::Bottle * ctrlBoard_mapping = ctrlBoard_mapping_val.asList();
+        if( !ctrlBoard_mapping || ctrlBoard_mapping->size() != 2 )
         {
             yError() << "yarpWbiUtil error: joint " << wbi_jnt_name.toString() << " found in WBI_YARP_JOINTS section, but with wrong format ";
             return false;
         }
 
         std::string controlboard_name = ctrlBoard_mapping->get(0).asString().c_str();
-        if( controlBoardIds.find(controlboard_name) == controlBoardIds.end() )
+        std::map<std::string,int>::const_iterator controlboard_wbi_id = controlBoardIds.find(controlboard_name);
+        if( controlboard_wbi_id == controlBoardIds.end() )
         {
             yError() << "yarpWbiUtil :: getControlBoardAxisList error in configuration files with joint " << wbi_jnt_name.toString();
             return false;
         }
-    }
-
-    controlBoardAxisList.resize(jointIdList.size());
-    for(int wbi_jnt=0; wbi_jnt < (int)jointIdList.size(); wbi_jnt++ )
-    {
-        wbi::ID wbi_jnt_name;
-        jointIdList.indexToID(wbi_jnt,wbi_jnt_name);
-
-        yarp::os::Bottle * ctrlBoard_mapping = joints_config.find(wbi_jnt_name.toString().c_str()).asList();
-
-        std::string controlboard_name = ctrlBoard_mapping->get(0).asString().c_str();
-
 
         int controlboard_jnt_axis = ctrlBoard_mapping->get(1).asInt();
-        int controlboard_wbi_id   = controlBoardIds[controlboard_name];
-
-        //totalControlledJointsInControlBoard[controlboard_wbi_id]++;
-        controlBoardAxisList[wbi_jnt] = std::pair<int,int>(controlboard_wbi_id,controlboard_jnt_axis);
+        controlBoardAxisList[wbi_jnt] = std::pair<int,int>(controlboard_wbi_id->second,controlboard_jnt_axis);
     }
     return true;
 }
@@ -200,42 +516,18 @@ bool loadJointsControlBoardFromConfig(yarp::os::Property & wbi_yarp_properties,
                                       std::vector<std::string> & controlBoardNames,
                                       std::vector< std::pair<int,int> > & controlBoardAxisList)
 {
-    yarp::os::Bottle & joints_config = getWBIYarpJointsOptions(wbi_yarp_properties);
+    configurationGroupIndex joints_config_index(getWBIYarpJointsOptions(wbi_yarp_properties));
 
     //First check that all the joint in the jointIdList an appropriate controlboard mapping is defined
     controlBoardNames.clear();
-    if (!appendNewControlBoardsToVector(joints_config,jointIdList,controlBoardNames))
+    if (!appendNewControlBoardsToVector(joints_config_index,jointIdList,controlBoardNames))
     {
         return false;
     }
 
-    std::map<std::string,int> controlBoardIds = getControlBoardIdsMap(controlBoardNames);
-
-
-    //Resizing structures
-    controlBoardAxisList.resize(jointIdList.size());
-    //totalControlledJointsInControlBoard.resize(controlBoardNames.size(),0);
-    getControlBoardAxisList(joints_config,jointIdList,controlBoardNames,controlBoardAxisList);
-
-
     //All elements in the jointIdList have a mapping to an axis of a controlboard
     //we have to save this mapping
-    for (int wbi_jnt = 0; wbi_jnt < (int)jointIdList.size(); wbi_jnt++)
-    {
-        wbi::ID wbi_jnt_name;
-        jointIdList.indexToID(wbi_jnt,wbi_jnt_name);
-
-        yarp::os::Bottle * ctrlBoard_mapping = joints_config.find(wbi_jnt_name.toString().c_str()).asList();
-
-        std::string controlboard_name = ctrlBoard_mapping->get(0).asString().c_str();
-        int controlboard_jnt_axis = ctrlBoard_mapping->get(1).asInt();
-        int controlboard_wbi_id   = controlBoardIds[controlboard_name];
-
-        //totalControlledJointsInControlBoard[controlboard_wbi_id]++;
-        controlBoardAxisList[wbi_jnt] = std::pair<int,int>(controlboard_wbi_id,controlboard_jnt_axis);
-    }
-
-    return true;
+    return getControlBoardAxisList(joints_config_index,jointIdList,controlBoardNames,controlBoardAxisList);
 }
 
 bool loadSensorPortsFromConfig(yarp::os::Property & wbi_yarp_properties,
@@ -251,11 +543,11 @@ bool loadSensorPortsFromConfig(yarp::os::Property & wbi_yarp_properties,
 
     ports.resize(sensorIdList.size());
 
-
+    configurationGroupIndex ports_index(ports_list);
     for(int sensor_index = 0; sensor_index < (int)sensorIdList.size(); sensor_index++ ) {
         wbi::ID sensorID;
         sensorIdList.indexToID(sensor_index,sensorID);
-        yarp::os::Value & port = ports_list.find(sensorID.toString());
+        yarp::os::Value & port = ports_index.find(sensorID.toString());
         if( (port.isNull()) || !(port.isString()) ) {
             yError() << "yarpWbi::loadSensorPortsFromConfig error: " << ports_list.toString() <<
                          " returned an error when search for port of sensor " << sensorID.toString();
@@ -293,9 +585,9 @@ bool loadIMUSensorPortsFromConfig(yarp::os::Property & wbi_yarp_properties,
 bool loadIdListsFromConfigRecursiveHelper(std::string & requested_list,
                                           std::vector<std::string> & lists_names_stack,
                                           std::vector<std::string> & id_list_elements,
-                                          yarp::os::Bottle & list_bots)
+                                          const configurationGroupIndex & list_index)
 {
-    const yarp::os::Bottle * requested_list_bot = list_bots.find(requested_list).asList();
+    const yarp::os::Bottle * requested_list_bot = list_index.find(requested_list).asList();
     //std::cout << "[INFO] Requested list bot: " << requested_list_bot->toString() << std::endl;
     if( requested_list_bot == NULL )
     {
@@ -316,10 +608,10 @@ bool loadIdListsFromConfigRecursiveHelper(std::string & requested_list,
     for( int el = 0; el < requested_list_bot->size(); el++ )
     {
         std::string id_to_add = requested_list_bot->get(el).asString();
-        if( !(list_bots.find(id_to_add).isNull()) )
+        if( list_index.check(id_to_add) )
         {
             //Composite list, expand the element
-            bool ok = loadIdListsFromConfigRecursiveHelper(id_to_add,lists_names_stack,id_list_elements,list_bots);
+            bool ok = loadIdListsFromConfigRecursiveHelper(id_to_add,lists_names_stack,id_list_elements,list_index);
 
             if( !ok )
             {
@@ -336,17 +628,12 @@ bool loadIdListsFromConfigRecursiveHelper(std::string & requested_list,
     return true;
 }
 
-bool loadIdListFromConfig(std::string requested_list,
-                          const yarp::os::Searchable & wbi_yarp_properties,
-                          wbi::IDList & requestedIdList,
-                          std::string list_group,
-                          bool verbose
-                         )
+bool loadIdListFromIndex(std::string requested_list,
+                         const configurationGroupIndex & list_index,
+                         wbi::IDList & requestedIdList,
+                         bool verbose)
 {
-    yarp::os::ConstString list_group_cstr = list_group;
-    yarp::os::Bottle & list_bot = wbi_yarp_properties.findGroup(list_group_cstr);
-    yarp::os::ConstString requested_list_cstr = requested_list;
-    yarp::os::Value & requested_list_val = list_bot.find(requested_list_cstr);
+    yarp::os::Value & requested_list_val = list_index.find(requested_list);
     yarp::os::Bottle * requested_list_bot = requested_list_val.asList();
 
     if( requested_list_val.isNull() || (requested_list_bot == NULL) )
@@ -359,7 +646,7 @@ bool loadIdListFromConfig(std::string requested_list,
     std::vector<std::string> ids;
     std::vector<std::string> lists_names_stack;
 
-    bool ret = loadIdListsFromConfigRecursiveHelper(requested_list,lists_names_stack,ids,list_bot);
+    bool ret = loadIdListsFromConfigRecursiveHelper(requested_list,lists_names_stack,ids,list_index);
 
     if( !ret )
     {
@@ -378,6 +665,19 @@ bool loadIdListFromConfig(std::string requested_list,
     return ret;
 }
 
+bool loadIdListFromConfig(std::string requested_list,
+                          const yarp::os::Searchable & wbi_yarp_properties,
+                          wbi::IDList & requestedIdList,
+                          std::string list_group,
+                          bool verbose
+                         )
+{
+    yarp::os::ConstString list_group_cstr = list_group;
+    yarp::os::Bottle & list_bot = wbi_yarp_properties.findGroup(list_group_cstr);
+
+    return loadIdListFromIndex(requested_list,configurationGroupIndex(list_bot),requestedIdList,verbose);
+}
+
 std::string stringFromInt(int num)
 {
     std::stringstream numStream;
@@ -448,11 +748,13 @@ bool motorTorqueParametersFromBottleDescription(const yarp::os::Bottle &bottle,
 
         if (listSpecification.isList()) {
             // If the list param is a (YARP) list, load the IDList from it
+            // (the lists are indexed once, and not searched for each element)
+            configurationGroupIndex listIndex(wbiConfigProp.findGroup("WBI_ID_LISTS"));
             for (int jnt = 0; jnt < listSpecification.asList()->size(); jnt++)
             {
                 yarp::os::ConstString subElementName = listSpecification.asList()->get(jnt).asString();
                 wbi::IDList sublist;
-                if (yarpWbi::loadIdListFromConfig(subElementName, wbiConfigProp, sublist)) {
+                if (loadIdListFromIndex(subElementName.c_str(), listIndex, sublist, false)) {
                     idList.addIDList(sublist);
                 } else {
                     idList.addID(wbi::ID(subElementName.c_str()));
@@ -467,4 +769,387 @@ bool motorTorqueParametersFromBottleDescription(const yarp::os::Bottle &bottle,
         return true;
     }
 
+
+void memoryBarrier()
+{
+#ifdef _MSC_VER
+    _ReadWriteBarrier();
+    _mm_mfence();
+#else
+    __sync_synchronize();
+#endif
+}
+
+memoryMappedFile::memoryMappedFile(): fileDescriptor(-1), mappedData(0), mappedSize(0), writable(false)
+{
+}
+
+memoryMappedFile::~memoryMappedFile()
+{
+    close();
+}
+
+bool memoryMappedFile::create(const std::string & path, size_t size)
+{
+#ifndef _WIN32
+    if( isOpen() || size == 0 )
+    {
+        return false;
+    }
+
+    fileDescriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if( fileDescriptor < 0 )
+    {
+        yError("memoryMappedFile: impossible to create file %s", path.c_str());
+        return false;
+    }
+
+    if( ::ftruncate(fileDescriptor, (off_t)size) != 0 )
+    {
+        yError("memoryMappedFile: impossible to resize file %s to %lu bytes", path.c_str(), (unsigned long)size);
+        ::close(fileDescriptor);
+        fileDescriptor = -1;
+        return false;
+    }
+
+    void * mapping = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    if( mapping == MAP_FAILED )
+    {
+        yError("memoryMappedFile: impossible to map file %s", path.c_str());
+        ::close(fileDescriptor);
+        fileDescriptor = -1;
+        return false;
+    }
+
+    mappedData = (char *)mapping;
+    mappedSize = size;
+    writable = true;
+    return true;
+#else
+    yError("memoryMappedFile: memory mapped files are not supported on this platform");
+    return false;
+#endif
+}
+
+bool memoryMappedFile::openReadOnly(const std::string & path)
+{
+#ifndef _WIN32
+    if( isOpen() )
+    {
+        return false;
+    }
+
+    fileDescriptor = ::open(path.c_str(), O_RDONLY);
+    if( fileDescriptor < 0 )
+    {
+        return false;
+    }
+
+    struct stat fileStatus;
+    if( ::fstat(fileDescriptor, &fileStatus) != 0 || fileStatus.st_size <= 0 )
+    {
+        ::close(fileDescriptor);
+        fileDescriptor = -1;
+        return false;
+    }
+
+    void * mapping = ::mmap(0, (size_t)fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    if( mapping == MAP_FAILED )
+    {
+        yError("memoryMappedFile: impossible to map file %s", path.c_str());
+        ::close(fileDescriptor);
+        fileDescriptor = -1;
+        return false;
+    }
+
+    mappedData = (char *)mapping;
+    mappedSize = (size_t)fileStatus.st_size;
+    writable = false;
+    return true;
+#else
+    yError("memoryMappedFile: memory mapped files are not supported on this platform");
+    return false;
+#endif
+}
+
+bool memoryMappedFile::close(size_t finalSize)
+{
+#ifndef _WIN32
+    if( !isOpen() )
+    {
+        return true;
+    }
+
+    bool ret = (::munmap(mappedData, mappedSize) == 0);
+
+    if( writable && finalSize > 0 && finalSize < mappedSize )
+    {
+        ret = ret && (::ftruncate(fileDescriptor, (off_t)finalSize) == 0);
+    }
+
+    ret = (::close(fileDescriptor) == 0) && ret;
+
+    fileDescriptor = -1;
+    mappedData = 0;
+    mappedSize = 0;
+    writable = false;
+    return ret;
+#else
+    return true;
+#endif
+}
+
+bool memoryMappedFile::isOpen() const
+{
+    return mappedData != 0;
+}
+
+char * memoryMappedFile::data()
+{
+    return mappedData;
+}
+
+const char * memoryMappedFile::data() const
+{
+    return mappedData;
+}
+
+size_t memoryMappedFile::size() const
+{
+    return mappedSize;
+}
+
+latencyHistogram::latencyHistogram()
+{
+    reset();
+}
+
+void latencyHistogram::reset()
+{
+    for(int bin = 0; bin < NR_OF_BINS; bin++)
+    {
+        counts[bin] = 0;
+    }
+    nrOfSamples = 0;
+    sum = 0.0;
+    max = 0.0;
+}
+
+double latencyHistogram::getBinUpperBound(const int bin)
+{
+    return 1e-5*(1 << bin);
+}
+
+void latencyHistogram::add(const double latency)
+{
+    int bin = 0;
+    while( bin < NR_OF_BINS-1 && latency > getBinUpperBound(bin) )
+    {
+        bin++;
+    }
+    counts[bin]++;
+    nrOfSamples++;
+    sum += latency;
+    if( latency > max )
+    {
+        max = latency;
+    }
+}
+
+double latencyHistogram::getMean() const
+{
+    return nrOfSamples > 0 ? sum/nrOfSamples : 0.0;
+}
+
+double latencyHistogram::getPercentile(const double percentile) const
+{
+    if( nrOfSamples == 0 )
+    {
+        return 0.0;
+    }
+
+    long long threshold = (long long)ceil(percentile*nrOfSamples);
+    long long cumulative = 0;
+    for(int bin = 0; bin < NR_OF_BINS-1; bin++)
+    {
+        cumulative += counts[bin];
+        if( cumulative >= threshold )
+        {
+            return getBinUpperBound(bin);
+        }
+    }
+    return max;
+}
+
+namespace
+{
+    /** Unit quaternion (w, x, y, z) of an orientation in axis-angle (x, y, z, angle) */
+    void axisAngleToQuaternion(const double * axisAngle, double * quat)
+    {
+        double axisNorm = sqrt(axisAngle[0]*axisAngle[0]+axisAngle[1]*axisAngle[1]+axisAngle[2]*axisAngle[2]);
+        quat[0] = cos(0.5*axisAngle[3]);
+        double s = (axisNorm > 0.0) ? sin(0.5*axisAngle[3])/axisNorm : 0.0;
+        for(int i = 0; i < 3; i++)
+        {
+            quat[i+1] = s*axisAngle[i];
+        }
+    }
+
+    /**
+     * Spherical linear interpolation of two orientations in axis-angle.
+     * The result is expressed with the axis of from if the interpolated rotation is the identity.
+     */
+    void slerpAxisAngle(const double * from, const double * to, const double alpha, double * result)
+    {
+        double q0[4], q1[4], q[4];
+        axisAngleToQuaternion(from,q0);
+        axisAngleToQuaternion(to,q1);
+
+        // interpolate along the shortest path
+        double cosTheta = q0[0]*q1[0]+q0[1]*q1[1]+q0[2]*q1[2]+q0[3]*q1[3];
+        if( cosTheta < 0.0 )
+        {
+            cosTheta = -cosTheta;
+            for(int i = 0; i < 4; i++) q1[i] = -q1[i];
+        }
+
+        double w0 = 1.0-alpha, w1 = alpha;
+        if( cosTheta < 1.0-1e-9 )
+        {
+            double theta = acos(cosTheta);
+            w0 = sin((1.0-alpha)*theta)/sin(theta);
+            w1 = sin(alpha*theta)/sin(theta);
+        }
+        for(int i = 0; i < 4; i++)
+        {
+            q[i] = w0*q0[i]+w1*q1[i];
+        }
+
+        // q is not normalized, but atan2 does not depend on its norm
+        if( q[0] < 0.0 )
+        {
+            for(int i = 0; i < 4; i++) q[i] = -q[i];
+        }
+        double sinHalfAngle = sqrt(q[1]*q[1]+q[2]*q[2]+q[3]*q[3]);
+        if( sinHalfAngle < 1e-12 )
+        {
+            result[0] = from[0]; result[1] = from[1]; result[2] = from[2];
+            result[3] = 0.0;
+            return;
+        }
+        for(int i = 0; i < 3; i++)
+        {
+            result[i] = q[i+1]/sinHalfAngle;
+        }
+        result[3] = 2.0*atan2(sinHalfAngle,q[0]);
+    }
+}
+
+sensorReadingsHistory::sensorReadingsHistory(): dataSize(0), capacity(0), nrOfSamples(0), newest(-1)
+{
+}
+
+void sensorReadingsHistory::resize(const int _dataSize, const int _capacity)
+{
+    dataSize = _dataSize;
+    capacity = _capacity;
+    samples.assign(dataSize*capacity,0.0);
+    stamps.assign(capacity,0.0);
+    clear();
+}
+
+void sensorReadingsHistory::clear()
+{
+    nrOfSamples = 0;
+    newest = -1;
+}
+
+int sensorReadingsHistory::bufferIndex(const int sample) const
+{
+    return (newest - (nrOfSamples-1-sample) + capacity) % capacity;
+}
+
+bool sensorReadingsHistory::push(const double * data, const double stamp)
+{
+    if( capacity <= 0 || (nrOfSamples > 0 && stamp <= stamps[newest]) )
+    {
+        return false;
+    }
+
+    newest = (newest+1) % capacity;
+    memcpy(&(samples[newest*dataSize]),data,dataSize*sizeof(double));
+    stamps[newest] = stamp;
+    if( nrOfSamples < capacity )
+    {
+        nrOfSamples++;
+    }
+    return true;
+}
+
+int sensorReadingsHistory::size() const
+{
+    return nrOfSamples;
+}
+
+double sensorReadingsHistory::getNewestStamp() const
+{
+    return nrOfSamples > 0 ? stamps[newest] : 0.0;
+}
+
+bool sensorReadingsHistory::getReadingAt(const double time, const bool linear, double * data, double * stamp,
+                                         const bool axisAngleOrientation) const
+{
+    if( nrOfSamples == 0 )
+    {
+        return false;
+    }
+
+    // first sample not older than time
+    int after = 0;
+    while( after < nrOfSamples && stamps[bufferIndex(after)] < time )
+    {
+        after++;
+    }
+
+    int lo, hi;
+    if( after == 0 )
+    {
+        lo = hi = bufferIndex(0);
+    }
+    else if( after == nrOfSamples )
+    {
+        lo = hi = bufferIndex(nrOfSamples-1);
+    }
+    else
+    {
+        lo = bufferIndex(after-1);
+        hi = bufferIndex(after);
+    }
+
+    int nearest = (time-stamps[lo] <= stamps[hi]-time) ? lo : hi;
+    if( stamp != 0 )
+    {
+        *stamp = stamps[nearest];
+    }
+
+    if( !linear || lo == hi )
+    {
+        memcpy(data,&(samples[nearest*dataSize]),dataSize*sizeof(double));
+        return true;
+    }
+
+    double alpha = (time-stamps[lo])/(stamps[hi]-stamps[lo]);
+    int firstLinearValue = 0;
+    if( axisAngleOrientation )
+    {
+        slerpAxisAngle(&(samples[lo*dataSize]),&(samples[hi*dataSize]),alpha,data);
+        firstLinearValue = 4;
+    }
+    for(int i = firstLinearValue; i < dataSize; i++)
+    {
+        data[i] = (1.0-alpha)*samples[lo*dataSize+i] + alpha*samples[hi*dataSize+i];
+    }
+    return true;
+}
+
 }
@@ -17,12 +17,26 @@
 
 #define MAX_NJ 20
 #include "yarpWholeBodyActuators.h"
+#include "PIDList.h"
 #include <wbi/wbiConstants.h>
 #include <wbi/Error.h>
 #include <yarp/os/LogStream.h>
 #include <yarp/os/Property.h>
+#include <yarp/os/Thread.h>
+#include <yarp/os/LockGuard.h>
+#include <yarp/os/Time.h>
+#include <yarp/conf/version.h>
 #include <string>
 #include <cassert>
+#include <cmath>
+#include <algorithm>
+
+// ITorqueControl::setRefTorques for a group of joints is available since YARP 2.3.65
+#if YARP_VERSION_MAJOR > 2 || \
+    (YARP_VERSION_MAJOR == 2 && YARP_VERSION_MINOR > 3) || \
+    (YARP_VERSION_MAJOR == 2 && YARP_VERSION_MINOR == 3 && YARP_VERSION_PATCH >= 65)
+#define WBI_YARP_HAS_GROUP_REF_TORQUES
+#endif
 
 using namespace std;
 using namespace wbi;
@@ -32,6 +46,9 @@ using namespace yarp::dev;
 
 #define WAIT_TIME 0.001         ///< waiting time in seconds before retrying to perform an operation that has failed
 #define DEFAULT_REF_SPEED 10.0  ///< default reference joint speed for the joint position control
+#define DEFAULT_REFERENCE_KEEP_ALIVE_PERIOD 0.1  ///< default period (in seconds) after which an unchanged reference is sent again
+#define REFERENCE_NEVER_SENT -1e9 ///< time of the last reference sent to a joint, if it should be sent at the next call
+#define DEFAULT_COMMAND_STATS_PERIOD 1.0 ///< default minimum period (in seconds) between two messages on the commandStats:o port
 
 const std::string yarpWbi::YarpWholeBodyActuatorsPropertyInteractionModeKey = "yarp.dev.interaction";
 const std::string yarpWbi::YarpWholeBodyActuatorsPropertyInteractionModeStiff = "yarp.dev.interaction.stiff";
@@ -40,6 +57,364 @@ const std::string yarpWbi::YarpWholeBodyActuatorsPropertyImpedanceStiffnessKey =
 const std::string yarpWbi::YarpWholeBodyActuatorsPropertyImpedanceDampingKey = "yarp.dev.impedance.damping";
 
 
+namespace
+{
+    const char * yarpWbiCommandInterfaceName(const yarpWBACommandInterface commandInterface)
+    {
+        switch( commandInterface )
+        {
+            case COMMAND_POSITION: return "position";
+            case COMMAND_POSITION_DIRECT: return "direct position";
+            case COMMAND_VELOCITY: return "velocity";
+            case COMMAND_TORQUE: return "torque";
+            case COMMAND_PWM: return "pwm";
+            case COMMAND_CONTROL_MODE: return "control mode";
+            case COMMAND_PID: return "pid";
+            default: return "unknown mode";
+        }
+    }
+
+    /** Name of the control board method used to send the references of an entry of the command plan */
+    const char * yarpWbiReferenceCallName(const yarpWBACommandInterface commandInterface, const bool allAxes)
+    {
+        switch( commandInterface )
+        {
+            case COMMAND_POSITION: return "positionMove";
+            case COMMAND_POSITION_DIRECT: return "setPositions";
+            case COMMAND_VELOCITY: return "velocityMove";
+#ifdef WBI_YARP_HAS_GROUP_REF_TORQUES
+            case COMMAND_TORQUE: return "setRefTorques";
+#else
+            case COMMAND_TORQUE: return allAxes ? "setRefTorques" : "setRefTorque";
+#endif
+            case COMMAND_PWM: return allAxes ? "setRefOutputs" : "setRefOutput";
+            default: return "unknown method";
+        }
+    }
+
+    yarpWBACommandInterface yarpWbiCommandInterfaceFromControlMode(const wbi::ControlMode controlMode)
+    {
+        switch( controlMode )
+        {
+            case CTRL_MODE_POS: return COMMAND_POSITION;
+            case CTRL_MODE_DIRECT_POSITION: return COMMAND_POSITION_DIRECT;
+            case CTRL_MODE_VEL: return COMMAND_VELOCITY;
+            case CTRL_MODE_TORQUE: return COMMAND_TORQUE;
+            default: return COMMAND_PWM;
+        }
+    }
+}
+
+actuatorsCommandHealth::actuatorsCommandHealth():
+commandInterface(COMMAND_POSITION)
+{
+    reset();
+}
+
+void actuatorsCommandHealth::reset()
+{
+    nrOfCommands = 0;
+    nrOfFailedCommands = 0;
+    commandLatency.reset();
+    lastSendTime = -1.0;
+    lastReturnTime = -1.0;
+}
+
+void actuatorsCommandHealth::addCommand(const bool success, const double sendTime, const double returnTime)
+{
+    nrOfCommands++;
+    if( !success )
+    {
+        nrOfFailedCommands++;
+    }
+    commandLatency.add(returnTime-sendTime);
+    lastSendTime = sendTime;
+    lastReturnTime = returnTime;
+}
+
+double actuatorsCommandHealth::getSuccessRate() const
+{
+    return nrOfCommands > 0 ? ((double)(nrOfCommands-nrOfFailedCommands))/nrOfCommands : 1.0;
+}
+
+std::string actuatorsCommandHealth::getInterfaceName() const
+{
+    return yarpWbiCommandInterfaceName(commandInterface);
+}
+
+// *********************************************************************************************************************
+// *********************************************************************************************************************
+//                                          CONTROL BOARD COMMAND WORKER
+// *********************************************************************************************************************
+// *********************************************************************************************************************
+
+namespace yarpWbi
+{
+    /**
+     * Persistent thread sending the references of a single control board,
+     * used when the parallelCommandDispatch option is enabled.
+     */
+    class controlBoardCommandWorker: public yarp::os::Thread
+    {
+    private:
+        yarpWholeBodyActuators * actuators;
+        int controlBoard;
+        const double * ref;
+        bool result;
+        bool stopRequested;
+        yarp::os::Semaphore commandAvailable;
+        yarp::os::Semaphore commandDone;
+
+    public:
+        controlBoardCommandWorker(yarpWholeBodyActuators * _actuators, const int _controlBoard):
+        actuators(_actuators), controlBoard(_controlBoard), ref(0), result(true), stopRequested(false),
+        commandAvailable(0), commandDone(0)
+        {
+        }
+
+        /** Start sending the references (the ref buffer must be valid until join returns) */
+        void dispatch(const double * _ref)
+        {
+            ref = _ref;
+            commandAvailable.post();
+        }
+
+        /** Wait for the references to be sent */
+        bool join()
+        {
+            commandDone.wait();
+            return result;
+        }
+
+        virtual void run()
+        {
+            while( true )
+            {
+                commandAvailable.wait();
+                if( stopRequested )
+                {
+                    return;
+                }
+                result = actuators->setControlReferenceForControlBoard(controlBoard,ref);
+                commandDone.post();
+            }
+        }
+
+        virtual void onStop()
+        {
+            stopRequested = true;
+            commandAvailable.post();
+        }
+    };
+
+    /**
+     * Opening of the drivers of a control board, executed by yarpWholeBodyActuators::init.
+     */
+    class controlBoardOpeningTask: public parallelTask
+    {
+    private:
+        yarpWholeBodyActuators * actuators;
+        int controlBoard;
+
+    public:
+        controlBoardOpeningTask(yarpWholeBodyActuators * _actuators, const int _controlBoard):
+        actuators(_actuators), controlBoard(_controlBoard)
+        {
+        }
+
+        virtual bool execute()
+        {
+            return actuators->openControlBoardDrivers(controlBoard);
+        }
+
+        virtual std::string getDescription() const
+        {
+            return "control board " + actuators->controlBoardNames[controlBoard];
+        }
+    };
+
+    /**
+     * Thread sending the latest references passed to setControlReference,
+     * used when the nonBlockingControlReference option is enabled.
+     *
+     * The references are copied in a single slot: if the thread is still sending
+     * the previous ones, the slot is overwritten and the older references are dropped.
+     * The references queued before a change of control mode are discarded
+     * (see discardQueuedReferences), as they refer to the previous control mode.
+     */
+    class controlReferenceSender: public yarp::os::Thread
+    {
+    private:
+        yarpWholeBodyActuators * actuators;
+        std::vector<double> slot;
+        std::vector<double> sending;
+        double slotTime;
+        bool slotFull;
+        bool busy;
+        bool lastResult;
+        bool stopRequested;
+        // incremented each time the queued references are discarded
+        int generation;
+        controlReferenceQueueStats stats;
+        mutable yarp::os::Mutex slotMutex;
+        yarp::os::Semaphore referencesAvailable;
+
+    public:
+        controlReferenceSender(yarpWholeBodyActuators * _actuators, const int nrOfJoints):
+        actuators(_actuators), slot(nrOfJoints,0.0), sending(nrOfJoints,0.0), slotTime(0.0),
+        slotFull(false), busy(false), lastResult(true), stopRequested(false), generation(0), referencesAvailable(0)
+        {
+        }
+
+        /** Copy the references in the slot, without waiting for them to be sent */
+        void push(const double * ref)
+        {
+            slotMutex.lock();
+            bool wasFull = slotFull;
+            if( wasFull )
+            {
+                stats.nrOfDroppedReferences++;
+            }
+            std::copy(ref,ref+slot.size(),slot.begin());
+            slotTime = yarp::os::Time::now();
+            slotFull = true;
+            stats.nrOfQueuedReferences++;
+            slotMutex.unlock();
+
+            if( !wasFull )
+            {
+                referencesAvailable.post();
+            }
+        }
+
+        /** If some references are waiting to be sent, replace the one of the specified joint */
+        void overrideQueuedReference(const int joint, const double reference)
+        {
+            slotMutex.lock();
+            if( slotFull )
+            {
+                slot[joint] = reference;
+            }
+            slotMutex.unlock();
+        }
+
+        /**
+         * Drop the references in the slot, and the ones the thread is about to send.
+         * Called by the control mode switches with commandMutex locked.
+         */
+        void discardQueuedReferences()
+        {
+            slotMutex.lock();
+            if( slotFull )
+            {
+                stats.nrOfDroppedReferences++;
+                slotFull = false;
+            }
+            generation++;
+            slotMutex.unlock();
+        }
+
+        bool isCurrentGeneration(const int referencesGeneration) const
+        {
+            slotMutex.lock();
+            bool current = (referencesGeneration == generation);
+            slotMutex.unlock();
+            return current;
+        }
+
+        /** Wait for the slot to be empty and the last references to be sent */
+        bool flush()
+        {
+            while( true )
+            {
+                slotMutex.lock();
+                bool idle = !slotFull && !busy;
+                bool result = lastResult;
+                slotMutex.unlock();
+                if( idle )
+                {
+                    return result;
+                }
+                yarp::os::Time::delay(WAIT_TIME);
+            }
+        }
+
+        void getStats(controlReferenceQueueStats & _stats) const
+        {
+            slotMutex.lock();
+            _stats = stats;
+            _stats.queueDepth = slotFull ? 1 : 0;
+            slotMutex.unlock();
+        }
+
+        virtual void run()
+        {
+            while( true )
+            {
+                referencesAvailable.wait();
+                if( stopRequested )
+                {
+                    return;
+                }
+
+                slotMutex.lock();
+                if( !slotFull )
+                {
+                    slotMutex.unlock();
+                    continue;
+                }
+                slot.swap(sending);
+                slotFull = false;
+                busy = true;
+                int sendingGeneration = generation;
+                stats.queueLatency.add(yarp::os::Time::now()-slotTime);
+                slotMutex.unlock();
+
+                bool discarded = false;
+                bool result = actuators->sendQueuedControlReference(&(sending[0]),sendingGeneration,discarded);
+
+                slotMutex.lock();
+                busy = false;
+                if( discarded )
+                {
+                    stats.nrOfDroppedReferences++;
+                }
+                else
+                {
+                    lastResult = result;
+                    stats.nrOfSentReferences++;
+                    if( !result )
+                    {
+                        stats.nrOfFailedReferences++;
+                    }
+                }
+                slotMutex.unlock();
+            }
+        }
+
+        virtual void onStop()
+        {
+            stopRequested = true;
+            referencesAvailable.post();
+        }
+    };
+}
+
+controlReferenceQueueStats::controlReferenceQueueStats()
+{
+    reset();
+}
+
+void controlReferenceQueueStats::reset()
+{
+    nrOfQueuedReferences = 0;
+    nrOfSentReferences = 0;
+    nrOfDroppedReferences = 0;
+    nrOfFailedReferences = 0;
+    queueDepth = 0;
+    queueLatency.reset();
+}
+
 // *********************************************************************************************************************
 // *********************************************************************************************************************
 //                                          YARP WHOLE BODY ACTUATOR
@@ -49,7 +424,11 @@ const std::string yarpWbi::YarpWholeBodyActuatorsPropertyImpedanceDampingKey = "
 
 yarpWholeBodyActuators::yarpWholeBodyActuators(const char* _name,
                                                const yarp::os::Property & yarp_wbi_properties)
-: initDone(false), name(_name), wbi_yarp_properties(yarp_wbi_properties)
+: initDone(false), name(_name), wbi_yarp_properties(yarp_wbi_properties),
+  parallelCommandDispatch(false), controlReferencePending(false),
+  referenceDeduplication(false), referenceKeepAlivePeriod(DEFAULT_REFERENCE_KEEP_ALIVE_PERIOD),
+  commandStatsPort(0), commandStatsPeriod(DEFAULT_COMMAND_STATS_PERIOD), lastCommandStatsPublishTime(0.0),
+  nonBlockingControlReference(false), referenceSender(0)
 {
 }
 
@@ -82,7 +461,7 @@ bool yarpWholeBodyActuators::openControlBoardDrivers(int bp)
         return false;
     }
     itrq[bp]=0; iimp[bp]=0; icmd[bp]=0; ivel[bp]=0; ipos[bp]=0; iopl[bp]=0;  dd[bp]=0; ipositionDirect[bp]=0; iinteraction[bp]=0;
-    if(!openPolyDriver(name, robot, dd[bp], controlBoardNames[bp].c_str()))
+    if(!openControlBoardDriver(name, robot, dd[bp], controlBoardNames[bp], wbi_yarp_properties, streamingReferencesCarrier))
     {
         std::cerr << "[ERR] yarpWholeBodyActuators::openDrivers error: unable to open controlboard " << controlBoardNames[bp]
                   << "of robot " << robot  << std::endl;
@@ -128,6 +507,13 @@ bool yarpWholeBodyActuators::init()
         return false;
     }
 
+    // the streaming options change how the drivers of the control boards are opened
+    yarp::os::Bottle & streaming_opt_bot = wbi_yarp_properties.findGroup("WBI_ACTUATORS_OPTIONS");
+    streamingReferencesCarrier = "";
+    if( streaming_opt_bot.check("streamingReferences") && streaming_opt_bot.find("streamingReferences").asBool() )
+    {
+        streamingReferencesCarrier = streaming_opt_bot.check("streamingReferencesCarrier",yarp::os::Value("udp")).asString().c_str();
+    }
 
     ok = loadJointsControlBoardFromConfig(wbi_yarp_properties,
                                           jointIdList,
@@ -157,7 +543,9 @@ bool yarpWholeBodyActuators::init()
             totalControlledAxesInControlBoard[controlBoardAxisList[wbi_jnt].first]++;
         }
 
+        commandMutex.lock();
         updateControlledJointsForEachControlBoard();
+        commandMutex.unlock();
 
         //Resize everything that depends on the number of controlboards
         itrq.resize(controlBoardNames.size());
@@ -171,24 +559,29 @@ bool yarpWholeBodyActuators::init()
         dd.resize(controlBoardNames.size());
 
         //Open necessary yarp controlboard drivers
-        //iterate all used body parts
+        //iterate all used body parts (in parallel, if the parallelStartup option is set)
+        std::vector<parallelTask*> startupTasks;
+        for (int bp = 0; bp < (int)controlBoardNames.size(); bp++)
+        {
+            startupTasks.push_back(new controlBoardOpeningTask(this,bp));
+        }
+
+        ok = runStartupTasks("yarpWholeBodyActuators",startupTasks,wbi_yarp_properties);
+
         for (int bp = 0; bp < (int)controlBoardNames.size(); bp++)
         {
-            ok = openControlBoardDrivers(bp);
-            if (!ok)
+            delete startupTasks[bp];
+        }
+
+        if (!ok)
+        {
+            //If there is an error, close all the opened driver and return
+            for (int driverToClose = 0; driverToClose < (int)controlBoardNames.size(); driverToClose++)
             {
-                //If there is an error, close all the opened driver and return
-                int lastDriverOpenedCorrectly = bp - 1;
-                for (int driverToClose = lastDriverOpenedCorrectly; driverToClose >= 0; driverToClose--)
+                if (dd[driverToClose] != 0)
                 {
-                    if (dd[driverToClose] != 0)
-                    {
-                        dd[driverToClose]->close();
-                        delete dd[driverToClose];
-                        dd[driverToClose] = 0;
-                    }
+                    closeControlBoardDriver(dd[driverToClose]);
                 }
-                break;
             }
         }
 
@@ -204,6 +597,22 @@ bool yarpWholeBodyActuators::init()
                 }
             }
         }
+
+        if (ok)
+        {
+            //The pids and the control modes of a control board are read and written in buffers sized for the largest one
+            int maxAxesInControlBoard = 0;
+            for (int ctrlBrd = 0; ctrlBrd < (int)controlBoardNames.size(); ctrlBrd++)
+            {
+                maxAxesInControlBoard = std::max(maxAxesInControlBoard,totalAxesInControlBoard[ctrlBrd]);
+            }
+            boardPidsBuffer.resize(maxAxesInControlBoard);
+            modeSwitchJoints.resize(maxAxesInControlBoard);
+            modeSwitchAxes.resize(maxAxesInControlBoard);
+            modeSwitchControlModes.resize(maxAxesInControlBoard);
+            modeSwitchInteractionModes.resize(maxAxesInControlBoard);
+            modeSwitchReferences.resize(maxAxesInControlBoard);
+        }
     }
 
     if (!ok)
@@ -223,10 +632,119 @@ bool yarpWholeBodyActuators::init()
         return false;
     }
 
+    yarp::os::Bottle & actuators_opt_bot = wbi_yarp_properties.findGroup("WBI_ACTUATORS_OPTIONS");
+    if( !loadReferenceDeduplicationOptions(actuators_opt_bot) )
+    {
+        close();
+        return false;
+    }
+
+    if( !outputStage.configure(actuators_opt_bot,jointIdList.size()) )
+    {
+        close();
+        return false;
+    }
+
+    commandHealth.resize(controlBoardNames.size(),std::vector<actuatorsCommandHealth>(NR_OF_COMMAND_INTERFACES));
+    for(int ctrlBrd = 0; ctrlBrd < (int)controlBoardNames.size(); ctrlBrd++ )
+    {
+        for(int cmdInterface = 0; cmdInterface < NR_OF_COMMAND_INTERFACES; cmdInterface++ )
+        {
+            commandHealth[ctrlBrd][cmdInterface].controlBoard = controlBoardNames[ctrlBrd];
+            commandHealth[ctrlBrd][cmdInterface].commandInterface = (yarpWBACommandInterface)cmdInterface;
+        }
+    }
+
+    if( actuators_opt_bot.check("commandStatsPort") && actuators_opt_bot.find("commandStatsPort").asBool() )
+    {
+        commandStatsPeriod = actuators_opt_bot.check("commandStatsPeriod",yarp::os::Value(DEFAULT_COMMAND_STATS_PERIOD)).asDouble();
+        commandStatsPort = new yarp::os::BufferedPort<yarp::os::Bottle>();
+        std::string commandStatsPortName = "/" + name + "/commandStats:o";
+        if( !commandStatsPort->open(commandStatsPortName) )
+        {
+            std::cerr << "[ERR] yarpWholeBodyActuators::init error: unable to open port " << commandStatsPortName << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    // the plan depends on the number of axes of the control boards
+    updateCommandPlan();
+
+    parallelCommandDispatch = actuators_opt_bot.check("parallelCommandDispatch")
+                              && actuators_opt_bot.find("parallelCommandDispatch").asBool();
+    if( parallelCommandDispatch )
+    {
+        startCommandWorkers();
+    }
+
+    nonBlockingControlReference = actuators_opt_bot.check("nonBlockingControlReference")
+                                  && actuators_opt_bot.find("nonBlockingControlReference").asBool();
+    if( nonBlockingControlReference && jointIdList.size() > 0 )
+    {
+        referenceSender = new controlReferenceSender(this,jointIdList.size());
+        referenceSender->start();
+    }
+
     initDone = true;
     return ok;
 }
 
+void yarpWholeBodyActuators::startCommandWorkers()
+{
+    commandWorkers.resize(controlBoardNames.size(),0);
+    for(int ctrlBrd=0; ctrlBrd < (int)controlBoardNames.size(); ctrlBrd++ )
+    {
+        commandWorkers[ctrlBrd] = new controlBoardCommandWorker(this,ctrlBrd);
+        commandWorkers[ctrlBrd]->start();
+    }
+}
+
+void yarpWholeBodyActuators::stopCommandWorkers()
+{
+    if( controlReferencePending )
+    {
+        joinControlReference();
+    }
+
+    for(int ctrlBrd=0; ctrlBrd < (int)commandWorkers.size(); ctrlBrd++ )
+    {
+        commandWorkers[ctrlBrd]->stop();
+        delete commandWorkers[ctrlBrd];
+    }
+    commandWorkers.resize(0);
+}
+
+void yarpWholeBodyActuators::dispatchControlReference(const double *ref)
+{
+    for(int ctrlBrd=0; ctrlBrd < (int)commandWorkers.size(); ctrlBrd++ )
+    {
+        commandWorkers[ctrlBrd]->dispatch(ref);
+    }
+    controlReferencePending = true;
+}
+
+bool yarpWholeBodyActuators::joinControlReference()
+{
+    bool ok = true;
+    for(int ctrlBrd=0; ctrlBrd < (int)commandWorkers.size(); ctrlBrd++ )
+    {
+        ok = commandWorkers[ctrlBrd]->join() && ok;
+    }
+    controlReferencePending = false;
+    return ok;
+}
+
+bool yarpWholeBodyActuators::waitDispatchedControlReference()
+{
+    yarp::os::LockGuard guard(commandMutex);
+    if( !controlReferencePending )
+    {
+        return true;
+    }
+    return joinControlReference();
+}
+
 bool yarpWholeBodyActuatorsControlledJoints::reset(const int nrOfControlBoards)
 {
     if( nrOfControlBoards < 0 )
@@ -249,6 +767,12 @@ bool yarpWholeBodyActuatorsControlledJoints::reset(const int nrOfControlBoards)
 
 bool yarpWholeBodyActuators::updateControlledJointsForEachControlBoard()
 {
+    // the workers should not read the lists while they are rebuilt
+    if( controlReferencePending )
+    {
+        joinControlReference();
+    }
+
     controlledJointsForControlBoard.reset(controlBoardNames.size());
 
     #ifndef NDEBUG
@@ -322,63 +846,302 @@ bool yarpWholeBodyActuators::updateControlledJointsForEachControlBoard()
     assert(total_controlled_joints == (int)this->getActuatorList().size());
     #endif
 
+    updateCommandPlan();
+
     return true;
 }
 
 
-bool yarpWholeBodyActuators::close()
+void yarpWholeBodyActuatorsCommandPlan::clear(const int nrOfControlBoards)
 {
-    bool ok = true;
-    for(int ctrlBrd=0; ctrlBrd < (int)controlBoardNames.size(); ctrlBrd++ )
-    {
-        if( dd[ctrlBrd]!= 0 ) {
-            ok = dd[ctrlBrd]->close();
-            delete dd[ctrlBrd];
-            dd[ctrlBrd] = 0;
-        }
-    }
-
-    return ok;
+    entries.resize(0);
+    firstEntryOfControlBoard.assign(nrOfControlBoards+1,0);
+    axes.resize(0);
+    referenceIndices.resize(0);
+    references.resize(0);
+    filteredAxes.resize(0);
+    filteredReferences.resize(0);
 }
 
-bool yarpWholeBodyActuators::removeActuator(const ID &j)
+void yarpWholeBodyActuatorsCommandPlan::addEntry(const int wbi_controlboard_id,
+                                                 const yarpWBACommandInterface commandInterface,
+                                                 const std::vector<yarpWBAControlledJoint> & joints,
+                                                 const int totalAxesInControlBoard,
+                                                 const double scale)
 {
-    if (initDone) return false;
+    if( joints.size() == 0 )
+    {
+        return;
+    }
 
-    if(!jointIdList.removeID(j))
-        return false;
-    return true;
+    yarpWBACommandPlanEntry entry;
+    entry.wbi_controlboard_id = wbi_controlboard_id;
+    entry.commandInterface = commandInterface;
+    entry.allAxes = ((int)joints.size() == totalAxesInControlBoard);
+    entry.nrOfAxes = joints.size();
+    entry.firstIndex = axes.size();
+    entry.scale = scale;
+
+    axes.resize(entry.firstIndex+entry.nrOfAxes);
+    referenceIndices.resize(entry.firstIndex+entry.nrOfAxes);
+    references.resize(entry.firstIndex+entry.nrOfAxes);
+    filteredAxes.resize(entry.firstIndex+entry.nrOfAxes);
+    filteredReferences.resize(entry.firstIndex+entry.nrOfAxes);
+    for(int jnt = 0; jnt < entry.nrOfAxes; jnt++ )
+    {
+        // if the entry controls all the axes, the references are stored in the order of the control board
+        int i = entry.allAxes ? joints[jnt].yarp_controlboard_axis : jnt;
+        axes[entry.firstIndex+i] = joints[jnt].yarp_controlboard_axis;
+        referenceIndices[entry.firstIndex+i] = joints[jnt].wbi_id;
+    }
+
+    entries.push_back(entry);
+    firstEntryOfControlBoard[wbi_controlboard_id+1] = entries.size();
 }
 
-bool yarpWholeBodyActuators::addActuator(const ID &j)
+bool yarpWholeBodyActuators::loadReferenceDeduplicationOptions(const yarp::os::Bottle & actuators_opt_bot)
 {
-    if (initDone) return false;
+    referenceDeduplication = actuators_opt_bot.check("referenceDeduplication")
+                             && actuators_opt_bot.find("referenceDeduplication").asBool();
+    referenceKeepAlivePeriod = actuators_opt_bot.check("referenceKeepAlivePeriod",yarp::os::Value(DEFAULT_REFERENCE_KEEP_ALIVE_PERIOD)).asDouble();
 
-    if(!jointIdList.addID(j))
-        return false;
+    referenceDeadband.assign(jointIdList.size(),0.0);
+    if( actuators_opt_bot.check("referenceDeadband") )
+    {
+        yarp::os::Value & deadband = actuators_opt_bot.find("referenceDeadband");
+        if( deadband.isList() )
+        {
+            yarp::os::Bottle * deadbandList = deadband.asList();
+            if( deadbandList->size() != (int)jointIdList.size() )
+            {
+                std::cerr << "[ERR] yarpWholeBodyActuators::init error: referenceDeadband has " << deadbandList->size()
+                          << " elements, while " << jointIdList.size() << " joints are controlled" << std::endl;
+                return false;
+            }
+            for(int jnt = 0; jnt < (int)jointIdList.size(); jnt++ )
+            {
+                referenceDeadband[jnt] = deadbandList->get(jnt).asDouble();
+            }
+        }
+        else
+        {
+            referenceDeadband.assign(jointIdList.size(),deadband.asDouble());
+        }
+    }
 
+    lastSentReferences.assign(jointIdList.size(),0.0);
+    lastSentReferencesTime.assign(jointIdList.size(),REFERENCE_NEVER_SENT);
     return true;
 }
 
-int yarpWholeBodyActuators::addActuators(const IDList &jList)
+void yarpWholeBodyActuators::updateCommandPlan()
 {
-    if (initDone) return false;
+    commandPlan.clear(controlBoardNames.size());
 
-    int count = jointIdList.addIDList(jList);
-    return count;
+    // after a change of control mode all the references should be sent again
+    lastSentReferencesTime.assign(lastSentReferencesTime.size(),REFERENCE_NEVER_SENT);
+    for(int ctrlBrd = 0; ctrlBrd < (int)controlBoardNames.size(); ctrlBrd++ )
+    {
+        commandPlan.firstEntryOfControlBoard[ctrlBrd+1] = commandPlan.entries.size();
+        int totalAxes = totalAxesInControlBoard[ctrlBrd];
+
+        commandPlan.addEntry(ctrlBrd,COMMAND_POSITION,controlledJointsForControlBoard.positionControlledJoints[ctrlBrd],totalAxes,yarpWbi::Rad2Deg);
+        commandPlan.addEntry(ctrlBrd,COMMAND_POSITION_DIRECT,controlledJointsForControlBoard.positionDirectedControlledJoints[ctrlBrd],totalAxes,yarpWbi::Rad2Deg);
+        commandPlan.addEntry(ctrlBrd,COMMAND_VELOCITY,controlledJointsForControlBoard.velocityControlledJoints[ctrlBrd],totalAxes,yarpWbi::Rad2Deg);
+        commandPlan.addEntry(ctrlBrd,COMMAND_TORQUE,controlledJointsForControlBoard.torqueControlledJoints[ctrlBrd],totalAxes,1.0);
+        commandPlan.addEntry(ctrlBrd,COMMAND_PWM,controlledJointsForControlBoard.pwmControlledJoints[ctrlBrd],totalAxes,1.0);
+    }
 }
 
-bool yarpWholeBodyActuators::setControlModeSingleJoint(ControlMode controlMode, double *ref, int joint)
+void yarpWholeBodyActuators::addCommand(const int wbi_controlboard_id, const yarpWBACommandInterface commandInterface,
+                                        const bool success, const double sendTime)
+{
+    commandHealth[wbi_controlboard_id][commandInterface].addCommand(success,sendTime,yarp::os::Time::now());
+}
+
+std::vector<actuatorsCommandHealth> yarpWholeBodyActuators::getCommandHealth()
+{
+    yarp::os::LockGuard guard(commandMutex);
+    return collectCommandHealth();
+}
+
+std::vector<actuatorsCommandHealth> yarpWholeBodyActuators::collectCommandHealth()
+{
+    // the statistics should not be read while the workers are updating them
+    if( controlReferencePending )
+    {
+        joinControlReference();
+    }
+
+    std::vector<actuatorsCommandHealth> health;
+    for(int ctrlBrd = 0; ctrlBrd < (int)commandHealth.size(); ctrlBrd++ )
+    {
+        for(int cmdInterface = 0; cmdInterface < (int)commandHealth[ctrlBrd].size(); cmdInterface++ )
+        {
+            if( commandHealth[ctrlBrd][cmdInterface].nrOfCommands > 0 )
+            {
+                health.push_back(commandHealth[ctrlBrd][cmdInterface]);
+            }
+        }
+    }
+    return health;
+}
+
+bool yarpWholeBodyActuators::getCommandHealth(const std::string & controlBoard, const yarpWBACommandInterface commandInterface,
+                                              actuatorsCommandHealth & health)
+{
+    if( commandInterface < 0 || commandInterface >= NR_OF_COMMAND_INTERFACES )
+    {
+        return false;
+    }
+    yarp::os::LockGuard guard(commandMutex);
+    if( controlReferencePending )
+    {
+        joinControlReference();
+    }
+    for(int ctrlBrd = 0; ctrlBrd < (int)commandHealth.size(); ctrlBrd++ )
+    {
+        if( controlBoardNames[ctrlBrd] == controlBoard )
+        {
+            // an interface never used has no meaningful statistics
+            if( commandHealth[ctrlBrd][commandInterface].nrOfCommands == 0 )
+            {
+                return false;
+            }
+            health = commandHealth[ctrlBrd][commandInterface];
+            return true;
+        }
+    }
+    return false;
+}
+
+void yarpWholeBodyActuators::resetCommandHealth()
+{
+    yarp::os::LockGuard guard(commandMutex);
+    if( controlReferencePending )
+    {
+        joinControlReference();
+    }
+    for(int ctrlBrd = 0; ctrlBrd < (int)commandHealth.size(); ctrlBrd++ )
+    {
+        for(int cmdInterface = 0; cmdInterface < (int)commandHealth[ctrlBrd].size(); cmdInterface++ )
+        {
+            commandHealth[ctrlBrd][cmdInterface].reset();
+        }
+    }
+}
+
+bool yarpWholeBodyActuators::publishCommandHealth()
+{
+    if( commandStatsPort == 0 ) return false;
+
+    yarp::os::LockGuard guard(commandMutex);
+    writeCommandHealth();
+    return true;
+}
+
+void yarpWholeBodyActuators::writeCommandHealth()
+{
+    yarp::os::Bottle & stats = commandStatsPort->prepare();
+    stats.clear();
+    std::vector<actuatorsCommandHealth> health = collectCommandHealth();
+    for(int i = 0; i < (int)health.size(); i++ )
+    {
+        yarp::os::Bottle & interfaceStats = stats.addList();
+        interfaceStats.addString(health[i].controlBoard.c_str());
+        interfaceStats.addString(health[i].getInterfaceName().c_str());
+        interfaceStats.addInt((int)health[i].nrOfCommands);
+        interfaceStats.addInt((int)health[i].nrOfFailedCommands);
+        interfaceStats.addDouble(health[i].commandLatency.getMean());
+        interfaceStats.addDouble(health[i].commandLatency.getPercentile(0.5));
+        interfaceStats.addDouble(health[i].commandLatency.getPercentile(0.99));
+        interfaceStats.addDouble(health[i].commandLatency.max);
+    }
+    commandStatsPort->write();
+    lastCommandStatsPublishTime = yarp::os::Time::now();
+}
+
+bool yarpWholeBodyActuators::close()
+{
+    bool ok = true;
+    if( referenceSender != 0 )
+    {
+        referenceSender->stop();
+        delete referenceSender;
+        referenceSender = 0;
+    }
+    stopCommandWorkers();
+
+    if( commandStatsPort != 0 )
+    {
+        commandStatsPort->close();
+        delete commandStatsPort;
+        commandStatsPort = 0;
+    }
+
+    for(int ctrlBrd=0; ctrlBrd < (int)controlBoardNames.size(); ctrlBrd++ )
+    {
+        if( dd[ctrlBrd]!= 0 ) {
+            ok = closeControlBoardDriver(dd[ctrlBrd]);
+        }
+    }
+
+    return ok;
+}
+
+bool yarpWholeBodyActuators::removeActuator(const ID &j)
+{
+    if (initDone) return false;
+
+    if(!jointIdList.removeID(j))
+        return false;
+    return true;
+}
+
+bool yarpWholeBodyActuators::addActuator(const ID &j)
+{
+    if (initDone) return false;
+
+    if(!jointIdList.addID(j))
+        return false;
+
+    return true;
+}
+
+int yarpWholeBodyActuators::addActuators(const IDList &jList)
+{
+    if (initDone) return false;
+
+    int count = jointIdList.addIDList(jList);
+    return count;
+}
+
+bool yarpWholeBodyActuators::setControlModeSingleJoint(ControlMode controlMode, double *ref, int joint)
 {
     if (!initDone) return false;
 
+    // the references should not be sent while the control mode changes
+    yarp::os::LockGuard guard(commandMutex);
+
     bool ok = false;
     ///< check that joint is not already in the specified control mode
     // commented out for now
     if(currentCtrlModes[joint]!=controlMode)
     {
+        // the references dispatched by setControlReferenceAsync are sent in the previous control mode
+        if( controlReferencePending )
+        {
+            joinControlReference();
+        }
+        // while the ones queued for the sender thread are dropped
+        if( referenceSender != 0 )
+        {
+            referenceSender->discardQueuedReferences();
+        }
+
         int bodyPart = controlBoardAxisList[joint].first;
         int controlBoardJointAxis = controlBoardAxisList[joint].second;
+        double send_start = yarp::os::Time::now();
         switch(controlMode)
         {
             case CTRL_MODE_POS:
@@ -406,15 +1169,17 @@ bool yarpWholeBodyActuators::setControlModeSingleJoint(ControlMode controlMode,
             default:
                 break;
         }
+        addCommand(bodyPart,COMMAND_CONTROL_MODE,ok,send_start);
 
         if(ok)
         {
             currentCtrlModes[joint] = controlMode;
+            outputStage.resetJoint(joint);
             this->updateControlledJointsForEachControlBoard();
 
             if(ref != 0)
             {
-                setControlReference(ref,joint);
+                setControlReferenceSingleJoint(ref,joint);
             }
         } else {
             fprintf(stderr, "yarpWholeBodyActuators: Cannot set control mode %d on joint %d \n", controlMode, joint);
@@ -437,22 +1202,155 @@ bool yarpWholeBodyActuators::setControlMode(ControlMode controlMode, double *ref
     ///< set all joints to the specified control mode
     if(joint<0)
     {
+        ok = setControlModeAllJoints(controlMode,ref);
+    }
+    else //set a single joint
+    {
+        assert(joint >=0 && joint < (int)jointIdList.size());
+        setControlModeSingleJoint(controlMode,ref,joint);
+    }
+
+    return ok;
+}
+
+bool yarpWholeBodyActuators::setControlModeAllJoints(ControlMode controlMode, double *ref)
+{
+    int yarpCtrlMode;
+    bool setStiffInteraction = false;
+    switch(controlMode)
+    {
+        case CTRL_MODE_POS:             yarpCtrlMode = VOCAB_CM_POSITION;        setStiffInteraction = true; break;
+        case CTRL_MODE_DIRECT_POSITION: yarpCtrlMode = VOCAB_CM_POSITION_DIRECT; setStiffInteraction = true; break;
+        case CTRL_MODE_VEL:             yarpCtrlMode = VOCAB_CM_VELOCITY;        setStiffInteraction = true; break;
+        case CTRL_MODE_TORQUE:          yarpCtrlMode = VOCAB_CM_TORQUE;          break;
+        case CTRL_MODE_MOTOR_PWM:       yarpCtrlMode = VOCAB_CM_OPENLOOP;        break;
+        default:
+            fprintf(stderr, "yarpWholeBodyActuators: Cannot set control mode %d \n", controlMode);
+            return false;
+    }
+
+    // the references should not be sent while the control modes change
+    yarp::os::LockGuard guard(commandMutex);
+
+    bool modeChanges = false;
+    for(int j=0; j < (int)jointIdList.size() && !modeChanges; j++ )
+    {
+        modeChanges = (currentCtrlModes[j] != controlMode);
+    }
+    if( !modeChanges )
+    {
+        return true;
+    }
+
+    // the references dispatched by setControlReferenceAsync are sent in the previous control mode
+    if( controlReferencePending )
+    {
+        joinControlReference();
+    }
+    // while the ones queued for the sender thread are dropped
+    if( referenceSender != 0 )
+    {
+        referenceSender->discardQueuedReferences();
+    }
+
+    int nrOfSwitchedJoints = 0;
+
+    yarpWBACommandInterface commandInterface = yarpWbiCommandInterfaceFromControlMode(controlMode);
+    double referenceScale = (controlMode == CTRL_MODE_TORQUE || controlMode == CTRL_MODE_MOTOR_PWM) ? 1.0 : yarpWbi::Rad2Deg;
+
+    bool ok = true;
+    for(int wbi_controlboard_id=0; wbi_controlboard_id < (int)controlBoardNames.size(); wbi_controlboard_id++ )
+    {
+        ///< only the joints that are not already in the specified control mode are switched
+        int nrOfJointsToSwitch = 0;
         for(int j=0; j < (int)jointIdList.size(); j++ )
         {
-            if(ref != 0)
+            if( controlBoardAxisList[j].first == wbi_controlboard_id && currentCtrlModes[j] != controlMode )
             {
-                setControlModeSingleJoint(controlMode,ref+j,j);
+                if( nrOfJointsToSwitch >= (int)modeSwitchJoints.size() )
+                {
+                    fprintf(stderr, "yarpWholeBodyActuators: more joints than axes in controlboard %s \n",
+                            controlBoardNames[wbi_controlboard_id].c_str());
+                    ok = false;
+                    nrOfJointsToSwitch = 0;
+                    break;
+                }
+                modeSwitchJoints[nrOfJointsToSwitch] = j;
+                modeSwitchAxes[nrOfJointsToSwitch] = controlBoardAxisList[j].second;
+                modeSwitchControlModes[nrOfJointsToSwitch] = yarpCtrlMode;
+                modeSwitchInteractionModes[nrOfJointsToSwitch] = VOCAB_IM_STIFF;
+                nrOfJointsToSwitch++;
             }
-            else
+        }
+
+        if( nrOfJointsToSwitch == 0 )
+        {
+            continue;
+        }
+
+        int * buf_switchedJoints = &(modeSwitchJoints[0]);
+        int * buf_controlledJoints = &(modeSwitchAxes[0]);
+        int * buf_controlModes = &(modeSwitchControlModes[0]);
+        yarp::dev::InteractionModeEnum * buf_interactionModes = &(modeSwitchInteractionModes[0]);
+        double * buf_references = &(modeSwitchReferences[0]);
+
+        double send_start = yarp::os::Time::now();
+        bool boardOk = icmd[wbi_controlboard_id]->setControlModes(nrOfJointsToSwitch,buf_controlledJoints,buf_controlModes);
+        if( boardOk && setStiffInteraction )
+        {
+            boardOk = iinteraction[wbi_controlboard_id]->setInteractionModes(nrOfJointsToSwitch,buf_controlledJoints,buf_interactionModes);
+        }
+        addCommand(wbi_controlboard_id,COMMAND_CONTROL_MODE,boardOk,send_start);
+
+        if( !boardOk )
+        {
+            fprintf(stderr, "yarpWholeBodyActuators: Cannot set control mode %d on controlboard %s \n",
+                    controlMode, controlBoardNames[wbi_controlboard_id].c_str());
+            ok = false;
+            continue;
+        }
+
+        for(int i=0; i < nrOfJointsToSwitch; i++ )
+        {
+            currentCtrlModes[buf_switchedJoints[i]] = controlMode;
+            outputStage.resetJoint(buf_switchedJoints[i]);
+        }
+        nrOfSwitchedJoints += nrOfJointsToSwitch;
+
+        if( ref == 0 )
+        {
+            continue;
+        }
+
+        ///< the initial references are sent only to the switched joints, with one call in the new control mode
+        for(int i=0; i < nrOfJointsToSwitch; i++ )
+        {
+            buf_references[i] = referenceScale*ref[buf_switchedJoints[i]];
+        }
+        if( !sendReferencesToControlBoard(wbi_controlboard_id,commandInterface,false,nrOfJointsToSwitch,buf_controlledJoints,buf_references) )
+        {
+            fprintf(stderr, "yarpWholeBodyActuators: Cannot send the references in control mode %d to controlboard %s \n",
+                    controlMode, controlBoardNames[wbi_controlboard_id].c_str());
+            ok = false;
+            continue;
+        }
+
+        double now = yarp::os::Time::now();
+        for(int i=0; i < nrOfJointsToSwitch; i++ )
+        {
+            int j = buf_switchedJoints[i];
+            outputStage.setJoint(j,ref[j]);
+            if( referenceDeduplication )
             {
-                setControlModeSingleJoint(controlMode,0,j);
+                lastSentReferences[j] = ref[j];
+                lastSentReferencesTime[j] = now;
             }
         }
     }
-    else //set a single joint
+
+    if( nrOfSwitchedJoints > 0 )
     {
-        assert(joint >=0 && joint < (int)jointIdList.size());
-        setControlModeSingleJoint(controlMode,ref,joint);
+        this->updateControlledJointsForEachControlBoard();
     }
 
     return ok;
@@ -466,234 +1364,328 @@ bool yarpWholeBodyActuators::setControlReference(double *ref, int joint)
     if(joint> (int)jointIdList.size())
         return false;
 
+    if(joint<0)
+    {
+        if( referenceSender != 0 )
+        {
+            referenceSender->push(ref);
+            return true;
+        }
+        yarp::os::LockGuard guard(commandMutex);
+        return sendControlReference(ref);
+    }
+    else    // set control reference for the specified joint
+    {
+        // older references still to be sent by the sender thread should not overwrite this one
+        if( referenceSender != 0 )
+        {
+            referenceSender->overrideQueuedReference(joint,*ref);
+        }
+
+        yarp::os::LockGuard guard(commandMutex);
+        return setControlReferenceSingleJoint(ref,joint);
+    }
+}
+
+bool yarpWholeBodyActuators::setControlReferenceSingleJoint(const double *ref, int joint)
+{
+    // references sent by setControlReferenceAsync should not be overtaken
+    if( controlReferencePending )
+    {
+        joinControlReference();
+    }
+
+    int bodyPart = controlBoardAxisList[joint].first;
+    int controlBoardAxis = controlBoardAxisList[joint].second;
+
+    bool ret_value = false;
+    double send_start = yarp::os::Time::now();
+    switch(currentCtrlModes[joint])
+    {
+        case CTRL_MODE_POS:
+            ret_value = ipos[bodyPart]->positionMove(controlBoardAxis, yarpWbi::Rad2Deg * (*ref));
+            break;
+        case CTRL_MODE_DIRECT_POSITION:
+            ret_value = ipositionDirect[bodyPart]->setPosition(controlBoardAxis, yarpWbi::Rad2Deg * (*ref));
+            break;
+        case CTRL_MODE_VEL:
+            ret_value = ivel[bodyPart]->velocityMove(controlBoardAxis, yarpWbi::Rad2Deg * (*ref));
+            break;
+        case CTRL_MODE_TORQUE:
+        {
+            ret_value = itrq[bodyPart]->setRefTorque(controlBoardAxis, *ref);
+        }
+            break;
+        case CTRL_MODE_MOTOR_PWM:
+            ret_value = iopl[bodyPart]->setRefOutput(controlBoardAxis, *ref);
+            break;
+        default:
+            ret_value = false;
+    }
+    addCommand(bodyPart,yarpWbiCommandInterfaceFromControlMode(currentCtrlModes[joint]),ret_value,send_start);
+    if( ret_value )
+    {
+        outputStage.setJoint(joint,*ref);
+    }
+    if( ret_value && referenceDeduplication )
+    {
+        lastSentReferences[joint] = *ref;
+        lastSentReferencesTime[joint] = yarp::os::Time::now();
+    }
+    return ret_value;
+}
+
+bool yarpWholeBodyActuators::sendQueuedControlReference(const double *ref, const int generation, bool & discarded)
+{
+    yarp::os::LockGuard guard(commandMutex);
+
+    // the references queued before a change of control mode refer to the previous one
+    discarded = !referenceSender->isCurrentGeneration(generation);
+    if( discarded )
+    {
+        return true;
+    }
+    return sendControlReference(ref);
+}
+
+bool yarpWholeBodyActuators::sendControlReference(const double *ref)
+{
+    // references sent by setControlReferenceAsync should not be overtaken
+    if( controlReferencePending )
+    {
+        joinControlReference();
+    }
+
     bool ok = true;
-    if(joint>=0)    // set control reference for the specified joint
+    if( commandStatsPort != 0 && yarp::os::Time::now()-lastCommandStatsPublishTime >= commandStatsPeriod )
     {
-        int bodyPart = controlBoardAxisList[joint].first;
-        int controlBoardAxis = controlBoardAxisList[joint].second;
+        writeCommandHealth();
+    }
 
-        bool ret_value = false;
-        switch(currentCtrlModes[joint])
+    const double * references = ref;
+    if( outputStage.isEnabled() )
+    {
+        references = outputStage.process(ref,yarp::os::Time::now());
+        if( !outputStage.decimationTick() )
         {
-            case CTRL_MODE_POS:
-                ret_value = ipos[bodyPart]->positionMove(controlBoardAxis, yarpWbi::Rad2Deg * (*ref));
-                break;
-            case CTRL_MODE_DIRECT_POSITION:
-                ret_value = ipositionDirect[bodyPart]->setPosition(controlBoardAxis, yarpWbi::Rad2Deg * (*ref));
-                break;
-            case CTRL_MODE_VEL:
-                ret_value = ivel[bodyPart]->velocityMove(controlBoardAxis, yarpWbi::Rad2Deg * (*ref));
-                break;
-            case CTRL_MODE_TORQUE:
-            {
-                ret_value = itrq[bodyPart]->setRefTorque(controlBoardAxis, *ref);
-            }
-                break;
-            case CTRL_MODE_MOTOR_PWM:
-                ret_value = iopl[bodyPart]->setRefOutput(controlBoardAxis, *ref);
-                break;
-            default:
-                ret_value = false;
+            return true;
         }
-        return ret_value;
     }
 
-    //Buffer variables
-    double buf_references[MAX_NJ];
-    int buf_controlledJoints[MAX_NJ];
+    if( parallelCommandDispatch )
+    {
+        dispatchControlReference(references);
+        return joinControlReference();
+    }
 
     // set control references for all joints
     for(int wbi_controlboard_id=0; wbi_controlboard_id < (int)controlBoardNames.size(); wbi_controlboard_id++ )
     {
-        ///////////////////////////////////////////////////
-        //Sending references for position controlled joints
-        ///////////////////////////////////////////////////
-        int nrOfPosControlledJointsInControlBoard = controlledJointsForControlBoard.positionControlledJoints[wbi_controlboard_id].size();
-        if( nrOfPosControlledJointsInControlBoard > 0 )
+        ok = setControlReferenceForControlBoard(wbi_controlboard_id,references);
+        if( !ok )
         {
-             if( nrOfPosControlledJointsInControlBoard == totalAxesInControlBoard[wbi_controlboard_id] )
-             {
-                //If the wbi controls all the joint in the control board, use the usual interface setPositions
-                for( int controlBoard_jnt = 0; controlBoard_jnt < nrOfPosControlledJointsInControlBoard; controlBoard_jnt++ )
-                {
-                     int wbi_id = controlledJointsForControlBoard.positionControlledJoints[wbi_controlboard_id][controlBoard_jnt].wbi_id;
-                     int yarp_controlboard_axis =  controlledJointsForControlBoard.positionControlledJoints[wbi_controlboard_id][controlBoard_jnt].yarp_controlboard_axis;
-                     buf_references[yarp_controlboard_axis] = yarpWbi::Rad2Deg * ref[wbi_id];
-                }
-                ok = ipos[wbi_controlboard_id]->positionMove(buf_references);
-                if(!ok)
+            return false;
+        }
+    }
+
+    return ok;
+}
+
+bool yarpWholeBodyActuators::setControlReferenceAsync(double *ref)
+{
+    if (!initDone || !parallelCommandDispatch || nonBlockingControlReference) return false;
+    if (jointIdList.size() == 0) return true;
+
+    yarp::os::LockGuard guard(commandMutex);
+
+    if( controlReferencePending )
+    {
+        joinControlReference();
+    }
+
+    const double * references = ref;
+    if( outputStage.isEnabled() )
+    {
+        references = outputStage.process(ref,yarp::os::Time::now());
+        if( !outputStage.decimationTick() )
+        {
+            return true;
+        }
+    }
+
+    asyncReferences.assign(references,references+jointIdList.size());
+    dispatchControlReference(&(asyncReferences[0]));
+    return true;
+}
+
+bool yarpWholeBodyActuators::waitControlReference()
+{
+    if( referenceSender != 0 )
+    {
+        return referenceSender->flush();
+    }
+
+    return waitDispatchedControlReference();
+}
+
+bool yarpWholeBodyActuators::getControlReferenceQueueStats(controlReferenceQueueStats & stats) const
+{
+    if( referenceSender == 0 )
+    {
+        return false;
+    }
+    referenceSender->getStats(stats);
+    return true;
+}
+
+bool yarpWholeBodyActuators::setControlReferenceForControlBoard(const int wbi_controlboard_id, const double *ref)
+{
+    bool ok = true;
+
+    //////////////////////////////////////////////////////////
+    //Sending references following the command plan of the control board
+    //////////////////////////////////////////////////////////
+    double now = referenceDeduplication ? yarp::os::Time::now() : 0.0;
+    for( int e = commandPlan.firstEntryOfControlBoard[wbi_controlboard_id]; e < commandPlan.firstEntryOfControlBoard[wbi_controlboard_id+1]; e++ )
+    {
+        const yarpWBACommandPlanEntry & entry = commandPlan.entries[e];
+        const int * axes = &(commandPlan.axes[entry.firstIndex]);
+        const int * referenceIndices = &(commandPlan.referenceIndices[entry.firstIndex]);
+        double * references = &(commandPlan.references[entry.firstIndex]);
+        int nrOfAxes = entry.nrOfAxes;
+
+        for( int i = 0; i < entry.nrOfAxes; i++ )
+        {
+            references[i] = entry.scale*ref[referenceIndices[i]];
+        }
+
+        if( referenceDeduplication )
+        {
+            // keep only the references out of the deadband of the last one sent, or not sent for a keep alive period
+            int * filteredAxes = &(commandPlan.filteredAxes[entry.firstIndex]);
+            double * filteredReferences = &(commandPlan.filteredReferences[entry.firstIndex]);
+            int nrOfFilteredAxes = 0;
+            for( int i = 0; i < entry.nrOfAxes; i++ )
+            {
+                int wbi_id = referenceIndices[i];
+                if( fabs(ref[wbi_id]-lastSentReferences[wbi_id]) > referenceDeadband[wbi_id]
+                    || now-lastSentReferencesTime[wbi_id] >= referenceKeepAlivePeriod )
                 {
-                    std::cerr << "[ERR] yarpWholeBodyActuators::setControlReference error:"
-                              << "[ERR]  unable to setPositions for controlboard " << controlBoardNames[wbi_controlboard_id] << std::endl;
-                    return false;
+                    filteredAxes[nrOfFilteredAxes] = axes[i];
+                    filteredReferences[nrOfFilteredAxes] = references[i];
+                    nrOfFilteredAxes++;
+                    lastSentReferences[wbi_id] = ref[wbi_id];
+                    lastSentReferencesTime[wbi_id] = now;
                 }
             }
-            else
+
+            if( nrOfFilteredAxes == 0 )
             {
-                //Otherwise send all the commands individually
-                for( int controlBoard_jnt = 0; controlBoard_jnt < nrOfPosControlledJointsInControlBoard; controlBoard_jnt++ )
-                {
-                    int wbi_id = controlledJointsForControlBoard.positionControlledJoints[wbi_controlboard_id][controlBoard_jnt].wbi_id;
-                    int yarp_controlboard_axis =  controlledJointsForControlBoard.positionControlledJoints[wbi_controlboard_id][controlBoard_jnt].yarp_controlboard_axis;
-                    ok = ipos[wbi_controlboard_id]->positionMove(yarp_controlboard_axis,yarpWbi::Rad2Deg*ref[wbi_id]);
-                }
+                continue;
             }
-        }
 
-        //////////////////////////////////////////////////////////
-        //Sending references for direct position controlled joints
-        //////////////////////////////////////////////////////////
-        int nrOfPosDirectControlledJointsInControlBoard = controlledJointsForControlBoard.positionDirectedControlledJoints[wbi_controlboard_id].size();
-        if( nrOfPosDirectControlledJointsInControlBoard > 0 )
-        {
-            if( nrOfPosDirectControlledJointsInControlBoard == totalAxesInControlBoard[wbi_controlboard_id] )
+            if( entry.allAxes )
             {
-                //If the wbi controls all the joint in the control board, use the usual interface setPositions
-                for( int controlBoard_jnt = 0; controlBoard_jnt < nrOfPosDirectControlledJointsInControlBoard; controlBoard_jnt++ )
-                {
-                    int wbi_id = controlledJointsForControlBoard.positionDirectedControlledJoints[wbi_controlboard_id][controlBoard_jnt].wbi_id;
-                    int yarp_controlboard_axis =  controlledJointsForControlBoard.positionDirectedControlledJoints[wbi_controlboard_id][controlBoard_jnt].yarp_controlboard_axis;
-                    buf_references[yarp_controlboard_axis] = yarpWbi::Rad2Deg*ref[wbi_id];
-                }
-                ok = ipositionDirect[wbi_controlboard_id]->setPositions(buf_references);
-                if(!ok)
+                // the full control board call sends all the references anyway
+                for( int i = 0; i < entry.nrOfAxes; i++ )
                 {
-                    std::cerr << "yarpWholeBodyActuators::setControlReference error:"
-                              << " unable to command position for controlboard " << controlBoardNames[wbi_controlboard_id] << std::endl;
-                    return false;
+                    lastSentReferences[referenceIndices[i]] = ref[referenceIndices[i]];
+                    lastSentReferencesTime[referenceIndices[i]] = now;
                 }
             }
-            else
+            else if( nrOfFilteredAxes < entry.nrOfAxes )
             {
-                //Otherwise send all the commands individually
-                for( int controlBoard_jnt = 0; controlBoard_jnt < nrOfPosDirectControlledJointsInControlBoard; controlBoard_jnt++ )
-                {
-                    int wbi_id = controlledJointsForControlBoard.positionDirectedControlledJoints[wbi_controlboard_id][controlBoard_jnt].wbi_id;
-                    int yarp_controlboard_axis =  controlledJointsForControlBoard.positionDirectedControlledJoints[wbi_controlboard_id][controlBoard_jnt].yarp_controlboard_axis;
-                    ok = ipositionDirect[wbi_controlboard_id]->setPosition(yarp_controlboard_axis,yarpWbi::Rad2Deg*ref[wbi_id]);
-                }
+                axes = filteredAxes;
+                references = filteredReferences;
+                nrOfAxes = nrOfFilteredAxes;
             }
         }
 
-        //////////////////////////////////////////////////////////
-        //Sending references for velocity controlled joints
-        //////////////////////////////////////////////////////////
-        int nrOfVelocityControlledJointsInControlBoard = controlledJointsForControlBoard.velocityControlledJoints[wbi_controlboard_id].size();
-        if( nrOfVelocityControlledJointsInControlBoard > 0 )
+        ok = sendReferencesToControlBoard(wbi_controlboard_id,entry.commandInterface,entry.allAxes,nrOfAxes,axes,references);
+
+        if(!ok)
         {
-            if( nrOfVelocityControlledJointsInControlBoard == totalAxesInControlBoard[wbi_controlboard_id] )
-            {
-                //If the wbi controls all the joint in the control board, use the usual interface setPositions
-                for( int controlBoard_jnt = 0; controlBoard_jnt < nrOfVelocityControlledJointsInControlBoard; controlBoard_jnt++ )
-                {
-                    int wbi_id = controlledJointsForControlBoard.velocityControlledJoints[wbi_controlboard_id][controlBoard_jnt].wbi_id;
-                    int yarp_controlboard_axis =  controlledJointsForControlBoard.velocityControlledJoints[wbi_controlboard_id][controlBoard_jnt].yarp_controlboard_axis;
-                    buf_references[yarp_controlboard_axis] = yarpWbi::Rad2Deg*ref[wbi_id];
-                }
-                ok = ivel[wbi_controlboard_id]->velocityMove(buf_references);
-                if(!ok)
-                {
-                    std::cerr << "yarpWholeBodyActuators::setControlReference error:"
-                              << " unable to command velocities for controlboard " << controlBoardNames[wbi_controlboard_id] << std::endl;
-                    return false;
-                }
-            }
-            else
+            if( referenceDeduplication )
             {
+                // the references of the entry should be sent again at the next call
+                for( int i = 0; i < entry.nrOfAxes; i++ )
                 {
-                    //Otherwise send all the commands together, but packing them for iVelocityControl interface
-                    for( int controlBoard_jnt = 0; controlBoard_jnt < nrOfVelocityControlledJointsInControlBoard; controlBoard_jnt++ )
-                    {
-                        int wbi_id = controlledJointsForControlBoard.velocityControlledJoints[wbi_controlboard_id][controlBoard_jnt].wbi_id;
-                        int yarp_controlboard_axis =  controlledJointsForControlBoard.velocityControlledJoints[wbi_controlboard_id][controlBoard_jnt].yarp_controlboard_axis;
-                        buf_references[controlBoard_jnt] = yarpWbi::Rad2Deg*ref[wbi_id];
-                        buf_controlledJoints[controlBoard_jnt] = yarp_controlboard_axis;
-                    }
-                    ok = ivel[wbi_controlboard_id]->velocityMove(nrOfVelocityControlledJointsInControlBoard, buf_controlledJoints, buf_references);
-                    if(!ok)
-                    {
-                        std::cerr << "yarpWholeBodyActuators::setControlReference error:"
-                              << " unable to command velocities for controlboard " << controlBoardNames[wbi_controlboard_id] << std::endl;
-                        return false;
-                    }
+                    lastSentReferencesTime[referenceIndices[i]] = REFERENCE_NEVER_SENT;
                 }
-
             }
+            std::cerr << "[ERR] yarpWholeBodyActuators::setControlReference error:"
+                      << " " << yarpWbiReferenceCallName(entry.commandInterface,entry.allAxes)
+                      << " failed for " << nrOfAxes << " axes in "
+                      << yarpWbiCommandInterfaceName(entry.commandInterface)
+                      << " mode of controlboard " << controlBoardNames[wbi_controlboard_id] << std::endl;
+            return false;
         }
+    }
 
-        //////////////////////////////////////////////////////////
-        //Sending references for torque controlled joints
-        //////////////////////////////////////////////////////////
-        int nrOfTorqueControlledJointsInControlBoard = controlledJointsForControlBoard.torqueControlledJoints[wbi_controlboard_id].size();
-        if( nrOfTorqueControlledJointsInControlBoard > 0 )
-        {
+    return ok;
+}
 
-            if( nrOfTorqueControlledJointsInControlBoard == totalAxesInControlBoard[wbi_controlboard_id] )
+bool yarpWholeBodyActuators::sendReferencesToControlBoard(const int wbi_controlboard_id, const yarpWBACommandInterface commandInterface,
+                                                          const bool allAxes, const int nrOfAxes, const int *axes, const double *references)
+{
+    yarp::dev::IPositionDirect * positionDirect = ipositionDirect[wbi_controlboard_id];
+    yarp::dev::IVelocityControl2 * velocity = ivel[wbi_controlboard_id];
+    yarp::dev::ITorqueControl * torque = itrq[wbi_controlboard_id];
+
+    bool ok = false;
+    double send_start = yarp::os::Time::now();
+    switch( commandInterface )
+    {
+        case COMMAND_POSITION:
+            ok = allAxes ? ipos[wbi_controlboard_id]->positionMove(references)
+                         : ipos[wbi_controlboard_id]->positionMove(nrOfAxes,axes,references);
+            break;
+        case COMMAND_POSITION_DIRECT:
+            ok = allAxes ? positionDirect->setPositions(references)
+                         : positionDirect->setPositions(nrOfAxes,axes,references);
+            break;
+        case COMMAND_VELOCITY:
+            ok = allAxes ? velocity->velocityMove(references)
+                         : velocity->velocityMove(nrOfAxes,axes,references);
+            break;
+        case COMMAND_TORQUE:
+            if( allAxes )
             {
-                //If the wbi controls all the joint in the control board, use the usual interface setPositions
-                for( int controlBoard_jnt = 0; controlBoard_jnt < nrOfTorqueControlledJointsInControlBoard; controlBoard_jnt++ )
-                {
-                    int wbi_id = controlledJointsForControlBoard.torqueControlledJoints[wbi_controlboard_id][controlBoard_jnt].wbi_id;
-                    int yarp_controlboard_axis =  controlledJointsForControlBoard.torqueControlledJoints[wbi_controlboard_id][controlBoard_jnt].yarp_controlboard_axis;
-                    buf_references[yarp_controlboard_axis] = ref[wbi_id];
-                }
-                    ok = itrq[wbi_controlboard_id]->setRefTorques(buf_references);
-                if(!ok)
-                {
-                    std::cerr << "yarpWholeBodyActuators::setControlReference error:"
-                              << " unable to command position for controlboard " << controlBoardNames[wbi_controlboard_id] << std::endl;
-                    return false;
-                }
+                ok = torque->setRefTorques(references);
             }
             else
             {
-                //Otherwise send all the commands individually
-                for( int controlBoard_jnt = 0; controlBoard_jnt < nrOfTorqueControlledJointsInControlBoard; controlBoard_jnt++ )
+#ifdef WBI_YARP_HAS_GROUP_REF_TORQUES
+                ok = torque->setRefTorques(nrOfAxes,axes,references);
+#else
+                //Send all the commands individually
+                ok = true;
+                for( int i = 0; i < nrOfAxes; i++ )
                 {
-                    int wbi_id = controlledJointsForControlBoard.torqueControlledJoints[wbi_controlboard_id][controlBoard_jnt].wbi_id;
-                    int yarp_controlboard_axis =  controlledJointsForControlBoard.torqueControlledJoints[wbi_controlboard_id][controlBoard_jnt].yarp_controlboard_axis;
-                    ok = itrq[wbi_controlboard_id]->setRefTorque(yarp_controlboard_axis, ref[wbi_id]);
+                    ok = torque->setRefTorque(axes[i],references[i]) && ok;
                 }
+#endif
             }
-        }
-
-        //////////////////////////////////////////////////////////
-        //Sending references for pwm controlled joints
-        //////////////////////////////////////////////////////////
-        int nrOfPWMControlledJointsInControlBoard = controlledJointsForControlBoard.pwmControlledJoints[wbi_controlboard_id].size();
-        if( nrOfPWMControlledJointsInControlBoard > 0 )
-        {
-            if( nrOfPWMControlledJointsInControlBoard == totalAxesInControlBoard[wbi_controlboard_id] )
+            break;
+        case COMMAND_PWM:
+            if( allAxes )
             {
-                //If the wbi controls all the joint in the control board, use the usual interface setPositions
-                for( int controlBoard_jnt = 0; controlBoard_jnt < nrOfPWMControlledJointsInControlBoard; controlBoard_jnt++ )
-                {
-                    int wbi_id = controlledJointsForControlBoard.pwmControlledJoints[wbi_controlboard_id][controlBoard_jnt].wbi_id;
-                    int yarp_controlboard_axis =  controlledJointsForControlBoard.pwmControlledJoints[wbi_controlboard_id][controlBoard_jnt].yarp_controlboard_axis;
-                    buf_references[yarp_controlboard_axis] = ref[wbi_id];
-                }
-                ok = iopl[wbi_controlboard_id]->setRefOutputs(buf_references);
-                if(!ok)
-                {
-                    std::cerr << "yarpWholeBodyActuators::setControlReference error:"
-                              << " unable to command position for controlboard " << controlBoardNames[wbi_controlboard_id] << std::endl;
-                    return false;
-                }
+                ok = iopl[wbi_controlboard_id]->setRefOutputs(references);
             }
             else
             {
-                //Otherwise send all the commands individually
-                for( int controlBoard_jnt = 0; controlBoard_jnt < nrOfPWMControlledJointsInControlBoard; controlBoard_jnt++ )
+                //Send all the commands individually (IOpenLoopControl has no group interface)
+                ok = true;
+                for( int i = 0; i < nrOfAxes; i++ )
                 {
-                    int wbi_id = controlledJointsForControlBoard.pwmControlledJoints[wbi_controlboard_id][controlBoard_jnt].wbi_id;
-                    int yarp_controlboard_axis =  controlledJointsForControlBoard.pwmControlledJoints[wbi_controlboard_id][controlBoard_jnt].yarp_controlboard_axis;
-                    ok = iopl[wbi_controlboard_id]->setRefOutput(yarp_controlboard_axis,ref[wbi_id]);
+                    ok = iopl[wbi_controlboard_id]->setRefOutput(axes[i],references[i]) && ok;
                 }
             }
-        }
-
+            break;
+        default:
+            ok = false;
     }
-
+    addCommand(wbi_controlboard_id,commandInterface,ok,send_start);
     return ok;
 }
 
@@ -755,31 +1747,33 @@ ControlMode yarpWholeBodyActuators::yarpToWbiCtrlMode(int yarpCtrlMode)
 bool yarpWholeBodyActuators::setPIDGains(const double *pValue, const double *dValue, const double *iValue, int joint)
 {
     if (!initDone) return false;
+    yarp::os::LockGuard guard(commandMutex);
     //The FOR_ALL atomicity is debated in github.. currently do the same as the rest of the library
     bool result = true;
     if (joint < 0) {
-        return false;
-//        FOR_ALL(itBp, itJ) {
-//            switch (currentCtrlModes[ID(itBp->first,*itJ)]) {
-//                case wbi::CTRL_MODE_TORQUE:
-//                {
-//                    //this is wrong...
-////                    Pid currentPid;
-////                    result = itrq[itBp->first]->getTorquePid(joint, &currentPid);
-////                    if (!result) break;
-////                    if (pValue != NULL)
-////                        currentPid.kp = *pValue;
-////                    if (dValue != NULL)
-////                        currentPid.kd = *dValue;
-////                    if (iValue != NULL)
-////                        currentPid.ki = *iValue;
-////                    result = itrq[itBp->first]->setTorquePid(joint, currentPid);
-////                    break;
-//                }
-//                default:
-//                    break;
-//            }
-//        }
+        //Only the gains of the torque controlled joints are changed, one control board at a time
+        Pid * boardPids = boardPidsBuffer.empty() ? 0 : &(boardPidsBuffer[0]);
+        for (int wbi_controlboard_id = 0; wbi_controlboard_id < (int)controlBoardNames.size(); wbi_controlboard_id++) {
+            int nrOfTorqueControlledJoints = controlledJointsForControlBoard.torqueControlledJoints[wbi_controlboard_id].size();
+            if (nrOfTorqueControlledJoints == 0) continue;
+
+            bool ok = getTorquePidsOfControlBoard(wbi_controlboard_id, boardPids);
+            if (!ok) {
+                result = false;
+                continue;
+            }
+            for (int jnt = 0; jnt < nrOfTorqueControlledJoints; jnt++) {
+                const yarpWBAControlledJoint & controlledJoint = controlledJointsForControlBoard.torqueControlledJoints[wbi_controlboard_id][jnt];
+                Pid & currentPid = boardPids[controlledJoint.yarp_controlboard_axis];
+                if (pValue != NULL)
+                    currentPid.kp = pValue[controlledJoint.wbi_id];
+                if (dValue != NULL)
+                    currentPid.kd = dValue[controlledJoint.wbi_id];
+                if (iValue != NULL)
+                    currentPid.ki = iValue[controlledJoint.wbi_id];
+            }
+            result = setTorquePidsOfControlBoard(wbi_controlboard_id, boardPids) && result;
+        }
     }
     else {
         int bodyPart = controlBoardAxisList[joint].first;
@@ -787,16 +1781,20 @@ bool yarpWholeBodyActuators::setPIDGains(const double *pValue, const double *dVa
         switch (currentCtrlModes[joint]) {
             case wbi::CTRL_MODE_TORQUE:
             {
+                double send_start = yarp::os::Time::now();
                 Pid currentPid;
                 result = itrq[bodyPart]->getTorquePid(controlBoardJointAxis, &currentPid);
-                if (!result) break;
-                if (pValue != NULL)
-                    currentPid.kp = *pValue;
-                if (dValue != NULL)
-                    currentPid.kd = *dValue;
-                if (iValue != NULL)
-                    currentPid.ki = *iValue;
-                result = itrq[bodyPart]->setTorquePid(controlBoardJointAxis, currentPid);
+                if (result)
+                {
+                    if (pValue != NULL)
+                        currentPid.kp = *pValue;
+                    if (dValue != NULL)
+                        currentPid.kd = *dValue;
+                    if (iValue != NULL)
+                        currentPid.ki = *iValue;
+                    result = itrq[bodyPart]->setTorquePid(controlBoardJointAxis, currentPid);
+                }
+                addCommand(bodyPart,COMMAND_PID,result,send_start);
                 break;
             }
             default:
@@ -809,16 +1807,28 @@ bool yarpWholeBodyActuators::setPIDGains(const double *pValue, const double *dVa
 bool yarpWholeBodyActuators::setPIDGains(yarp::dev::Pid *pids, wbi::ControlMode controlMode, int joint)
 {
     if (!initDone) return false;
+    yarp::os::LockGuard guard(commandMutex);
     bool result = true;
     if (joint < 0) {
-        int i = 0;
         switch (controlMode) {
             case wbi::CTRL_MODE_TORQUE:
-                for (std::vector< std::pair<int,int> >::const_iterator jointPair = controlBoardAxisList.begin();
-                     jointPair != controlBoardAxisList.end(); ++jointPair) {
-                    result = result && itrq[jointPair->first]->setTorquePid(jointPair->second, pids[i++]);
+            {
+                //One call for each control board (plus one to read the pids of the axes not in the interface)
+                Pid * boardPids = boardPidsBuffer.empty() ? 0 : &(boardPidsBuffer[0]);
+                for (int wbi_controlboard_id = 0; wbi_controlboard_id < (int)controlBoardNames.size() && result; wbi_controlboard_id++) {
+                    if (totalControlledAxesInControlBoard[wbi_controlboard_id] < totalAxesInControlBoard[wbi_controlboard_id]) {
+                        result = getTorquePidsOfControlBoard(wbi_controlboard_id, boardPids);
+                        if (!result) break;
+                    }
+                    for (int wbi_jnt = 0; wbi_jnt < (int)controlBoardAxisList.size(); wbi_jnt++) {
+                        if (controlBoardAxisList[wbi_jnt].first == wbi_controlboard_id) {
+                            boardPids[controlBoardAxisList[wbi_jnt].second] = pids[wbi_jnt];
+                        }
+                    }
+                    result = setTorquePidsOfControlBoard(wbi_controlboard_id, boardPids);
                 }
                 break;
+            }
             default:
                 break;
         }
@@ -828,7 +1838,9 @@ bool yarpWholeBodyActuators::setPIDGains(yarp::dev::Pid *pids, wbi::ControlMode
         switch (controlMode) {
             case wbi::CTRL_MODE_TORQUE:
             {
+                double send_start = yarp::os::Time::now();
                 result = itrq[bodyPart]->setTorquePid(controlBoardJointAxis, *pids);
+                addCommand(bodyPart,COMMAND_PID,result,send_start);
                 break;
             }
             default:
@@ -841,16 +1853,23 @@ bool yarpWholeBodyActuators::setPIDGains(yarp::dev::Pid *pids, wbi::ControlMode
 bool yarpWholeBodyActuators::getPIDGains(yarp::dev::Pid *pids, wbi::ControlMode controlMode, int joint)
 {
     if (!initDone) return false;
+    yarp::os::LockGuard guard(commandMutex);
     bool result = true;
     if (joint < 0) {
-        int i = 0;
         switch (controlMode) {
             case wbi::CTRL_MODE_TORQUE:
-                for (std::vector< std::pair<int,int> >::const_iterator jointPair = controlBoardAxisList.begin();
-                     jointPair != controlBoardAxisList.end(); ++jointPair) {
-                    result = result && itrq[jointPair->first]->getTorquePid(jointPair->second, &pids[i++]);
+            {
+                Pid * boardPids = boardPidsBuffer.empty() ? 0 : &(boardPidsBuffer[0]);
+                for (int wbi_controlboard_id = 0; wbi_controlboard_id < (int)controlBoardNames.size() && result; wbi_controlboard_id++) {
+                    result = getTorquePidsOfControlBoard(wbi_controlboard_id, boardPids);
+                    for (int wbi_jnt = 0; wbi_jnt < (int)controlBoardAxisList.size() && result; wbi_jnt++) {
+                        if (controlBoardAxisList[wbi_jnt].first == wbi_controlboard_id) {
+                            pids[wbi_jnt] = boardPids[controlBoardAxisList[wbi_jnt].second];
+                        }
+                    }
                 }
                 break;
+            }
             default:
                 break;
 
@@ -871,6 +1890,89 @@ bool yarpWholeBodyActuators::getPIDGains(yarp::dev::Pid *pids, wbi::ControlMode
     return result;
 }
 
+bool yarpWholeBodyActuators::getTorquePidsOfControlBoard(const int wbi_controlboard_id, yarp::dev::Pid *boardPids)
+{
+    double send_start = yarp::os::Time::now();
+    bool ok = itrq[wbi_controlboard_id]->getTorquePids(boardPids);
+    addCommand(wbi_controlboard_id,COMMAND_PID,ok,send_start);
+    if (!ok) {
+        std::cerr << "[ERR] yarpWholeBodyActuators: unable to get the torque pids of controlboard "
+                  << controlBoardNames[wbi_controlboard_id] << std::endl;
+    }
+    return ok;
+}
+
+bool yarpWholeBodyActuators::setTorquePidsOfControlBoard(const int wbi_controlboard_id, const yarp::dev::Pid *boardPids)
+{
+    double send_start = yarp::os::Time::now();
+    bool ok = itrq[wbi_controlboard_id]->setTorquePids(boardPids);
+    addCommand(wbi_controlboard_id,COMMAND_PID,ok,send_start);
+    if (!ok) {
+        std::cerr << "[ERR] yarpWholeBodyActuators: unable to set the torque pids of controlboard "
+                  << controlBoardNames[wbi_controlboard_id] << std::endl;
+    }
+    return ok;
+}
+
+bool yarpWholeBodyActuators::applyGainSchedule(const PIDList & gains)
+{
+    if (!initDone) return false;
+    if (gains.size() != jointIdList.size()) {
+        std::cerr << "[ERR] yarpWholeBodyActuators::applyGainSchedule: " << gains.size()
+                  << " pids specified for " << jointIdList.size() << " joints" << std::endl;
+        return false;
+    }
+
+    yarp::os::LockGuard guard(commandMutex);
+
+    //Read all the current gains, to be able to restore them if a control board fails
+    std::vector< std::vector<Pid> > previousPids(controlBoardNames.size());
+    for (int wbi_controlboard_id = 0; wbi_controlboard_id < (int)controlBoardNames.size(); wbi_controlboard_id++) {
+        previousPids[wbi_controlboard_id].resize(totalAxesInControlBoard[wbi_controlboard_id]);
+        if (previousPids[wbi_controlboard_id].size() > 0
+            && !getTorquePidsOfControlBoard(wbi_controlboard_id, &(previousPids[wbi_controlboard_id][0]))) {
+            return false;
+        }
+    }
+
+    const Pid * newPids = gains.pidList();
+    for (int wbi_controlboard_id = 0; wbi_controlboard_id < (int)controlBoardNames.size(); wbi_controlboard_id++) {
+        if (previousPids[wbi_controlboard_id].size() == 0) continue;
+
+        std::vector<Pid> boardPids(previousPids[wbi_controlboard_id]);
+        for (int wbi_jnt = 0; wbi_jnt < (int)controlBoardAxisList.size(); wbi_jnt++) {
+            if (controlBoardAxisList[wbi_jnt].first == wbi_controlboard_id) {
+                boardPids[controlBoardAxisList[wbi_jnt].second] = newPids[wbi_jnt];
+            }
+        }
+
+        if (!setTorquePidsOfControlBoard(wbi_controlboard_id, &(boardPids[0]))) {
+            //Roll back the control boards already updated
+            for (int updatedBoard = wbi_controlboard_id - 1; updatedBoard >= 0; updatedBoard--) {
+                if (previousPids[updatedBoard].size() == 0) continue;
+                if (!setTorquePidsOfControlBoard(updatedBoard, &(previousPids[updatedBoard][0]))) {
+                    std::cerr << "[ERR] yarpWholeBodyActuators::applyGainSchedule: unable to restore the gains of controlboard "
+                              << controlBoardNames[updatedBoard] << std::endl;
+                }
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+bool yarpWholeBodyActuators::setImpedances(const double *stiffness, const double *damping)
+{
+    if (!initDone || !stiffness || !damping) return false;
+    bool result = true;
+    for (int wbi_jnt = 0; wbi_jnt < (int)controlBoardAxisList.size(); wbi_jnt++) {
+        int bodyPart = controlBoardAxisList[wbi_jnt].first;
+        int controlBoardAxis = controlBoardAxisList[wbi_jnt].second;
+        result = iimp[bodyPart]->setImpedance(controlBoardAxis, stiffness[wbi_jnt], damping[wbi_jnt]) && result;
+    }
+    return result;
+}
+
 bool yarpWholeBodyActuators::setMotorTorqueParameters(const yarp::dev::MotorTorqueParameters *motorParameters, int joint)
 {
     if (!initDone) return false;
@@ -19,12 +19,14 @@
 #include "yarpWholeBodyInterface.h"
 #include <iCub/skinDynLib/common.h>
 #include <yarp/os/Os.h>
+#include <yarp/os/LockGuard.h>
 #include <string>
 #include <cassert>
 
 #include "yarpWholeBodyActuators.h"
 #include "yarpWholeBodyModel.h"
 #include "yarpWholeBodyStates.h"
+#include "yarpWbiUtil.h"
 
 using namespace std;
 using namespace wbi;
@@ -52,6 +54,9 @@ yarpWholeBodyInterface::yarpWholeBodyInterface(
         _yarp_wbi_properties);
     stateInt = new yarpWholeBodyStates((_name + string("state")).c_str(),
         _yarp_wbi_properties, modelForStateInt);
+    lazyActuatorsInit = false;
+    actuatorsInitDone = false;
+    actuatorsInitFailed = false;
 }
 
 yarpWholeBodyInterface::~yarpWholeBodyInterface() { close(); }
@@ -94,7 +99,12 @@ bool yarpWholeBodyInterface::getYarpWbiProperties(
 
 bool yarpWholeBodyInterface::init()
 {
-    bool ok = actuatorInt->init();
+    yarp::os::Property yarp_wbi_properties;
+    actuatorInt->getYarpWbiProperties(yarp_wbi_properties);
+    lazyActuatorsInit = yarp_wbi_properties.check("lazyDeviceOpening")
+                        && yarp_wbi_properties.find("lazyDeviceOpening").asBool();
+
+    bool ok = lazyActuatorsInit || initActuators();
     if (!ok)
         printf(
             "[ERR] Error while initializing yarpWholeBodyActuators interface.\n");
@@ -113,6 +123,38 @@ bool yarpWholeBodyInterface::init()
     return ok;
 }
 
+bool yarpWholeBodyInterface::initActuators()
+{
+    // actuatorsInitDone is set after a memory barrier, so the initialized
+    // actuators interface is visible once the flag is read as true
+    if (*((volatile bool *)&actuatorsInitDone)) {
+        memoryBarrier();
+        return true;
+    }
+
+    yarp::os::LockGuard guard(actuatorsInitMutex);
+    if (actuatorsInitDone)
+        return true;
+    // a failed initialization is not repeated at each command
+    if (actuatorsInitFailed)
+        return false;
+
+    if (!actuatorInt->init()) {
+        actuatorsInitFailed = true;
+        return false;
+    }
+    memoryBarrier();
+    actuatorsInitDone = true;
+    return true;
+}
+
+bool yarpWholeBodyInterface::warmUp()
+{
+    bool ok = initActuators();
+    ok = stateInt->warmUp() && ok;
+    return ok;
+}
+
 bool yarpWholeBodyInterface::close()
 {
     bool ok = true;
@@ -218,15 +260,15 @@ const wbi::IDList& yarpWholeBodyInterface::getActuatorList()
 bool yarpWholeBodyInterface::setControlMode(wbi::ControlMode cm, double* ref,
     int jnt)
 {
-    return actuatorInt->setControlMode(cm, ref, jnt);
+    return initActuators() && actuatorInt->setControlMode(cm, ref, jnt);
 }
 bool yarpWholeBodyInterface::setControlReference(double* ref, int jnt)
 {
-    return actuatorInt->setControlReference(ref, jnt);
+    return initActuators() && actuatorInt->setControlReference(ref, jnt);
 }
 bool yarpWholeBodyInterface::setControlParam(wbi::ControlParam parId, const void* val, int jnt)
 {
-    return actuatorInt->setControlParam(parId, val, jnt);
+    return initActuators() && actuatorInt->setControlParam(parId, val, jnt);
 }
 
 // STATES
@@ -17,6 +17,7 @@
 
 #include "yarpWholeBodyModel.h"
 #include "yarpWbiUtil.h"
+#include "yarpWholeBodyModelCache.h"
 
 #include <string>
 #include <cmath>
@@ -34,6 +35,9 @@
 #include <iDynTree/Core/Position.h>
 
 #include <iCub/iDynTree/DynTree.h>
+#include <iDynTree/ModelIO/impl/urdf_import.hpp>
+
+#include <kdl/tree.hpp>
 
 #include <iDynTree/yarp/YARPConversions.h>
 
@@ -46,6 +50,42 @@ using namespace yarp::sig;
 using namespace yarp::math;
 using namespace iCub::skinDynLib;
 
+// *********************************************************************************************************************
+// *********************************************************************************************************************
+//                                          JOINT LIMITS FETCHER
+// *********************************************************************************************************************
+// *********************************************************************************************************************
+
+namespace yarpWbi
+{
+    /**
+     * Reading of the limits of the joints of a single control board,
+     * used to query all the control boards in parallel.
+     */
+    class jointLimitsFetcher: public parallelTask
+    {
+    private:
+        yarpWholeBodyModel * model;
+        int controlBoard;
+
+    public:
+        jointLimitsFetcher(yarpWholeBodyModel * _model, const int _controlBoard):
+        model(_model), controlBoard(_controlBoard)
+        {
+        }
+
+        virtual bool execute()
+        {
+            return model->fetchJointLimitsOfControlBoard(controlBoard);
+        }
+
+        virtual std::string getDescription() const
+        {
+            return "joint limits of " + model->controlBoardNames[controlBoard];
+        }
+    };
+}
+
 // *********************************************************************************************************************
 // *********************************************************************************************************************
 //                                          YARP WHOLE BODY MODEL
@@ -61,7 +101,8 @@ yarpWholeBodyModel::yarpWholeBodyModel(const char* _name,
       three_elem_buffer(3,0.0),
       homMatrixBuffer(4,4),
       adjMatrixBuffer(6,6),
-      getLimitsFromControlBoard(false)
+      getLimitsFromControlBoard(false),
+      jointLimitsCached(false)
 {
 }
 
@@ -124,7 +165,7 @@ bool yarpWholeBodyModel::init()
     std::vector<std::string> joint_names;
     joint_names.resize(0,"");
     dof = jointIdList.size();
-    p_model = new iCub::iDynTree::DynTree(std::string(urdf_file_path),joint_names,kinematic_base_link_name);
+    p_model = createModel(urdf_file_path,joint_names,kinematic_base_link_name);
     all_q.resize(p_model->getNrOfDOFs(),0.0);
     all_q_min = all_q_max = all_ddq = all_dq = all_q;
     floating_base_mass_matrix.resize(p_model->getNrOfDOFs(),p_model->getNrOfDOFs());
@@ -161,12 +202,11 @@ bool yarpWholeBodyModel::init()
                                          controlBoardNames,
                                          controlBoardAxisList);
 
-        dd.resize(controlBoardNames.size());
-        ilim.resize(controlBoardNames.size());
+        dd.resize(controlBoardNames.size(),0);
+        ilim.resize(controlBoardNames.size(),0);
     }
 
 
-
     //Build the map between wbi id and iDynTree id
     wbiToiDynTreeJointId.resize(jointIdList.size());
     for(int wbi_numeric_id =0;  wbi_numeric_id < (int)jointIdList.size(); wbi_numeric_id++ )
@@ -193,14 +233,69 @@ bool yarpWholeBodyModel::init()
         frameIdList.addID(frame_name);
     }
 
+    // The limits are read only once from the control boards, as opening them takes
+    // hundreds of milliseconds: call refreshJointLimits if they are changed on the robot.
+    // Without them getJointLimits would always fail, so a failure here is fatal
+    if( this->getLimitsFromControlBoard && !refreshJointLimits() )
+    {
+        yError() << "yarpWholeBodyModel error: unable to get the joint limits from the control boards";
+        return false;
+    }
+
     this->initDone = true;
     return this->initDone;
 }
 
+iCub::iDynTree::DynTree * yarpWholeBodyModel::createModel(const std::string & urdf_file_path,
+                                                          const std::vector<std::string> & joint_names,
+                                                          const std::string & kinematic_base_link_name)
+{
+    unsigned long long urdfHash = 0;
+    if( !wbi_yarp_properties.check("modelCacheDirectory")
+        || !computeFileHash(urdf_file_path,urdfHash) )
+    {
+        return new iCub::iDynTree::DynTree(urdf_file_path,joint_names,kinematic_base_link_name);
+    }
+
+    std::string cacheFile = getModelCacheFileName(wbi_yarp_properties.find("modelCacheDirectory").asString().c_str(),urdfHash);
+    KDL::Tree tree;
+    std::vector<double> jointBoundMin, jointBoundMax;
+    if( loadModelCache(cacheFile,urdfHash,tree,jointBoundMin,jointBoundMax) )
+    {
+        iCub::iDynTree::DynTree * model = new iCub::iDynTree::DynTree(tree,joint_names,kinematic_base_link_name);
+        if( model->getNrOfDOFs() == (int)jointBoundMin.size() )
+        {
+            model->setJointBoundMin(yarp::sig::Vector(jointBoundMin.size(),&(jointBoundMin[0])));
+            model->setJointBoundMax(yarp::sig::Vector(jointBoundMax.size(),&(jointBoundMax[0])));
+            return model;
+        }
+        yWarning() << "yarpWholeBodyModel: the model cache" << cacheFile << "is not consistent, loading the urdf file";
+        delete model;
+    }
+
+    iCub::iDynTree::DynTree * model = new iCub::iDynTree::DynTree(urdf_file_path,joint_names,kinematic_base_link_name);
+
+    // the DynTree does not expose the parsed KDL tree, so the urdf is parsed
+    // once more for writing the cache (only the first time the urdf is loaded)
+    if( iDynTree::treeFromUrdfFile(urdf_file_path,tree) )
+    {
+        yarp::sig::Vector qMin = model->getJointBoundMin();
+        yarp::sig::Vector qMax = model->getJointBoundMax();
+        jointBoundMin.assign(qMin.data(),qMin.data()+qMin.size());
+        jointBoundMax.assign(qMax.data(),qMax.data()+qMax.size());
+        if( !saveModelCache(cacheFile,urdfHash,tree,jointBoundMin,jointBoundMax) )
+        {
+            yWarning() << "yarpWholeBodyModel: unable to write the model cache" << cacheFile;
+        }
+    }
+
+    return model;
+}
+
 bool yarpWholeBodyModel::openDrivers(int bp)
 {
     ilim[bp]=0; dd[bp]=0;
-    if(!openPolyDriver(name+"model", robot, dd[bp], controlBoardNames[bp]))
+    if(!openControlBoardDriver(name+"model", robot, dd[bp], controlBoardNames[bp], wbi_yarp_properties))
         return false;
     bool ok = dd[bp]->view(ilim[bp]);   //if(!isRobotSimulator(robot))
     if(ok)
@@ -215,9 +310,7 @@ bool yarpWholeBodyModel::closeDrivers()
     for(int bp=0; bp < (int)controlBoardNames.size(); bp++ )
     {
         if( dd[bp] != 0 ) {
-            ok = ok && dd[bp]->close();
-            delete dd[bp];
-            dd[bp] = 0;
+            ok = closeControlBoardDriver(dd[bp]) && ok;
         }
     }
     return ok;
@@ -409,18 +502,71 @@ void yarpWholeBodyModel::posToAdjMatrix(double * pos, const yarp::sig::Matrix &
 
 
 
-bool yarpWholeBodyModel::getJointLimitFromControlBoard(double *qMin, double *qMax, int joint)
+bool yarpWholeBodyModel::fetchJointLimitsOfControlBoard(const int bp)
 {
-            int controlBoardId = controlBoardAxisList[joint].first;
-            int index = controlBoardAxisList[joint].second;
-            assert(ilim[controlBoardId]!=NULL);
-            bool res = ilim[controlBoardId]->getLimits(index, qMin, qMax);
-            if(res)
-            {
-                *qMin = (*qMin) * yarpWbi::Deg2Rad;   // convert from deg to rad
-                *qMax = (*qMax) * yarpWbi::Deg2Rad;   // convert from deg to rad
-            }
-            return res;
+    bool ok = openDrivers(bp);
+    for(int jnt=0; ok && jnt < (int)controlBoardAxisList.size(); jnt++ )
+    {
+        if( controlBoardAxisList[jnt].first != bp )
+        {
+            continue;
+        }
+        double qMin = 0.0, qMax = 0.0;
+        ok = ilim[bp]->getLimits(controlBoardAxisList[jnt].second, &qMin, &qMax);
+        if( ok )
+        {
+            fetchedJointLimitsMin[jnt] = qMin * yarpWbi::Deg2Rad;   // convert from deg to rad
+            fetchedJointLimitsMax[jnt] = qMax * yarpWbi::Deg2Rad;   // convert from deg to rad
+        }
+    }
+
+    if( dd[bp] != 0 )
+    {
+        ok = closeControlBoardDriver(dd[bp]) && ok;
+        ilim[bp] = 0;
+    }
+
+    if( !ok )
+    {
+        yError("yarpWholeBodyModel: unable to get the joint limits of %s", controlBoardNames[bp].c_str());
+    }
+    return ok;
+}
+
+bool yarpWholeBodyModel::refreshJointLimits()
+{
+    if( !this->getLimitsFromControlBoard )
+    {
+        return false;
+    }
+
+    // the limits are read in temporary buffers, so that a failure does not leave them partially updated
+    int n = jointIdList.size();
+    fetchedJointLimitsMin.assign(n,0.0);
+    fetchedJointLimitsMax.assign(n,0.0);
+
+    // each control board is opened and queried in its own thread
+    std::vector<parallelTask*> fetchers;
+    for(int bp=0; bp < (int)controlBoardNames.size(); bp++ )
+    {
+        fetchers.push_back(new jointLimitsFetcher(this,bp));
+    }
+
+    bool ok = runTasksInParallel(fetchers,(int)fetchers.size());
+
+    for(int bp=0; bp < (int)fetchers.size(); bp++ )
+    {
+        delete fetchers[bp];
+    }
+
+    // on failure the previously cached limits (if any) are kept
+    if( ok )
+    {
+        jointLimitsMin.swap(fetchedJointLimitsMin);
+        jointLimitsMax.swap(fetchedJointLimitsMax);
+        jointLimitsCached = true;
+    }
+    return ok;
 }
 
 bool yarpWholeBodyModel::getJointLimits(double *qMin, double *qMax, int joint)
@@ -432,30 +578,26 @@ bool yarpWholeBodyModel::getJointLimits(double *qMin, double *qMax, int joint)
 
     if( this->getLimitsFromControlBoard ) {
 
-        bool ret = true;
-        for(int bp=0; bp < (int)controlBoardNames.size(); bp++ )
+        if( !jointLimitsCached )
         {
-            ret = ret && openDrivers(bp);
+            return false;
         }
 
-        if( ret )
+        if( joint >= 0 )
         {
-            if(joint>=0)
-            {
-                ret = ret &&  getJointLimitFromControlBoard(qMin,qMax,joint);
-            }
-            else
+            *qMin = jointLimitsMin[joint];
+            *qMax = jointLimitsMax[joint];
+        }
+        else
+        {
+            int n = jointIdList.size();
+            for(int i=0; i<n; i++)
             {
-                int n = jointIdList.size();
-                for(int i=0; i<n; i++)
-                    ret = ret && getJointLimitFromControlBoard(qMin+i, qMax+i, i);
+                qMin[i] = jointLimitsMin[i];
+                qMax[i] = jointLimitsMax[i];
             }
         }
-
-        ret = ret && closeDrivers();
-
-        return ret;
-
+        return true;
 
     } else {
       // OLD IMPLEMENTATION
@@ -518,9 +660,11 @@ bool yarpWholeBodyModel::computeJacobian(double *q, const Frame &xBase, int link
     bool ret_val;
 
     int dof_jacobian = dof+6;
-    Matrix complete_jacobian(6,all_q.size()+6), reduced_jacobian(6,dof_jacobian);
-    complete_jacobian.zero();
-    reduced_jacobian.zero();
+    if( completeJacobianBuffer.rows() != 6 || completeJacobianBuffer.cols() != (int)all_q.size()+6 )
+    {
+        completeJacobianBuffer.resize(6,all_q.size()+6);
+    }
+    completeJacobianBuffer.zero();
 
     convertBasePose(xBase,world_base_transformation);
     convertQ(q,all_q);
@@ -530,37 +674,45 @@ bool yarpWholeBodyModel::computeJacobian(double *q, const Frame &xBase, int link
 
     //Get Jacobian, the one of the link or the one of the COM
     if( linkId != COM_LINK_ID ) {
-         ret_val = p_model->getJacobian(linkId,complete_jacobian);
+         ret_val = p_model->getJacobian(linkId,completeJacobianBuffer);
          if( !ret_val ) return false;
     } else {
-         ret_val = p_model->getCOMJacobian(complete_jacobian);
+         ret_val = p_model->getCOMJacobian(completeJacobianBuffer);
          if( !ret_val ) return false;
     }
 
-
-    int i=0;
-    for(int wbi_joint_numeric_id=0; wbi_joint_numeric_id < this->dof; wbi_joint_numeric_id++ )
+    // the base columns and the columns of the joints of the wbi are copied
+    // directly in the (row major) output, without temporary matrices
+    for(int row=0; row < 6; row++ )
     {
-        reduced_jacobian.setCol(wbi_joint_numeric_id+6,complete_jacobian.getCol(6+wbiToiDynTreeJointId[wbi_joint_numeric_id]));
-        i++;
+        double * J_row = J + row*dof_jacobian;
+        for(int col=0; col < 6; col++ )
+        {
+            J_row[col] = completeJacobianBuffer(row,col);
+        }
+        for(int wbi_joint_numeric_id=0; wbi_joint_numeric_id < this->dof; wbi_joint_numeric_id++ )
+        {
+            J_row[6+wbi_joint_numeric_id] = completeJacobianBuffer(row,6+wbiToiDynTreeJointId[wbi_joint_numeric_id]);
+        }
     }
-    reduced_jacobian.setSubmatrix(complete_jacobian.submatrix(0,5,0,5),0,0);
 
     if( pos )
     {
         Matrix world_H_frameWithoutOffset = p_model->getPosition(linkId);
         Matrix world_R_frameWithoutOffset = world_H_frameWithoutOffset.submatrix(0,2,0,2);
 
-        reducedJacobianBuffer = reduced_jacobian;
+        if( reducedJacobianBuffer.rows() != 6 || reducedJacobianBuffer.cols() != dof_jacobian )
+        {
+            reducedJacobianBuffer.resize(6,dof_jacobian);
+        }
+        memcpy(reducedJacobianBuffer.data(),J,sizeof(double)*6*dof_jacobian);
 
         posToAdjMatrix(pos,world_R_frameWithoutOffset,adjMatrixBuffer);
 
-        reduced_jacobian = adjMatrixBuffer*reducedJacobianBuffer;
+        Matrix reduced_jacobian = adjMatrixBuffer*reducedJacobianBuffer;
+        memcpy(J,reduced_jacobian.data(),sizeof(double)*6*dof_jacobian);
     }
 
-
-    memcpy(J,reduced_jacobian.data(),sizeof(double)*6*dof_jacobian);
-
     return true;
 }
 
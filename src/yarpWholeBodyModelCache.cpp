@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include "yarpWholeBodyModelCache.h"
+#include "yarpWbiUtil.h"
+
+#include <yarp/os/Log.h>
+
+#include <kdl/tree.hpp>
+#include <kdl/segment.hpp>
+#include <kdl/joint.hpp>
+#include <kdl/frames.hpp>
+#include <kdl/rigidbodyinertia.hpp>
+#include <kdl/rotationalinertia.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace yarpWbi;
+
+// Increase the version every time the layout of the cache file is changed
+#define MODEL_CACHE_MAGIC "WBIMODEL"
+#define MODEL_CACHE_VERSION 1
+
+namespace
+{
+    /** Serialization of the cache in a memory buffer */
+    class cacheWriter
+    {
+    public:
+        std::vector<char> buffer;
+
+        void appendBytes(const void * data, const size_t size)
+        {
+            const char * bytes = (const char *)data;
+            buffer.insert(buffer.end(),bytes,bytes+size);
+        }
+
+        void appendInt(const int value)
+        {
+            appendBytes(&value,sizeof(int));
+        }
+
+        void appendDouble(const double value)
+        {
+            appendBytes(&value,sizeof(double));
+        }
+
+        void appendDoubles(const double * values, const int nrOfValues)
+        {
+            appendBytes(values,nrOfValues*sizeof(double));
+        }
+
+        void appendString(const std::string & value)
+        {
+            appendInt((int)value.size());
+            appendBytes(value.c_str(),value.size());
+        }
+    };
+
+    /** Deserialization of the cache from the memory mapped file, checking its bounds */
+    class cacheReader
+    {
+    private:
+        const char * data;
+        size_t size;
+        size_t offset;
+        bool error;
+
+    public:
+        cacheReader(const char * _data, const size_t _size): data(_data), size(_size), offset(0), error(false)
+        {
+        }
+
+        bool isError() const
+        {
+            return error;
+        }
+
+        bool expectBytes(void * out, const size_t nrOfBytes)
+        {
+            if( error || nrOfBytes > size - offset )
+            {
+                error = true;
+                return false;
+            }
+            memcpy(out,data+offset,nrOfBytes);
+            offset += nrOfBytes;
+            return true;
+        }
+
+        int expectInt()
+        {
+            int value = 0;
+            expectBytes(&value,sizeof(int));
+            return value;
+        }
+
+        double expectDouble()
+        {
+            double value = 0.0;
+            expectBytes(&value,sizeof(double));
+            return value;
+        }
+
+        void expectDoubles(double * values, const int nrOfValues)
+        {
+            if( nrOfValues < 0 )
+            {
+                error = true;
+                return;
+            }
+            expectBytes(values,nrOfValues*sizeof(double));
+        }
+
+        std::string expectString()
+        {
+            int length = expectInt();
+            if( error || length < 0 || (size_t)length > size - offset )
+            {
+                error = true;
+                return "";
+            }
+            std::string value(data+offset,length);
+            offset += length;
+            return value;
+        }
+    };
+
+    void appendSegment(cacheWriter & writer, const KDL::Segment & segment, const std::string & parentName)
+    {
+        writer.appendString(segment.getName());
+        writer.appendString(parentName);
+
+        const KDL::Joint & joint = segment.getJoint();
+        writer.appendString(joint.getName());
+        writer.appendInt((int)joint.getType());
+        writer.appendDoubles(joint.JointOrigin().data,3);
+        writer.appendDoubles(joint.JointAxis().data,3);
+
+        const KDL::Frame & frameToTip = segment.getFrameToTip();
+        writer.appendDoubles(frameToTip.p.data,3);
+        writer.appendDoubles(frameToTip.M.data,9);
+
+        // the inertia is saved with respect to the center of mass,
+        // as required by the RigidBodyInertia constructor
+        const KDL::RigidBodyInertia & inertia = segment.getInertia();
+        double mass = inertia.getMass();
+        KDL::Vector cog = inertia.getCOG();
+        KDL::RotationalInertia inertiaAtOrigin = inertia.getRotationalInertia();
+        double inertiaAtCOG[9];
+        double cogSquaredNorm = KDL::dot(cog,cog);
+        for(int i=0; i < 3; i++ )
+        {
+            for(int j=0; j < 3; j++ )
+            {
+                inertiaAtCOG[3*i+j] = inertiaAtOrigin.data[3*i+j] + mass*(cog(i)*cog(j) - (i == j ? cogSquaredNorm : 0.0));
+            }
+        }
+        writer.appendDouble(mass);
+        writer.appendDoubles(cog.data,3);
+        writer.appendDoubles(inertiaAtCOG,9);
+    }
+
+    bool expectSegment(cacheReader & reader, KDL::Tree & tree)
+    {
+        std::string segmentName = reader.expectString();
+        std::string parentName = reader.expectString();
+
+        std::string jointName = reader.expectString();
+        int jointType = reader.expectInt();
+        KDL::Vector jointOrigin, jointAxis;
+        reader.expectDoubles(jointOrigin.data,3);
+        reader.expectDoubles(jointAxis.data,3);
+
+        KDL::Frame frameToTip;
+        reader.expectDoubles(frameToTip.p.data,3);
+        reader.expectDoubles(frameToTip.M.data,9);
+
+        double mass = reader.expectDouble();
+        KDL::Vector cog;
+        double inertiaAtCOG[9];
+        reader.expectDoubles(cog.data,3);
+        reader.expectDoubles(inertiaAtCOG,9);
+
+        if( reader.isError() || jointType < (int)KDL::Joint::RotAxis || jointType > (int)KDL::Joint::None )
+        {
+            return false;
+        }
+
+        KDL::Joint joint;
+        KDL::Joint::JointType type = (KDL::Joint::JointType)jointType;
+        if( type == KDL::Joint::RotAxis || type == KDL::Joint::TransAxis )
+        {
+            joint = KDL::Joint(jointName,jointOrigin,jointAxis,type);
+        }
+        else
+        {
+            joint = KDL::Joint(jointName,type);
+        }
+
+        KDL::RotationalInertia rotationalInertia(inertiaAtCOG[0],inertiaAtCOG[4],inertiaAtCOG[8],
+                                                 inertiaAtCOG[1],inertiaAtCOG[2],inertiaAtCOG[5]);
+        KDL::RigidBodyInertia inertia(mass,cog,rotationalInertia);
+
+        return tree.addSegment(KDL::Segment(segmentName,joint,frameToTip,inertia),parentName);
+    }
+}
+
+bool yarpWbi::computeFileHash(const std::string & path, unsigned long long & hash)
+{
+    memoryMappedFile file;
+    if( !file.openReadOnly(path) )
+    {
+        return false;
+    }
+
+    // 64 bit FNV-1a
+    hash = 14695981039346656037ULL;
+    const unsigned char * data = (const unsigned char *)file.data();
+    for(size_t i=0; i < file.size(); i++ )
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return file.close();
+}
+
+std::string yarpWbi::getModelCacheFileName(const std::string & directory, const unsigned long long urdfHash)
+{
+    char hashString[17];
+    sprintf(hashString,"%016llx",urdfHash);
+    return directory + "/yarpWholeBodyModel-" + hashString + ".bin";
+}
+
+bool yarpWbi::saveModelCache(const std::string & cacheFile,
+                             const unsigned long long urdfHash,
+                             const KDL::Tree & tree,
+                             const std::vector<double> & jointBoundMin,
+                             const std::vector<double> & jointBoundMax)
+{
+    cacheWriter writer;
+    writer.appendBytes(MODEL_CACHE_MAGIC,strlen(MODEL_CACHE_MAGIC));
+    writer.appendInt(MODEL_CACHE_VERSION);
+    writer.appendBytes(&urdfHash,sizeof(urdfHash));
+
+    // the segments are visited breadth first, so each of them can be added to the tree after its parent
+    KDL::SegmentMap::const_iterator root = tree.getRootSegment();
+    writer.appendString(root->first);
+    writer.appendInt((int)tree.getNrOfSegments());
+
+    std::deque<KDL::SegmentMap::const_iterator> segmentsToVisit;
+    segmentsToVisit.push_back(root);
+    while( !segmentsToVisit.empty() )
+    {
+        KDL::SegmentMap::const_iterator parent = segmentsToVisit.front();
+        segmentsToVisit.pop_front();
+        for(size_t child=0; child < parent->second.children.size(); child++ )
+        {
+            KDL::SegmentMap::const_iterator segment = parent->second.children[child];
+            appendSegment(writer,segment->second.segment,parent->first);
+            segmentsToVisit.push_back(segment);
+        }
+    }
+
+    writer.appendInt((int)jointBoundMin.size());
+    if( !jointBoundMin.empty() )
+    {
+        writer.appendDoubles(&(jointBoundMin[0]),jointBoundMin.size());
+        writer.appendDoubles(&(jointBoundMax[0]),jointBoundMax.size());
+    }
+
+    // write the cache with a temporary name, and then atomically replace the old one
+    std::string temporaryFile = cacheFile + ".tmp";
+#ifndef _WIN32
+    temporaryFile = cacheFile + "." + stringFromInt((int)getpid()) + ".tmp";
+#endif
+
+    memoryMappedFile file;
+    if( !file.create(temporaryFile,writer.buffer.size()) )
+    {
+        return false;
+    }
+    memcpy(file.data(),&(writer.buffer[0]),writer.buffer.size());
+    if( !file.close() || rename(temporaryFile.c_str(),cacheFile.c_str()) != 0 )
+    {
+        yError("saveModelCache: impossible to write the model cache %s", cacheFile.c_str());
+        remove(temporaryFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool yarpWbi::loadModelCache(const std::string & cacheFile,
+                             const unsigned long long urdfHash,
+                             KDL::Tree & tree,
+                             std::vector<double> & jointBoundMin,
+                             std::vector<double> & jointBoundMax)
+{
+    memoryMappedFile file;
+    if( !file.openReadOnly(cacheFile) )
+    {
+        return false;
+    }
+
+    cacheReader reader(file.data(),file.size());
+
+    char magic[sizeof(MODEL_CACHE_MAGIC)-1];
+    unsigned long long cachedUrdfHash = 0;
+    reader.expectBytes(magic,sizeof(magic));
+    int version = reader.expectInt();
+    reader.expectBytes(&cachedUrdfHash,sizeof(cachedUrdfHash));
+    if( reader.isError()
+        || memcmp(magic,MODEL_CACHE_MAGIC,sizeof(magic)) != 0
+        || version != MODEL_CACHE_VERSION
+        || cachedUrdfHash != urdfHash )
+    {
+        file.close();
+        return false;
+    }
+
+    tree = KDL::Tree(reader.expectString());
+    int nrOfSegments = reader.expectInt();
+    bool ok = !reader.isError() && nrOfSegments >= 0;
+    for(int segment=0; ok && segment < nrOfSegments; segment++ )
+    {
+        ok = expectSegment(reader,tree);
+    }
+
+    int nrOfDOFs = reader.expectInt();
+    ok = ok && !reader.isError() && nrOfDOFs >= 0;
+    if( ok )
+    {
+        jointBoundMin.resize(nrOfDOFs);
+        jointBoundMax.resize(nrOfDOFs);
+        if( nrOfDOFs > 0 )
+        {
+            reader.expectDoubles(&(jointBoundMin[0]),nrOfDOFs);
+            reader.expectDoubles(&(jointBoundMax[0]),nrOfDOFs);
+        }
+        ok = !reader.isError();
+    }
+
+    file.close();
+    return ok;
+}
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include "yarpWholeBodyOutputStage.h"
+
+#include <yarp/os/Bottle.h>
+#include <yarp/os/Value.h>
+
+#include <iostream>
+#include <string>
+
+using namespace yarpWbi;
+
+// Finite value used for the limits that are not set: large enough to never limit the references,
+// but such that 0*UNLIMITED is 0
+#define UNLIMITED 1e150
+
+namespace
+{
+    /**
+     * Load an option that can be specified with a single value or with a value for each joint.
+     * Non positive values are replaced with noLimitValue.
+     */
+    bool loadPerJointOption(const yarp::os::Bottle & actuators_opt_bot, const std::string & option,
+                            const int nrOfJoints, const double noLimitValue, Eigen::ArrayXd & values)
+    {
+        values.setConstant(nrOfJoints,noLimitValue);
+        if( !actuators_opt_bot.check(option.c_str()) )
+        {
+            return true;
+        }
+
+        yarp::os::Value & value = actuators_opt_bot.find(option.c_str());
+        if( value.isList() )
+        {
+            yarp::os::Bottle * list = value.asList();
+            if( list->size() != nrOfJoints )
+            {
+                std::cerr << "[ERR] referenceOutputStage: " << option << " has " << list->size()
+                          << " elements, while " << nrOfJoints << " joints are controlled" << std::endl;
+                return false;
+            }
+            for(int jnt = 0; jnt < nrOfJoints; jnt++ )
+            {
+                values[jnt] = list->get(jnt).asDouble();
+            }
+        }
+        else
+        {
+            values.setConstant(nrOfJoints,value.asDouble());
+        }
+
+        values = (values > 0.0).select(values,noLimitValue);
+        return true;
+    }
+}
+
+referenceOutputStage::referenceOutputStage():
+nrOfJoints(0),
+filtering(false),
+initialized(false),
+lastTime(0.0),
+decimation(1),
+decimationCounter(0)
+{
+}
+
+bool referenceOutputStage::configure(const yarp::os::Bottle & actuators_opt_bot, const int _nrOfJoints)
+{
+    nrOfJoints = _nrOfJoints;
+
+    bool ok = loadPerJointOption(actuators_opt_bot,"referenceSmoothingTimeConstant",nrOfJoints,0.0,smoothingTimeConstant);
+    ok = ok && loadPerJointOption(actuators_opt_bot,"referenceMaxRate",nrOfJoints,UNLIMITED,maxRate);
+    ok = ok && loadPerJointOption(actuators_opt_bot,"referenceMaxAcceleration",nrOfJoints,UNLIMITED,maxAcceleration);
+    if( !ok )
+    {
+        return false;
+    }
+
+    filtering = (smoothingTimeConstant > 0.0).any() || (maxRate < UNLIMITED).any() || (maxAcceleration < UNLIMITED).any();
+
+    decimation = actuators_opt_bot.check("referenceDecimation",yarp::os::Value(1)).asInt();
+    if( decimation < 1 )
+    {
+        std::cerr << "[ERR] referenceOutputStage: referenceDecimation should be at least 1" << std::endl;
+        return false;
+    }
+
+    smoothed.setZero(nrOfJoints);
+    output.setZero(nrOfJoints);
+    velocity.setZero(nrOfJoints);
+    error.setZero(nrOfJoints);
+    maxVelocity.setZero(nrOfJoints);
+    needsReset.setOnes(nrOfJoints);
+
+    reset();
+    return true;
+}
+
+bool referenceOutputStage::isEnabled() const
+{
+    return filtering || decimation > 1;
+}
+
+bool referenceOutputStage::isFiltering() const
+{
+    return filtering;
+}
+
+void referenceOutputStage::reset()
+{
+    initialized = false;
+    decimationCounter = 0;
+    needsReset.setOnes();
+}
+
+void referenceOutputStage::resetJoint(const int joint)
+{
+    if( joint < 0 || joint >= nrOfJoints )
+    {
+        return;
+    }
+    needsReset[joint] = 1.0;
+}
+
+void referenceOutputStage::setJoint(const int joint, const double reference)
+{
+    if( joint < 0 || joint >= nrOfJoints )
+    {
+        return;
+    }
+    smoothed[joint] = reference;
+    output[joint] = reference;
+    velocity[joint] = 0.0;
+    needsReset[joint] = 0.0;
+}
+
+const double * referenceOutputStage::process(const double * ref, const double now)
+{
+    Eigen::Map<const Eigen::ArrayXd> reference(ref,nrOfJoints);
+
+    if( !filtering )
+    {
+        output = reference;
+        return output.data();
+    }
+
+    if( !initialized )
+    {
+        smoothed = reference;
+        output = reference;
+        velocity.setZero();
+        needsReset.setZero();
+        lastTime = now;
+        initialized = true;
+        return output.data();
+    }
+
+    if( (needsReset > 0.0).any() )
+    {
+        smoothed = (needsReset > 0.0).select(reference,smoothed);
+        output = (needsReset > 0.0).select(reference,output);
+        velocity = (needsReset > 0.0).select(0.0,velocity);
+        needsReset.setZero();
+    }
+
+    double dt = now - lastTime;
+    if( dt <= 0.0 )
+    {
+        return output.data();
+    }
+    lastTime = now;
+
+    // first order low pass filter
+    smoothed += (dt/(smoothingTimeConstant+dt))*(reference-smoothed);
+
+    // the output moves toward the smoothed reference at a velocity that allows it to stop on the
+    // reference with the maximum deceleration, and never crosses it in a single step
+    error = smoothed - output;
+    // (the bound on the velocity is the one of the discrete time system, to avoid overshooting by maxAcceleration*dt*dt)
+    maxVelocity = maxRate.min(error.abs()/dt);
+    maxVelocity = (maxAcceleration < UNLIMITED).select(
+        maxVelocity.min(maxAcceleration*dt*((0.25+2.0*error.abs()/(maxAcceleration*dt*dt)).sqrt()-0.5)),
+        maxVelocity);
+    velocity += ((error >= 0.0).select(maxVelocity,-maxVelocity)-velocity).max(-maxAcceleration*dt).min(maxAcceleration*dt);
+    output += velocity*dt;
+
+    return output.data();
+}
+
+bool referenceOutputStage::decimationTick()
+{
+    bool send = (decimationCounter == 0);
+    decimationCounter = (decimationCounter+1) % decimation;
+    return send;
+}
@@ -20,11 +20,14 @@
 
 #include <yarp/os/Time.h>
 #include <yarp/os/Stamp.h>
+#include <yarp/os/LockGuard.h>
 #include <string>
 #include <sstream>
 #include <cassert>
+#include <algorithm>
 
 #include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
 
 using namespace std;
 using namespace wbi;
@@ -40,14 +43,129 @@ using namespace iCub::ctrl;
 #define BLOCKING_SENSOR_TIMEOUT 0.1
 #define INITIAL_TIMESTAMP -1000.0
 
+// *********************************************************************************************************************
+// *********************************************************************************************************************
+//                                          SENSORS STARTUP TASK
+// *********************************************************************************************************************
+// *********************************************************************************************************************
+
+namespace yarpWbi
+{
+    /**
+     * Opening of a control board or of the port of a sensor, executed by yarpWholeBodySensors::init.
+     */
+    class sensorsStartupTask: public parallelTask
+    {
+    public:
+        enum Type { CONTROL_BOARD, ENCODER, PWM, TORQUE_SENSOR, FT_SENSOR, IMU };
+
+    private:
+        yarpWholeBodySensors * sensors;
+        Type type;
+        int index;
+        std::string name; // name of the control board or of the port
+
+    public:
+        sensorsStartupTask(yarpWholeBodySensors * _sensors, const Type _type, const int _index, const std::string & _name):
+        sensors(_sensors), type(_type), index(_index), name(_name)
+        {
+        }
+
+        virtual bool execute()
+        {
+            switch( type )
+            {
+                case CONTROL_BOARD:
+                    return sensors->openControlBoardSensors(index);
+                case ENCODER:
+                    return sensors->openEncoder(index);
+                case PWM:
+                    return sensors->readControlBoardAxes(index) && sensors->openPwm(index);
+                case TORQUE_SENSOR:
+                    return sensors->readControlBoardAxes(index) && sensors->openTorqueSensor(index);
+                case FT_SENSOR:
+                    return sensors->openFTsens(index,name);
+                case IMU:
+                    return sensors->openImu(index,name);
+                default:
+                    return false;
+            }
+        }
+
+        virtual std::string getDescription() const
+        {
+            switch( type )
+            {
+                case CONTROL_BOARD:
+                    return "control board " + name;
+                case ENCODER:
+                    return "encoders of " + name;
+                case PWM:
+                    return "pwm of " + name;
+                case TORQUE_SENSOR:
+                    return "torque sensors of " + name;
+                case FT_SENSOR:
+                    return "F/T sensor port " + name;
+                case IMU:
+                    return "IMU port " + name;
+                default:
+                    return name;
+            }
+        }
+    };
+}
+
 // *********************************************************************************************************************
 // *********************************************************************************************************************
 //                                          YARP WHOLE BODY SENSORS
 // *********************************************************************************************************************
 // *********************************************************************************************************************
 yarpWholeBodySensors::yarpWholeBodySensors(const char* _name, const yarp::os::Property & opt):
-initDone(false), name(_name), wbi_yarp_properties(opt), sensorIdList(wbi::SENSOR_TYPE_SIZE)
+initDone(false), name(_name), wbi_yarp_properties(opt), sensorIdList(wbi::SENSOR_TYPE_SIZE), sensorsLog(0),
+lazyDeviceOpening(false), sensorTypeOpened(wbi::SENSOR_TYPE_SIZE,0)
+{
+}
+
+sensorsReadHealth::sensorsReadHealth()
 {
+    reset();
+}
+
+void sensorsReadHealth::reset()
+{
+    nrOfReads = 0;
+    nrOfFailedReads = 0;
+    nrOfTimeouts = 0;
+    readLatency.reset();
+    lastDataAge = -1.0;
+    maxDataAge = -1.0;
+}
+
+void sensorsReadHealth::addRead(const bool success, const double latency, const double dataAge)
+{
+    nrOfReads++;
+    readLatency.add(latency);
+    if( !success )
+    {
+        nrOfFailedReads++;
+        return;
+    }
+    lastDataAge = dataAge;
+    if( dataAge > maxDataAge )
+    {
+        maxDataAge = dataAge;
+    }
+}
+
+void sensorsReadHealth::addTimeout(const double latency)
+{
+    addRead(false,latency);
+    nrOfTimeouts++;
+}
+
+double sensorsReadHealth::getSuccessRate() const
+{
+    return nrOfReads > 0 ? ((double)(nrOfReads-nrOfFailedReads))/nrOfReads : 1.0;
 }
 
 bool yarpWholeBodySensors::setYarpWbiProperties(const yarp::os::Property & yarp_wbi_properties)
@@ -92,7 +210,7 @@ bool yarpWholeBodySensors::init()
         return false;
     }
 
-    yarp::os::Bottle & joints_config = getWBIYarpJointsOptions(wbi_yarp_properties);
+    configurationGroupIndex joints_config(getWBIYarpJointsOptions(wbi_yarp_properties));
     controlBoardNames.clear();
     initDone = appendNewControlBoardsToVector(joints_config,sensorIdList[wbi::SENSOR_ENCODER_POS],controlBoardNames);
     initDone = initDone && appendNewControlBoardsToVector(joints_config,sensorIdList[wbi::SENSOR_PWM],controlBoardNames);
@@ -115,6 +233,13 @@ bool yarpWholeBodySensors::init()
     pwmLastRead.resize(nrOfControlBoards);
     torqueSensorsLastRead.resize(nrOfControlBoards);
 
+    controlBoardsReadHealth.resize(nrOfControlBoards);
+    for(int ctrlBoard = 0; ctrlBoard < nrOfControlBoards; ctrlBoard++)
+    {
+        controlBoardsReadHealth[ctrlBoard].reset();
+        controlBoardsReadHealth[ctrlBoard].name = controlBoardNames[ctrlBoard];
+    }
+
     getControlBoardAxisList(joints_config,sensorIdList[wbi::SENSOR_ENCODER_POS],controlBoardNames,encoderControlBoardAxisList);
     getControlBoardAxisList(joints_config,sensorIdList[wbi::SENSOR_PWM],controlBoardNames,pwmControlBoardAxisList);
     getControlBoardAxisList(joints_config,sensorIdList[wbi::SENSOR_TORQUE],controlBoardNames,torqueControlBoardAxisList);
@@ -123,41 +248,6 @@ bool yarpWholeBodySensors::init()
     pwmControlBoardList     = getControlBoardList(pwmControlBoardAxisList);
     torqueControlBoardList  = getControlBoardList(torqueControlBoardAxisList);
 
-    for(int i=0; i < (int)encoderControlBoardList.size(); i++ )
-    {
-        int ctrlBoard = encoderControlBoardList[i];
-        initDone = initDone && openEncoder(ctrlBoard);
-    }
-    if( !initDone )
-    {
-        std::cerr << "[ERR] yarpWholeBodySensors::init() error: failing in opening encoders." << std::endl;
-        return false;
-    }
-
-    for(int i=0; i < (int)pwmControlBoardList.size(); i++ )
-    {
-        int ctrlBoard = pwmControlBoardList[i];
-        initDone = initDone && openPwm(ctrlBoard);
-    }
-
-    if( !initDone )
-    {
-        std::cerr << "[ERR] yarpWholeBodySensors::init() error: failing in opening motor pwm inputs." << std::endl;
-        return false;
-    }
-
-    for(int i=0; i < (int)torqueControlBoardList.size(); i++ )
-    {
-        int ctrlBoard = torqueControlBoardList[i];
-        initDone = initDone && openTorqueSensor(ctrlBoard);
-    }
-
-    if( !initDone )
-    {
-        std::cerr << "[ERR] yarpWholeBodySensors::init() error: failing in opening torques sensors." << std::endl;
-        return false;
-    }
-
     //Load accelerometers information: this is tricky
     //as depending on the accelerometer type we have to add some IMU to the system
     std::vector< AccelerometerConfigurationInfo > acc_infos;
@@ -187,44 +277,56 @@ bool yarpWholeBodySensors::init()
         return false;
     }
 
-    if( !initDone )
-    {
-        std::cerr << "[ERR] yarpWholeBodySensors::init() error: failing in opening force/torque sensors." << std::endl;
-        return false;
-    }
-
-
     //Resize all the data structure that depend on the number of fts
     int nrOfFtSensors = sensorIdList[wbi::SENSOR_FORCE_TORQUE].size();
     ftSensLastRead.resize(nrOfFtSensors);
     ftStampSensLastRead.resize(nrOfFtSensors);
     portsFTsens.resize(nrOfFtSensors);
+    ftPortsReadHealth.resize(nrOfFtSensors);
 
     int nrOfImuSensors = sensorIdList[wbi::SENSOR_IMU].size();
     imuLastRead.resize(nrOfImuSensors);
     imuStampLastRead.resize(nrOfImuSensors);
     portsIMU.resize(nrOfImuSensors);
+    imuPortsReadHealth.resize(nrOfImuSensors);
 
+    ftPortNames = ft_ports;
+    imuPortNames = imu_ports;
 
-    for(int ft_numeric_id = 0; ft_numeric_id < (int)sensorIdList[wbi::SENSOR_FORCE_TORQUE].size(); ft_numeric_id++)
-    {
-            initDone = initDone && openFTsens(ft_numeric_id,ft_ports[ft_numeric_id]);
-    }
+    lazyDeviceOpening = wbi_yarp_properties.check("lazyDeviceOpening")
+                        && wbi_yarp_properties.find("lazyDeviceOpening").asBool();
+    sensorTypeOpened.assign(wbi::SENSOR_TYPE_SIZE,0);
 
-    if( !initDone )
+    //Open the control boards and the ports of the F/T sensors and of the IMUs:
+    //each of them is independent from the others, so they can be opened in parallel
+    //(in lazy mode they are opened at the first read of each sensor type)
+    if( !lazyDeviceOpening )
     {
-        std::cerr << "[ERR] yarpWholeBodySensors::init() error: failing in opening force/torque sensors." << std::endl;
-        return false;
-    }
+        std::vector<parallelTask*> startupTasks;
+        for(int ctrlBoard = 0; ctrlBoard < nrOfControlBoards; ctrlBoard++)
+        {
+            startupTasks.push_back(new sensorsStartupTask(this,sensorsStartupTask::CONTROL_BOARD,ctrlBoard,controlBoardNames[ctrlBoard]));
+        }
+        for(int ft_numeric_id = 0; ft_numeric_id < nrOfFtSensors; ft_numeric_id++)
+        {
+            startupTasks.push_back(new sensorsStartupTask(this,sensorsStartupTask::FT_SENSOR,ft_numeric_id,ft_ports[ft_numeric_id]));
+        }
+        for(int imu_numeric_id = 0; imu_numeric_id < nrOfImuSensors; imu_numeric_id++)
+        {
+            startupTasks.push_back(new sensorsStartupTask(this,sensorsStartupTask::IMU,imu_numeric_id,imu_ports[imu_numeric_id]));
+        }
 
-    for(int imu_numeric_id = 0; imu_numeric_id < (int)sensorIdList[wbi::SENSOR_IMU].size(); imu_numeric_id++)
-    {
-            initDone = initDone && openImu(imu_numeric_id,imu_ports[imu_numeric_id]);
+        initDone = runStartupTasks("yarpWholeBodySensors",startupTasks,wbi_yarp_properties);
+
+        for(int task = 0; task < (int)startupTasks.size(); task++)
+        {
+            delete startupTasks[task];
+        }
     }
 
     if( !initDone )
     {
-        std::cerr << "[ERR] yarpWholeBodySensors::init() error: failing in opening imu sensors." << std::endl;
+        std::cerr << "[ERR] yarpWholeBodySensors::init() error: failing in opening the control boards and the sensor ports." << std::endl;
         return false;
     }
 
@@ -244,9 +346,57 @@ bool yarpWholeBodySensors::init()
         return false;
     }
 
+    initDone = openSensorsLog();
+
     return initDone;
 }
 
+bool yarpWholeBodySensors::openSensorsLog()
+{
+    yarp::os::Bottle & sensors_opt_bot = wbi_yarp_properties.findGroup("WBI_SENSORS_OPTIONS");
+    if( !sensors_opt_bot.check("sensorsLogFile") )
+    {
+        return true;
+    }
+
+    std::string logFile = sensors_opt_bot.find("sensorsLogFile").asString().c_str();
+    double logMaxSizeInMB = 512.0;
+    if( sensors_opt_bot.check("sensorsLogMaxSizeInMB") )
+    {
+        yarp::os::Value & logMaxSize = sensors_opt_bot.find("sensorsLogMaxSizeInMB");
+        if( !logMaxSize.isDouble() && !logMaxSize.isInt() )
+        {
+            yError("yarpWholeBodySensors: sensorsLogMaxSizeInMB should be a number");
+            return false;
+        }
+        logMaxSizeInMB = logMaxSize.asDouble();
+    }
+
+    // encoder speeds and accelerations are read for all the encoders
+    std::vector<wbi::IDList> loggedSensors = sensorIdList;
+    loggedSensors[wbi::SENSOR_ENCODER_SPEED] = sensorIdList[wbi::SENSOR_ENCODER_POS];
+    loggedSensors[wbi::SENSOR_ENCODER_ACCELERATION] = sensorIdList[wbi::SENSOR_ENCODER_POS];
+
+    size_t maxNrOfSensors = 0;
+    for(int st = 0; st < (int)loggedSensors.size(); st++)
+    {
+        maxNrOfSensors = std::max(maxNrOfSensors,(size_t)loggedSensors[st].size());
+    }
+    sensorsLogStamps.resize(maxNrOfSensors+1);
+
+    sensorsLog = new yarpWholeBodySensorsLogWriter();
+    if( !sensorsLog->open(logFile,(size_t)(logMaxSizeInMB*1024*1024),loggedSensors) )
+    {
+        yError() << "yarpWholeBodySensors: impossible to open sensors log file " << logFile;
+        delete sensorsLog;
+        sensorsLog = 0;
+        return false;
+    }
+
+    yInfo() << "yarpWholeBodySensors: recording sensor readings in " << logFile;
+    return true;
+}
+
 bool yarpWholeBodySensors::close()
 {
     bool ok = true;
@@ -255,9 +405,7 @@ bool yarpWholeBodySensors::close()
         int ctrlBoard = encoderControlBoardList[i];
         if(dd[ctrlBoard])
         {
-            ok = ok && dd[ctrlBoard]->close();
-            delete dd[ctrlBoard];
-            dd[ctrlBoard] = 0;
+            ok = closeControlBoardDriver(dd[ctrlBoard]) && ok;
         }
     }
 
@@ -266,9 +414,7 @@ bool yarpWholeBodySensors::close()
         int ctrlBoard = pwmControlBoardList[i];
         if(dd[ctrlBoard])
         {
-            ok = ok && dd[ctrlBoard]->close();
-            delete dd[ctrlBoard];
-            dd[ctrlBoard] = 0;
+            ok = closeControlBoardDriver(dd[ctrlBoard]) && ok;
         }
     }
 
@@ -277,9 +423,7 @@ bool yarpWholeBodySensors::close()
         int ctrlBoard = torqueControlBoardList[i];
         if(dd[ctrlBoard])
         {
-            ok = ok && dd[ctrlBoard]->close();
-            delete dd[ctrlBoard];
-            dd[ctrlBoard] = 0;
+            ok = closeControlBoardDriver(dd[ctrlBoard]) && ok;
         }
     }
 
@@ -301,6 +445,15 @@ bool yarpWholeBodySensors::close()
         }
     }
 
+    if( sensorsLog )
+    {
+        ok = sensorsLog->close() && ok;
+        delete sensorsLog;
+        sensorsLog = 0;
+    }
+
+    snapshotHistories.clear();
+
     return ok;
 }
 
@@ -369,48 +522,319 @@ int yarpWholeBodySensors::getSensorNumber(const SensorType st)
 
 bool yarpWholeBodySensors::readSensor(const SensorType st, const int sid, double *data, double *stamps, bool blocking)
 {
+    if( st < 0 || st >= wbi::SENSOR_TYPE_SIZE || !ensureSensorsOpen(st) )
+    {
+        return false;
+    }
+
+    // when recording, the stamp is always read (pwm do not support stamps)
+    double * readStamps = stamps;
+    if( sensorsLog && stamps == 0 && st != SENSOR_PWM )
+    {
+        readStamps = &(sensorsLogStamps[0]);
+    }
+
+    bool ret = false;
     switch(st)
     {
-    case SENSOR_ENCODER_POS:           return readEncoder(ENCODER_POS, sid, data, stamps, blocking);
-    case SENSOR_ENCODER_SPEED:         return readEncoder(ENCODER_SPEED, sid, data, stamps, blocking);
-    case SENSOR_ENCODER_ACCELERATION:  return readEncoder(ENCODER_ACCELERATION, sid, data, stamps, blocking);
-    case SENSOR_PWM:            return readPwm(sid, data, stamps, blocking);
-    case SENSOR_IMU:            return readIMU(sid, data, stamps, blocking);
-    case SENSOR_FORCE_TORQUE:   return readFTsensor(sid, data, stamps, blocking);
-    case SENSOR_TORQUE:         return readTorqueSensor(sid, data, stamps, blocking);
-    case SENSOR_ACCELEROMETER:  return readAccelerometer(sid, data, stamps, blocking);
+    case SENSOR_ENCODER_POS:           ret = readEncoder(ENCODER_POS, sid, data, readStamps, blocking); break;
+    case SENSOR_ENCODER_SPEED:         ret = readEncoder(ENCODER_SPEED, sid, data, readStamps, blocking); break;
+    case SENSOR_ENCODER_ACCELERATION:  ret = readEncoder(ENCODER_ACCELERATION, sid, data, readStamps, blocking); break;
+    case SENSOR_PWM:            ret = readPwm(sid, data, readStamps, blocking); break;
+    case SENSOR_IMU:            ret = readIMU(sid, data, readStamps, blocking); break;
+    case SENSOR_FORCE_TORQUE:   ret = readFTsensor(sid, data, readStamps, blocking); break;
+    case SENSOR_TORQUE:         ret = readTorqueSensor(sid, data, readStamps, blocking); break;
+    case SENSOR_ACCELEROMETER:  ret = readAccelerometer(sid, data, readStamps, blocking); break;
     default: break;
     }
-    return false;
+
+    if( ret && sensorsLog )
+    {
+        sensorsLog->logSensorRecord(st, sid, yarp::os::Time::now(), data, readStamps);
+    }
+
+    return ret;
 }
 
 bool yarpWholeBodySensors::readSensors(const SensorType st, double *data, double *stamps, bool blocking)
 {
+    if( st < 0 || st >= wbi::SENSOR_TYPE_SIZE || !ensureSensorsOpen(st) )
+    {
+        return false;
+    }
+
+    // when recording, the stamps are always read (pwm do not support stamps)
+    double * readStamps = stamps;
+    if( sensorsLog && stamps == 0 && st != SENSOR_PWM )
+    {
+        readStamps = &(sensorsLogStamps[0]);
+    }
+
+    bool ret = false;
     switch(st)
     {
-    case SENSOR_ENCODER_POS:           return readEncoders(ENCODER_POS, data, stamps, blocking);
-    case SENSOR_ENCODER_SPEED:         return readEncoders(ENCODER_SPEED, data, stamps, blocking);
-    case SENSOR_ENCODER_ACCELERATION:  return readEncoders(ENCODER_ACCELERATION, data, stamps, blocking);
-    case SENSOR_PWM:            return readPwms(data, stamps, blocking);
-    case SENSOR_IMU:            return readIMUs(data, stamps, blocking);
-    case SENSOR_FORCE_TORQUE:   return readFTsensors(data, stamps, blocking);
-    case SENSOR_TORQUE:         return readTorqueSensors(data, stamps, blocking);
-    case SENSOR_ACCELEROMETER:  return readAccelerometers(data, stamps, blocking);
+    case SENSOR_ENCODER_POS:           ret = readEncoders(ENCODER_POS, data, readStamps, blocking); break;
+    case SENSOR_ENCODER_SPEED:         ret = readEncoders(ENCODER_SPEED, data, readStamps, blocking); break;
+    case SENSOR_ENCODER_ACCELERATION:  ret = readEncoders(ENCODER_ACCELERATION, data, readStamps, blocking); break;
+    case SENSOR_PWM:            ret = readPwms(data, readStamps, blocking); break;
+    case SENSOR_IMU:            ret = readIMUs(data, readStamps, blocking); break;
+    case SENSOR_FORCE_TORQUE:   ret = readFTsensors(data, readStamps, blocking); break;
+    case SENSOR_TORQUE:         ret = readTorqueSensors(data, readStamps, blocking); break;
+    case SENSOR_ACCELEROMETER:  ret = readAccelerometers(data, readStamps, blocking); break;
     default: break;
     }
-    return false;
+
+    if( ret && sensorsLog )
+    {
+        sensorsLog->logRecord(st, yarp::os::Time::now(), data, readStamps);
+    }
+
+    return ret;
+}
+
+void yarpWholeBodySensors::recordRead(sensorsReadHealth & health, const bool success,
+                                      const double latency, const double dataAge)
+{
+    LockGuard guard(readHealthMutex);
+    health.addRead(success,latency,dataAge);
+}
+
+void yarpWholeBodySensors::recordTimeout(sensorsReadHealth & health, const double latency)
+{
+    LockGuard guard(readHealthMutex);
+    health.addTimeout(latency);
+}
+
+const sensorsReadHealth * yarpWholeBodySensors::findReadHealth(const std::string & name) const
+{
+    const std::vector<sensorsReadHealth> * allHealth[3] = { &controlBoardsReadHealth, &ftPortsReadHealth, &imuPortsReadHealth };
+    for(int v = 0; v < 3; v++)
+    {
+        for(int i = 0; i < (int)allHealth[v]->size(); i++)
+        {
+            if( (*allHealth[v])[i].name == name )
+            {
+                return &((*allHealth[v])[i]);
+            }
+        }
+    }
+    return 0;
+}
+
+std::vector<sensorsReadHealth> yarpWholeBodySensors::getReadHealth() const
+{
+    LockGuard guard(readHealthMutex);
+    std::vector<sensorsReadHealth> health(controlBoardsReadHealth);
+    health.insert(health.end(),ftPortsReadHealth.begin(),ftPortsReadHealth.end());
+    health.insert(health.end(),imuPortsReadHealth.begin(),imuPortsReadHealth.end());
+    return health;
+}
+
+bool yarpWholeBodySensors::getReadHealth(const std::string & name, sensorsReadHealth & health) const
+{
+    LockGuard guard(readHealthMutex);
+    const sensorsReadHealth * found = findReadHealth(name);
+    if( !found )
+    {
+        return false;
+    }
+    health = *found;
+    return true;
+}
+
+void yarpWholeBodySensors::resetReadHealth()
+{
+    LockGuard guard(readHealthMutex);
+    for(int i = 0; i < (int)controlBoardsReadHealth.size(); i++) controlBoardsReadHealth[i].reset();
+    for(int i = 0; i < (int)ftPortsReadHealth.size(); i++) ftPortsReadHealth[i].reset();
+    for(int i = 0; i < (int)imuPortsReadHealth.size(); i++) imuPortsReadHealth[i].reset();
+}
+
+bool yarpWholeBodySensors::readSensorsSnapshot(wholeBodySensorsSnapshot & snapshot,
+                                               SnapshotAlignment alignment, bool blocking)
+{
+    return readAlignedSensors(snapshot,false,0.0,alignment,blocking);
+}
+
+bool yarpWholeBodySensors::readSensorsSnapshotAt(wholeBodySensorsSnapshot & snapshot, const double referenceTime,
+                                                 SnapshotAlignment alignment, bool blocking)
+{
+    return readAlignedSensors(snapshot,true,referenceTime,alignment,blocking);
 }
 
 /********************************************************************************************************************************************/
 /**************************************************** PRIVATE METHODS ***********************************************************************/
 /********************************************************************************************************************************************/
 
+bool yarpWholeBodySensors::openControlBoardSensors(const int bp)
+{
+    bool ok = true;
+    if( std::find(encoderControlBoardList.begin(),encoderControlBoardList.end(),bp) == encoderControlBoardList.end() )
+    {
+        // the buffers of the pwm and torque sensors need the number of axes, otherwise read by openEncoder
+        ok = readControlBoardAxes(bp);
+    }
+    else
+    {
+        ok = ok && openEncoder(bp);
+    }
+    if( std::find(pwmControlBoardList.begin(),pwmControlBoardList.end(),bp) != pwmControlBoardList.end() )
+    {
+        ok = ok && openPwm(bp);
+    }
+    if( std::find(torqueControlBoardList.begin(),torqueControlBoardList.end(),bp) != torqueControlBoardList.end() )
+    {
+        ok = ok && openTorqueSensor(bp);
+    }
+    return ok;
+}
+
+bool yarpWholeBodySensors::readControlBoardAxes(const int bp)
+{
+    if( controlBoardAxes[bp] > 0 )
+    {
+        return true;
+    }
+
+    if(dd[bp]==0 && !openControlBoardDriver(name, robot, dd[bp], controlBoardNames[bp], wbi_yarp_properties))
+    {
+        return false;
+    }
+
+    IEncoders * encs = 0;
+    int nj = 0;
+    if( !dd[bp]->view(encs) || !encs->getAxes(&nj) )
+    {
+        fprintf(stderr, "Problem reading the number of axes of %s\n", controlBoardNames[bp].c_str());
+        return false;
+    }
+    controlBoardAxes[bp] = nj;
+    return true;
+}
+
+bool yarpWholeBodySensors::ensureSensorsOpen(const SensorType st)
+{
+    if( !lazyDeviceOpening )
+    {
+        return true;
+    }
+
+    // the flags of the types already opened are published with a memory barrier (see openSensorsOfType),
+    // so their reads do not wait for lazyOpeningMutex while another thread opens the devices of another type
+    if( *((volatile const char *)&(sensorTypeOpened[st])) )
+    {
+        memoryBarrier();
+        return true;
+    }
+    return openSensorsOfType(st);
+}
+
+bool yarpWholeBodySensors::warmUp()
+{
+    if( !initDone ) return false;
+
+    bool ok = true;
+    for(int st = 0; st < wbi::SENSOR_TYPE_SIZE; st++)
+    {
+        if( sensorIdList[st].size() > 0 )
+        {
+            ok = ensureSensorsOpen((SensorType)st) && ok;
+        }
+    }
+    return ok;
+}
+
+bool yarpWholeBodySensors::openSensorsOfType(const SensorType st)
+{
+    yarp::os::LockGuard guard(lazyOpeningMutex);
+    if( sensorTypeOpened[st] )
+    {
+        return true;
+    }
+
+    // the accelerometers are read from the IMUs
+    SensorType typeToOpen = (st == SENSOR_ACCELEROMETER) ? SENSOR_IMU : st;
+    if( sensorTypeOpened[typeToOpen] )
+    {
+        memoryBarrier();
+        sensorTypeOpened[st] = 1;
+        return true;
+    }
+
+    std::vector<parallelTask*> tasks;
+    switch( typeToOpen )
+    {
+        case SENSOR_ENCODER_POS:
+        case SENSOR_ENCODER_SPEED:
+        case SENSOR_ENCODER_ACCELERATION:
+            for(int i=0; i < (int)encoderControlBoardList.size(); i++ )
+            {
+                int bp = encoderControlBoardList[i];
+                tasks.push_back(new sensorsStartupTask(this,sensorsStartupTask::ENCODER,bp,controlBoardNames[bp]));
+            }
+            break;
+        case SENSOR_PWM:
+            for(int i=0; i < (int)pwmControlBoardList.size(); i++ )
+            {
+                int bp = pwmControlBoardList[i];
+                tasks.push_back(new sensorsStartupTask(this,sensorsStartupTask::PWM,bp,controlBoardNames[bp]));
+            }
+            break;
+        case SENSOR_TORQUE:
+            for(int i=0; i < (int)torqueControlBoardList.size(); i++ )
+            {
+                int bp = torqueControlBoardList[i];
+                tasks.push_back(new sensorsStartupTask(this,sensorsStartupTask::TORQUE_SENSOR,bp,controlBoardNames[bp]));
+            }
+            break;
+        case SENSOR_FORCE_TORQUE:
+            for(int i=0; i < (int)ftPortNames.size(); i++ )
+            {
+                tasks.push_back(new sensorsStartupTask(this,sensorsStartupTask::FT_SENSOR,i,ftPortNames[i]));
+            }
+            break;
+        case SENSOR_IMU:
+            for(int i=0; i < (int)imuPortNames.size(); i++ )
+            {
+                tasks.push_back(new sensorsStartupTask(this,sensorsStartupTask::IMU,i,imuPortNames[i]));
+            }
+            break;
+        default:
+            return false;
+    }
+
+    bool ok = runStartupTasks("yarpWholeBodySensors",tasks,wbi_yarp_properties);
+
+    for(int task = 0; task < (int)tasks.size(); task++)
+    {
+        delete tasks[task];
+    }
+
+    if( !ok )
+    {
+        std::cerr << "[ERR] yarpWholeBodySensors: failing in opening the devices of the sensors of type " << st << std::endl;
+        return false;
+    }
+
+    // the opened devices should be visible to the other threads before the flags
+    memoryBarrier();
+
+    // the encoders are read with the same interface for positions, speeds and accelerations
+    if( typeToOpen == SENSOR_ENCODER_POS || typeToOpen == SENSOR_ENCODER_SPEED || typeToOpen == SENSOR_ENCODER_ACCELERATION )
+    {
+        sensorTypeOpened[SENSOR_ENCODER_POS] = sensorTypeOpened[SENSOR_ENCODER_SPEED] = sensorTypeOpened[SENSOR_ENCODER_ACCELERATION] = 1;
+    }
+    sensorTypeOpened[typeToOpen] = 1;
+    sensorTypeOpened[st] = 1;
+    return true;
+}
+
 bool yarpWholeBodySensors::openEncoder(const int bp)
 {
     // check whether the encoder interface is already open
     if(ienc[bp]!=0) return true;
     // check whether the poly driver is already open (here I assume the elements of dd are initialized to 0)
-    if(dd[bp]==0 && !openPolyDriver(name, robot, dd[bp], controlBoardNames[bp])) return false;
+    if(dd[bp]==0 && !openControlBoardDriver(name, robot, dd[bp], controlBoardNames[bp], wbi_yarp_properties)) return false;
     // open the encoder interface
     if(!dd[bp]->view(ienc[bp]))
     {
@@ -437,7 +861,7 @@ bool yarpWholeBodySensors::openPwm(const int bp)
     if(iopl[bp]!=0)             return true;
 
     ///< if necessary open the poly driver
-    if(dd[bp]==0 && !openPolyDriver(name, robot, dd[bp], controlBoardNames[bp]))
+    if(dd[bp]==0 && !openControlBoardDriver(name, robot, dd[bp], controlBoardNames[bp], wbi_yarp_properties))
     {
         return false;
     }
@@ -560,6 +984,11 @@ bool yarpWholeBodySensors::openImu(const int numeric_id, const std::string & por
         return false;
     }
 
+    readHealthMutex.lock();
+    imuPortsReadHealth[numeric_id].reset();
+    imuPortsReadHealth[numeric_id].name = remotePort;
+    readHealthMutex.unlock();
+
     //allocate lastRead variables
     imuLastRead[numeric_id].resize(sensorTypeDescriptions[SENSOR_IMU].dataSize,0.0);
     imuStampLastRead[numeric_id] = INITIAL_TIMESTAMP;
@@ -589,6 +1018,11 @@ bool yarpWholeBodySensors::openFTsens(const int ft_sens_numeric_id, const std::s
         return false;
     }
 
+    readHealthMutex.lock();
+    ftPortsReadHealth[ft_sens_numeric_id].reset();
+    ftPortsReadHealth[ft_sens_numeric_id].name = remotePort;
+    readHealthMutex.unlock();
+
     //allocate lastRead variables
     ftSensLastRead[ft_sens_numeric_id].resize(sensorTypeDescriptions[SENSOR_FORCE_TORQUE].dataSize,0.0);
     ftStampSensLastRead[ft_sens_numeric_id] = INITIAL_TIMESTAMP;
@@ -603,7 +1037,7 @@ bool yarpWholeBodySensors::openTorqueSensor(const int bp)
         return true;
 
     ///< if necessary open the poly driver
-    if(dd[bp]==0 && !openPolyDriver(name, robot, dd[bp], controlBoardNames[bp]))
+    if(dd[bp]==0 && !openControlBoardDriver(name, robot, dd[bp], controlBoardNames[bp], wbi_yarp_properties))
         return false;
 
     if(!dd[bp]->view(itrq[bp]))
@@ -623,6 +1057,172 @@ bool yarpWholeBodySensors::openTorqueSensor(const int bp)
 
 /**************************** READ ************************/
 
+int yarpWholeBodySensors::getNrOfReadSensors(const SensorType st)
+{
+    // speeds and accelerations are read for all the encoders
+    if( st == SENSOR_ENCODER_SPEED || st == SENSOR_ENCODER_ACCELERATION )
+    {
+        return sensorIdList[st].size() > 0 ? sensorIdList[SENSOR_ENCODER_POS].size() : 0;
+    }
+    return sensorIdList[st].size();
+}
+
+bool yarpWholeBodySensors::allocateSnapshotHistories()
+{
+    int historyLength = 10;
+    yarp::os::Bottle & sensors_opt_bot = wbi_yarp_properties.findGroup("WBI_SENSORS_OPTIONS");
+    if( sensors_opt_bot.check("snapshotHistoryLength") )
+    {
+        historyLength = sensors_opt_bot.find("snapshotHistoryLength").asInt();
+        if( historyLength < 1 )
+        {
+            yError("yarpWholeBodySensors: snapshotHistoryLength should be positive");
+            return false;
+        }
+    }
+
+    snapshotHistories.resize(wbi::SENSOR_TYPE_SIZE);
+    snapshotReadings.resize(wbi::SENSOR_TYPE_SIZE);
+    snapshotReadingsStamps.resize(wbi::SENSOR_TYPE_SIZE);
+    for(int st = 0; st < wbi::SENSOR_TYPE_SIZE; st++)
+    {
+        int nrOfSensors = getNrOfReadSensors((SensorType)st);
+        int dataSize = sensorTypeDescriptions[st].dataSize;
+        snapshotHistories[st].resize(nrOfSensors);
+        for(int i = 0; i < nrOfSensors; i++)
+        {
+            snapshotHistories[st][i].resize(dataSize,historyLength);
+        }
+        // one additional element, so that the buffers are never empty
+        snapshotReadings[st].resize(nrOfSensors*dataSize+1);
+        snapshotReadingsStamps[st].resize(nrOfSensors+1);
+    }
+    return true;
+}
+
+bool yarpWholeBodySensors::readSensorsForSnapshot(const SensorType st, bool blocking)
+{
+    int nrOfSensors = getNrOfReadSensors(st);
+    int dataSize = sensorTypeDescriptions[st].dataSize;
+    double * data = &(snapshotReadings[st][0]);
+    double * stamps = &(snapshotReadingsStamps[st][0]);
+
+    bool ret = true;
+    if( st == SENSOR_IMU )
+    {
+        // IMUs can be read only one at the time
+        for(int i = 0; i < nrOfSensors; i++)
+        {
+            ret = readSensor(st,i,data+i*dataSize,stamps+i,blocking) && ret;
+        }
+    }
+    else if( st == SENSOR_PWM )
+    {
+        // pwm do not support stamps, so they are stamped with the time of the reading
+        ret = readSensors(st,data,0,blocking);
+        double now = yarp::os::Time::now();
+        for(int i = 0; i < nrOfSensors; i++)
+        {
+            stamps[i] = now;
+        }
+    }
+    else
+    {
+        ret = readSensors(st,data,stamps,blocking);
+    }
+
+    if( !ret )
+    {
+        return false;
+    }
+
+    for(int i = 0; i < nrOfSensors; i++)
+    {
+        // sensors never read have INITIAL_TIMESTAMP as stamp
+        if( stamps[i] > INITIAL_TIMESTAMP )
+        {
+            snapshotHistories[st][i].push(data+i*dataSize,stamps[i]);
+        }
+    }
+    return true;
+}
+
+bool yarpWholeBodySensors::readAlignedSensors(wholeBodySensorsSnapshot & snapshot, const bool useReferenceTime, double referenceTime,
+                                              SnapshotAlignment alignment, bool blocking)
+{
+    if( !initDone )
+    {
+        return false;
+    }
+
+    if( snapshotHistories.size() == 0 && !allocateSnapshotHistories() )
+    {
+        return false;
+    }
+
+    // accelerometers are obtained from the last reading of the IMUs, so they are read last
+    bool ret = true;
+    for(int st = 0; st < wbi::SENSOR_TYPE_SIZE; st++)
+    {
+        if( st != SENSOR_ACCELEROMETER && getNrOfReadSensors((SensorType)st) > 0 )
+        {
+            ret = readSensorsForSnapshot((SensorType)st,blocking) && ret;
+        }
+    }
+    if( getNrOfReadSensors(SENSOR_ACCELEROMETER) > 0 )
+    {
+        ret = readSensorsForSnapshot(SENSOR_ACCELEROMETER,blocking) && ret;
+    }
+
+    if( !useReferenceTime )
+    {
+        // the oldest of the newest readings, so that all the readings can be interpolated
+        bool found = false;
+        for(int st = 0; st < (int)snapshotHistories.size(); st++)
+        {
+            for(int i = 0; i < (int)snapshotHistories[st].size(); i++)
+            {
+                if( snapshotHistories[st][i].size() > 0
+                    && (!found || snapshotHistories[st][i].getNewestStamp() < referenceTime) )
+                {
+                    referenceTime = snapshotHistories[st][i].getNewestStamp();
+                    found = true;
+                }
+            }
+        }
+        if( !found )
+        {
+            referenceTime = yarp::os::Time::now();
+        }
+    }
+
+    snapshot.referenceTime = referenceTime;
+    snapshot.data.resize(wbi::SENSOR_TYPE_SIZE);
+    snapshot.stamps.resize(wbi::SENSOR_TYPE_SIZE);
+    for(int st = 0; st < wbi::SENSOR_TYPE_SIZE; st++)
+    {
+        int nrOfSensors = getNrOfReadSensors((SensorType)st);
+        int dataSize = sensorTypeDescriptions[st].dataSize;
+        // the orientation of the IMUs (in axis-angle) is interpolated with a slerp
+        bool axisAngleOrientation = (st == SENSOR_IMU);
+        snapshot.data[st].resize(nrOfSensors*dataSize);
+        snapshot.stamps[st].resize(nrOfSensors);
+        for(int i = 0; i < nrOfSensors; i++)
+        {
+            if( !snapshotHistories[st][i].getReadingAt(referenceTime, alignment == SNAPSHOT_LINEAR,
+                                                       &(snapshot.data[st][i*dataSize]), &(snapshot.stamps[st][i]),
+                                                       axisAngleOrientation) )
+            {
+                // no valid reading yet, return the last one
+                memcpy(&(snapshot.data[st][i*dataSize]),&(snapshotReadings[st][i*dataSize]),dataSize*sizeof(double));
+                snapshot.stamps[st][i] = snapshotReadingsStamps[st][i];
+            }
+        }
+    }
+
+    return ret;
+}
+
 bool yarpWholeBodySensors::getEncodersPosSpeedAccTimed(const EncoderType st, yarp::dev::IEncodersTimed* ienc, double *encs, double *time)
 {
     bool result = ienc->getEncodersTimed(encs, time);
@@ -650,6 +1250,7 @@ bool yarpWholeBodySensors::readEncoders(const EncoderType st, double *data, doub
         dataTemp[0] = -10.0;
         dataTemp[1] = -10.0;
         double waiting_time = 0;
+        double read_start = Time::now();
         while( !(update=getEncodersPosSpeedAccTimed(st, ienc[*ctrlBoard], dataTemp, tTemp)) && wait)
         {
             //std::cout << "waitign " << dataTemp[0] << " " << dataTemp[1] << std::endl;
@@ -658,10 +1259,13 @@ bool yarpWholeBodySensors::readEncoders(const EncoderType st, double *data, doub
 
             if( waiting_time > BLOCKING_SENSOR_TIMEOUT )
             {
+                recordTimeout(controlBoardsReadHealth[*ctrlBoard], Time::now()-read_start);
                 yError("yarpWholeBodySensors::readEncoders failed for timeout");
                 return false;
             }
         }
+        double read_end = Time::now();
+        recordRead(controlBoardsReadHealth[*ctrlBoard], update, read_end-read_start, read_end-tTemp[0]);
 
         // if reading has succeeded, update last read data
         if(update)
@@ -709,6 +1313,7 @@ bool yarpWholeBodySensors::readPwms(double *pwm, double *stamps, bool wait)
     {
         // read data
         double waiting_time = 0;
+        double read_start = Time::now();
         while( !(update=iopl[*ctrlBoard]->getOutputs(pwmTemp)) && wait)
         {
             Time::delay(WAIT_TIME);
@@ -717,10 +1322,12 @@ bool yarpWholeBodySensors::readPwms(double *pwm, double *stamps, bool wait)
 
             if( waiting_time > BLOCKING_SENSOR_TIMEOUT )
             {
+                recordTimeout(controlBoardsReadHealth[*ctrlBoard], Time::now()-read_start);
                 yError("yarpWholeBodySensors::readPwms failed for timeout");
                 return false;
             }
         }
+        recordRead(controlBoardsReadHealth[*ctrlBoard], update, Time::now()-read_start);
 
         // if reading has succeeded, update last read data
         if(update)
@@ -750,32 +1357,21 @@ bool yarpWholeBodySensors::readAccelerometers(double *accs, double *stamps, bool
     bool ret = true;
     for(int i=0; i < (int)sensorIdList[SENSOR_ACCELEROMETER].size(); i++)
     {
-        ret = ret && this->readAccelerometer(i,accs+(sensorTypeDescriptions[SENSOR_ACCELEROMETER].dataSize)*i,stamps+i,wait);
+        ret = ret && this->readAccelerometer(i,accs+(sensorTypeDescriptions[SENSOR_ACCELEROMETER].dataSize)*i,
+                                             (stamps != 0) ? stamps+i : 0,wait);
     }
     return ret;
 }
 
 bool yarpWholeBodySensors::readIMUs(double *inertial, double *stamps, bool wait)
 {
-    assert(false);
-    return false;
-    Vector *v;
+    bool ret = true;
     for(int i=0; i < (int)sensorIdList[SENSOR_IMU].size(); i++)
     {
-        v = portsIMU[i]->read(wait);
-        if(v!=0)
-        {
-            yarp::os::Stamp info;
-            imuLastRead[i] = *v;
-            portsIMU[i]->getEnvelope(info);
-            imuStampLastRead[i] = info.getTime();
-        }
-        convertIMU(&inertial[sensorTypeDescriptions[SENSOR_IMU].dataSize*i],imuLastRead[i].data());
-        if( stamps != 0 ) {
-            stamps[i] = imuStampLastRead[i];
-        }
+        ret = this->readIMU(i,inertial+(sensorTypeDescriptions[SENSOR_IMU].dataSize)*i,
+                            (stamps != 0) ? stamps+i : 0,wait) && ret;
     }
-    return true;
+    return ret;
 }
 
 bool yarpWholeBodySensors::readFTsensors(double *ftSens, double *stamps, bool wait)
@@ -783,6 +1379,7 @@ bool yarpWholeBodySensors::readFTsensors(double *ftSens, double *stamps, bool wa
     Vector *v;
     for(int i=0; i < (int)sensorIdList[SENSOR_FORCE_TORQUE].size(); i++)
     {
+        double read_start = Time::now();
         v = portsFTsens[i]->read(wait);
         if(v!=0)
         {
@@ -791,6 +1388,8 @@ bool yarpWholeBodySensors::readFTsensors(double *ftSens, double *stamps, bool wa
             portsFTsens[i]->getEnvelope(info);
             ftStampSensLastRead[i] = info.getTime();
         }
+        double read_end = Time::now();
+        recordRead(ftPortsReadHealth[i], v!=0, read_end-read_start, read_end-ftStampSensLastRead[i]);
         memcpy(&ftSens[i*6], ftSensLastRead[i].data(), 6*sizeof(double));
         if( stamps != 0 ) {
                 stamps[i] = ftStampSensLastRead[i];
@@ -811,6 +1410,7 @@ bool yarpWholeBodySensors::readTorqueSensors(double *jointSens, double *stamps,
     {
         // read data
         double waiting_time = 0;
+        double read_start = Time::now();
         while( !(update=itrq[*ctrlBoard]->getTorques(torqueSensorsLastRead[*ctrlBoard].data())) && wait)
         {
             Time::delay(WAIT_TIME);
@@ -819,10 +1419,12 @@ bool yarpWholeBodySensors::readTorqueSensors(double *jointSens, double *stamps,
 
             if( waiting_time > BLOCKING_SENSOR_TIMEOUT )
             {
+                recordTimeout(controlBoardsReadHealth[*ctrlBoard], Time::now()-read_start);
                 yError("yarpWholeBodySensors::readTorqueSensors failed for timeout");
                 return false;
             }
         }
+        recordRead(controlBoardsReadHealth[*ctrlBoard], update, Time::now()-read_start);
 
         res = res && update;
     }
@@ -857,6 +1459,7 @@ bool yarpWholeBodySensors::readEncoder(const EncoderType st, const int encoder_n
 
     // read encoders
     double waiting_time = 0;
+    double read_start = Time::now();
     while( !(update=getEncodersPosSpeedAccTimed(st, ienc[encoderCtrlBoard], dataTemp, tTemp)) && wait)
     {
         Time::delay(WAIT_TIME);
@@ -865,10 +1468,13 @@ bool yarpWholeBodySensors::readEncoder(const EncoderType st, const int encoder_n
 
         if( waiting_time > BLOCKING_SENSOR_TIMEOUT )
         {
+            recordTimeout(controlBoardsReadHealth[encoderCtrlBoard], Time::now()-read_start);
             yError("yarpWholeBodySensors::readEncoder failed for timeout");
             return false;
         }
     }
+    double read_end = Time::now();
+    recordRead(controlBoardsReadHealth[encoderCtrlBoard], update, read_end-read_start, read_end-tTemp[encoderCtrlBoardAxis]);
 
     if( update )
     {
@@ -901,6 +1507,7 @@ bool yarpWholeBodySensors::readPwm(const int pwm_numeric_id, double *pwm, double
 
     // read pwm sensors
     double waiting_time = 0.0;
+    double read_start = Time::now();
     while( !(update=iopl[pwmCtrlBoard]->getOutputs(pwmLastRead[pwmCtrlBoard].data())) && wait)
     {
         Time::delay(WAIT_TIME);
@@ -909,10 +1516,12 @@ bool yarpWholeBodySensors::readPwm(const int pwm_numeric_id, double *pwm, double
 
         if( waiting_time > BLOCKING_SENSOR_TIMEOUT )
         {
+            recordTimeout(controlBoardsReadHealth[pwmCtrlBoard], Time::now()-read_start);
             yError("yarpWholeBodySensors::readPwm failed for timeout");
             return false;
         }
     }
+    recordRead(controlBoardsReadHealth[pwmCtrlBoard], update, Time::now()-read_start);
 
     // copy most recent data into output variables
     pwm[0] = pwmLastRead[pwmCtrlBoard][pwmCtrlBoardAxis];
@@ -973,6 +1582,7 @@ bool yarpWholeBodySensors::readIMU(const int imu_sensor_numeric_id, double *iner
     }
     #endif
 
+    double read_start = Time::now();
     Vector *v = portsIMU[imu_sensor_numeric_id]->read(wait);
     if(v!=0) {
         yarp::os::Stamp info;
@@ -980,6 +1590,9 @@ bool yarpWholeBodySensors::readIMU(const int imu_sensor_numeric_id, double *iner
         portsIMU[imu_sensor_numeric_id]->getEnvelope(info);
         imuStampLastRead[imu_sensor_numeric_id] = info.getTime();
     }
+    double read_end = Time::now();
+    recordRead(imuPortsReadHealth[imu_sensor_numeric_id], v!=0, read_end-read_start,
+               read_end-imuStampLastRead[imu_sensor_numeric_id]);
     if( stamps != 0 ) {
         *stamps = imuStampLastRead[imu_sensor_numeric_id];
     }
@@ -998,6 +1611,7 @@ bool yarpWholeBodySensors::readFTsensor(const int ft_sensor_numeric_id, double *
         return false;
     }
 
+    double read_start = Time::now();
     Vector *v = portsFTsens[ft_sensor_numeric_id]->read(wait);
     if(v!=NULL) {
         ftSensLastRead[ft_sensor_numeric_id] = *v;
@@ -1005,6 +1619,9 @@ bool yarpWholeBodySensors::readFTsensor(const int ft_sensor_numeric_id, double *
         portsFTsens[ft_sensor_numeric_id]->getEnvelope(info);
         ftStampSensLastRead[ft_sensor_numeric_id] = info.getTime();
     }
+    double read_end = Time::now();
+    recordRead(ftPortsReadHealth[ft_sensor_numeric_id], v!=NULL, read_end-read_start,
+               read_end-ftStampSensLastRead[ft_sensor_numeric_id]);
     memcpy(&ftSens[0], ftSensLastRead[ft_sensor_numeric_id].data(), 6*sizeof(double));
     if( stamps != 0 ) {
         *stamps = ftStampSensLastRead[ft_sensor_numeric_id];
@@ -1025,6 +1642,7 @@ bool yarpWholeBodySensors::readTorqueSensor(const int numeric_torque_id, double
 
     // read joint torque
     double waiting_time = 0.0;
+    double read_start = Time::now();
     while(!(update = itrq[torqueCtrlBoard]->getTorque(torqueCtrlBoardAxis, &torqueTemp)) && wait)
     {
         Time::delay(WAIT_TIME);
@@ -1033,10 +1651,12 @@ bool yarpWholeBodySensors::readTorqueSensor(const int numeric_torque_id, double
 
         if( waiting_time > BLOCKING_SENSOR_TIMEOUT )
         {
+            recordTimeout(controlBoardsReadHealth[torqueCtrlBoard], Time::now()-read_start);
             yError("yarpWholeBodySensors::readTorqueSensor failed for timeout");
             return false;
         }
     }
+    recordRead(controlBoardsReadHealth[torqueCtrlBoard], update, Time::now()-read_start);
 
     // if read succeeded => update data
     if(update)
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include "yarpWholeBodySensorsLog.h"
+
+#include <wbi/wbiID.h>
+#include <yarp/os/Log.h>
+
+#include <sstream>
+#include <cstring>
+#include <string>
+
+using namespace wbi;
+using namespace yarpWbi;
+
+int yarpWbi::sensorsLogDataSize(const wbi::SensorType st)
+{
+    return sensorTypeDescriptions[st].dataSize;
+}
+
+yarpWholeBodySensorsLogWriter::yarpWholeBodySensorsLogWriter(): header(0)
+{
+}
+
+yarpWholeBodySensorsLogWriter::~yarpWholeBodySensorsLogWriter()
+{
+    close();
+}
+
+bool yarpWholeBodySensorsLogWriter::open(const std::string & path,
+                                         const size_t capacityInBytes,
+                                         const std::vector<wbi::IDList> & sensorLists)
+{
+    if( isOpen() )
+    {
+        return false;
+    }
+
+    if( (int)sensorLists.size() > SENSORS_LOG_MAX_SENSOR_TYPES )
+    {
+        yError("yarpWholeBodySensorsLogWriter: too many sensor types");
+        return false;
+    }
+
+    // Serialize the names of the logged sensors
+    std::stringstream names;
+    for(int st = 0; st < (int)sensorLists.size(); st++)
+    {
+        for(int i = 0; i < (int)sensorLists[st].size(); i++)
+        {
+            wbi::ID sensorId;
+            sensorLists[st].indexToID(i,sensorId);
+            names << st << " " << sensorId.toString() << "\n";
+        }
+    }
+    std::string namesBlock = names.str();
+    // keep the records aligned to 8 bytes
+    size_t namesBlockSize = ((namesBlock.size()+7)/8)*8;
+    size_t dataOffset = sizeof(sensorsLogFileHeader) + namesBlockSize;
+
+    if( capacityInBytes <= dataOffset )
+    {
+        yError("yarpWholeBodySensorsLogWriter: capacity of %lu bytes is too small", (unsigned long)capacityInBytes);
+        return false;
+    }
+
+    if( !logFile.create(path,capacityInBytes) )
+    {
+        yError("yarpWholeBodySensorsLogWriter: impossible to create log file %s", path.c_str());
+        return false;
+    }
+
+    header = (sensorsLogFileHeader *)logFile.data();
+    memset(header, 0, sizeof(sensorsLogFileHeader));
+    header->magic = SENSORS_LOG_MAGIC;
+    header->version = SENSORS_LOG_VERSION;
+    header->nrOfSensorTypes = sensorLists.size();
+    header->namesBlockSize = namesBlockSize;
+    header->dataOffset = dataOffset;
+    header->writeOffset = dataOffset;
+    header->capacity = capacityInBytes;
+    header->droppedRecords = 0;
+
+    lastData.resize(sensorLists.size());
+    lastStamps.resize(sensorLists.size());
+    for(int st = 0; st < (int)sensorLists.size(); st++)
+    {
+        int nrOfSensors = sensorLists[st].size();
+        header->nrOfSensors[st] = nrOfSensors;
+        header->recordSize[st] = sizeof(sensorsLogRecordHeader)
+                                 + nrOfSensors*(sensorsLogDataSize((wbi::SensorType)st)+1)*sizeof(double);
+        header->nrOfRecords[st] = 0;
+        lastData[st].assign(nrOfSensors*sensorsLogDataSize((wbi::SensorType)st),0.0);
+        lastStamps[st].assign(nrOfSensors,0.0);
+    }
+
+    memset(logFile.data()+sizeof(sensorsLogFileHeader), 0, namesBlockSize);
+    memcpy(logFile.data()+sizeof(sensorsLogFileHeader), namesBlock.c_str(), namesBlock.size());
+
+    return true;
+}
+
+bool yarpWholeBodySensorsLogWriter::appendRecord(const wbi::SensorType st, const double readTime)
+{
+    int nrOfSensors = header->nrOfSensors[st];
+    long long recordSize = header->recordSize[st];
+
+    if( header->writeOffset + recordSize > header->capacity )
+    {
+        header->droppedRecords++;
+        return false;
+    }
+
+    char * record = logFile.data() + header->writeOffset;
+
+    sensorsLogRecordHeader recordHeader;
+    recordHeader.sensorType = st;
+    recordHeader.nrOfSensors = nrOfSensors;
+    recordHeader.readTime = readTime;
+    memcpy(record, &recordHeader, sizeof(sensorsLogRecordHeader));
+
+    size_t dataBytes = lastData[st].size()*sizeof(double);
+    memcpy(record+sizeof(sensorsLogRecordHeader), &(lastData[st][0]), dataBytes);
+    memcpy(record+sizeof(sensorsLogRecordHeader)+dataBytes, &(lastStamps[st][0]), nrOfSensors*sizeof(double));
+
+    // the record is visible to readers only once it is complete:
+    // the writes of the record must not be reordered after the update of writeOffset
+    memoryBarrier();
+    header->nrOfRecords[st]++;
+    header->writeOffset += recordSize;
+
+    return true;
+}
+
+bool yarpWholeBodySensorsLogWriter::logRecord(const wbi::SensorType st, const double readTime,
+                                              const double * data, const double * stamps)
+{
+    if( !header || st < 0 || st >= header->nrOfSensorTypes )
+    {
+        return false;
+    }
+
+    int nrOfSensors = header->nrOfSensors[st];
+    if( nrOfSensors == 0 )
+    {
+        return true;
+    }
+
+    memcpy(&(lastData[st][0]), data, lastData[st].size()*sizeof(double));
+    for(int i = 0; i < nrOfSensors; i++)
+    {
+        lastStamps[st][i] = (stamps == 0) ? readTime : stamps[i];
+    }
+
+    return appendRecord(st,readTime);
+}
+
+bool yarpWholeBodySensorsLogWriter::logSensorRecord(const wbi::SensorType st, const int sensor, const double readTime,
+                                                    const double * data, const double * stamp)
+{
+    if( !header || st < 0 || st >= header->nrOfSensorTypes
+        || sensor < 0 || sensor >= header->nrOfSensors[st] )
+    {
+        return false;
+    }
+
+    int dataSize = sensorsLogDataSize(st);
+    memcpy(&(lastData[st][sensor*dataSize]), data, dataSize*sizeof(double));
+    lastStamps[st][sensor] = (stamp == 0) ? readTime : *stamp;
+
+    return appendRecord(st,readTime);
+}
+
+bool yarpWholeBodySensorsLogWriter::close()
+{
+    if( !header )
+    {
+        return true;
+    }
+
+    size_t finalSize = header->writeOffset;
+    if( header->droppedRecords > 0 )
+    {
+        yWarning("yarpWholeBodySensorsLogWriter: %lld records were not logged because the log file was full",
+                 header->droppedRecords);
+    }
+    header = 0;
+    return logFile.close(finalSize);
+}
+
+bool yarpWholeBodySensorsLogWriter::isOpen() const
+{
+    return header != 0;
+}
+
+long long yarpWholeBodySensorsLogWriter::getNrOfDroppedRecords() const
+{
+    return header ? header->droppedRecords : 0;
+}
+
+yarpWholeBodySensorsLogReader::yarpWholeBodySensorsLogReader(): header(0)
+{
+}
+
+yarpWholeBodySensorsLogReader::~yarpWholeBodySensorsLogReader()
+{
+    close();
+}
+
+const sensorsLogRecordHeader * yarpWholeBodySensorsLogReader::recordHeader(const long long offset) const
+{
+    return (const sensorsLogRecordHeader *)(logFile.data()+offset);
+}
+
+bool yarpWholeBodySensorsLogReader::open(const std::string & path)
+{
+    if( isOpen() )
+    {
+        return false;
+    }
+
+    if( !logFile.openReadOnly(path) )
+    {
+        yError("yarpWholeBodySensorsLogReader: impossible to open log file %s", path.c_str());
+        return false;
+    }
+
+    const sensorsLogFileHeader * fileHeader = (const sensorsLogFileHeader *)logFile.data();
+    if( logFile.size() < sizeof(sensorsLogFileHeader)
+        || fileHeader->magic != SENSORS_LOG_MAGIC
+        || fileHeader->version != SENSORS_LOG_VERSION
+        || fileHeader->nrOfSensorTypes > SENSORS_LOG_MAX_SENSOR_TYPES
+        || fileHeader->writeOffset > (long long)logFile.size()
+        || fileHeader->dataOffset > fileHeader->writeOffset )
+    {
+        yError("yarpWholeBodySensorsLogReader: %s is not a valid sensors log", path.c_str());
+        logFile.close();
+        return false;
+    }
+
+    // Parse the names of the sensors
+    sensorLists.clear();
+    sensorLists.resize(fileHeader->nrOfSensorTypes);
+    std::string namesBlock(logFile.data()+sizeof(sensorsLogFileHeader),
+                           strnlen(logFile.data()+sizeof(sensorsLogFileHeader),fileHeader->namesBlockSize));
+    std::stringstream names(namesBlock);
+    int st;
+    std::string sensorName;
+    while( names >> st >> sensorName )
+    {
+        if( st < 0 || st >= fileHeader->nrOfSensorTypes )
+        {
+            yError("yarpWholeBodySensorsLogReader: %s has a malformed list of sensors", path.c_str());
+            logFile.close();
+            return false;
+        }
+        sensorLists[st].addID(wbi::ID(sensorName));
+    }
+
+    // Index the records
+    recordOffsets.clear();
+    recordOffsets.resize(fileHeader->nrOfSensorTypes);
+    allRecordOffsets.clear();
+    long long offset = fileHeader->dataOffset;
+    while( offset + (long long)sizeof(sensorsLogRecordHeader) <= fileHeader->writeOffset )
+    {
+        const sensorsLogRecordHeader * record = recordHeader(offset);
+        if( record->sensorType < 0 || record->sensorType >= fileHeader->nrOfSensorTypes
+            || record->nrOfSensors != fileHeader->nrOfSensors[record->sensorType] )
+        {
+            yError("yarpWholeBodySensorsLogReader: %s has a corrupted record at offset %lld", path.c_str(), offset);
+            break;
+        }
+        recordOffsets[record->sensorType].push_back(offset);
+        allRecordOffsets.push_back(offset);
+        offset += fileHeader->recordSize[record->sensorType];
+    }
+
+    header = fileHeader;
+    return true;
+}
+
+bool yarpWholeBodySensorsLogReader::close()
+{
+    header = 0;
+    recordOffsets.clear();
+    allRecordOffsets.clear();
+    return logFile.close();
+}
+
+bool yarpWholeBodySensorsLogReader::isOpen() const
+{
+    return header != 0;
+}
+
+const wbi::IDList & yarpWholeBodySensorsLogReader::getSensorList(const wbi::SensorType st) const
+{
+    if( st < 0 || st >= (int)sensorLists.size() )
+    {
+        return emptyList;
+    }
+    return sensorLists[st];
+}
+
+int yarpWholeBodySensorsLogReader::getNrOfRecords(const wbi::SensorType st) const
+{
+    if( st < 0 || st >= (int)recordOffsets.size() )
+    {
+        return 0;
+    }
+    return recordOffsets[st].size();
+}
+
+int yarpWholeBodySensorsLogReader::getNrOfRecords() const
+{
+    return allRecordOffsets.size();
+}
+
+double yarpWholeBodySensorsLogReader::getRecordTime(const wbi::SensorType st, const int record) const
+{
+    return recordHeader(recordOffsets[st][record])->readTime;
+}
+
+const double * yarpWholeBodySensorsLogReader::getRecordData(const wbi::SensorType st, const int record) const
+{
+    return (const double *)(logFile.data()+recordOffsets[st][record]+sizeof(sensorsLogRecordHeader));
+}
+
+const double * yarpWholeBodySensorsLogReader::getRecordStamps(const wbi::SensorType st, const int record) const
+{
+    return getRecordData(st,record)+header->nrOfSensors[st]*sensorsLogDataSize(st);
+}
+
+double yarpWholeBodySensorsLogReader::getRecordTime(const int record) const
+{
+    return recordHeader(allRecordOffsets[record])->readTime;
+}
+
+wbi::SensorType yarpWholeBodySensorsLogReader::getRecordSensorType(const int record) const
+{
+    return (wbi::SensorType)recordHeader(allRecordOffsets[record])->sensorType;
+}
+
+double yarpWholeBodySensorsLogReader::getStartTime() const
+{
+    return allRecordOffsets.size() > 0 ? getRecordTime(0) : 0.0;
+}
+
+double yarpWholeBodySensorsLogReader::getEndTime() const
+{
+    return allRecordOffsets.size() > 0 ? getRecordTime(allRecordOffsets.size()-1) : 0.0;
+}
@@ -0,0 +1,432 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include "yarpWholeBodySensorsReplay.h"
+
+#include <yarp/os/Time.h>
+#include <yarp/os/Log.h>
+#include <yarp/os/LogStream.h>
+
+#include <cstring>
+
+using namespace std;
+using namespace wbi;
+using namespace yarpWbi;
+using namespace yarp::os;
+
+yarpWholeBodySensorsReplay::yarpWholeBodySensorsReplay(const char* _name, const yarp::os::Property & opt):
+yarpWholeBodySensors(_name,opt),
+replayMode(REPLAY_REAL_TIME),
+replaySpeed(1.0),
+replayTime(0.0),
+replayWallClockStart(0.0),
+replayStarted(false),
+lastSteppedRecord(-1),
+replayAccelerometersFromIMUs(false)
+{
+}
+
+yarpWholeBodySensorsReplay::~yarpWholeBodySensorsReplay()
+{
+    close();
+}
+
+const IDList & yarpWholeBodySensorsReplay::getReplayedSensorList(const SensorType st)
+{
+    // as for the live sensors, speeds and accelerations are read for all the encoders
+    if( st == SENSOR_ENCODER_SPEED || st == SENSOR_ENCODER_ACCELERATION )
+    {
+        return sensorIdList[SENSOR_ENCODER_POS];
+    }
+    return sensorIdList[st];
+}
+
+bool yarpWholeBodySensorsReplay::init()
+{
+    if( initDone ) return true;
+
+    yarp::os::Bottle & sensors_opt_bot = wbi_yarp_properties.findGroup("WBI_SENSORS_OPTIONS");
+    if( !sensors_opt_bot.check("replayLogFile") )
+    {
+        yError("yarpWholeBodySensorsReplay: replayLogFile option not found in WBI_SENSORS_OPTIONS");
+        return false;
+    }
+
+    std::string replayModeString = "realtime";
+    if( sensors_opt_bot.check("replayMode") )
+    {
+        replayModeString = sensors_opt_bot.find("replayMode").asString().c_str();
+    }
+
+    if( replayModeString == "realtime" )
+    {
+        replayMode = REPLAY_REAL_TIME;
+    }
+    else if( replayModeString == "fast" )
+    {
+        replayMode = REPLAY_AS_FAST_AS_POSSIBLE;
+    }
+    else if( replayModeString == "stepped" )
+    {
+        replayMode = REPLAY_STEPPED;
+    }
+    else
+    {
+        yError() << "yarpWholeBodySensorsReplay: unknown replayMode " << replayModeString;
+        return false;
+    }
+
+    if( sensors_opt_bot.check("replaySpeed") )
+    {
+        yarp::os::Value & replaySpeedValue = sensors_opt_bot.find("replaySpeed");
+        if( !replaySpeedValue.isDouble() && !replaySpeedValue.isInt() )
+        {
+            yError("yarpWholeBodySensorsReplay: replaySpeed should be a number");
+            return false;
+        }
+        replaySpeed = replaySpeedValue.asDouble();
+        if( replaySpeed <= 0.0 )
+        {
+            yError("yarpWholeBodySensorsReplay: replaySpeed should be positive");
+            return false;
+        }
+    }
+
+    // As in yarpWholeBodySensors::init, the IMUs from which the accelerometers
+    // are derived are added to the IMUs, so that the replayed lists match the logged ones
+    std::vector< AccelerometerConfigurationInfo > acc_infos;
+    if( !loadAccelerometerInfoFromConfig(wbi_yarp_properties,sensorIdList[SENSOR_ACCELEROMETER],acc_infos)
+        || sensorIdList[SENSOR_ACCELEROMETER].size() != acc_infos.size() )
+    {
+        yError("yarpWholeBodySensorsReplay: impossible to load the configuration of the accelerometers");
+        return false;
+    }
+
+    for(int acc_index = 0; acc_index < (int)acc_infos.size(); acc_index++)
+    {
+        if( acc_infos[acc_index].type == IMU_STYLE )
+        {
+            sensorIdList[SENSOR_IMU].addID(acc_infos[acc_index].type_option);
+        }
+    }
+
+    accelerometersReferenceIndeces.resize(acc_infos.size());
+    for(int acc_index = 0; acc_index < (int)acc_infos.size(); acc_index++)
+    {
+        if( !openAccelerometer(acc_index,acc_infos[acc_index]) )
+        {
+            return false;
+        }
+    }
+
+    std::string logFile = sensors_opt_bot.find("replayLogFile").asString().c_str();
+    if( !logReader.open(logFile) )
+    {
+        return false;
+    }
+
+    // The accelerometers are replayed from their own records if all of them
+    // were read while recording, otherwise from the records of their IMUs
+    const IDList & loggedAccelerometers = logReader.getSensorList(SENSOR_ACCELEROMETER);
+    replayAccelerometersFromIMUs = sensorIdList[SENSOR_ACCELEROMETER].size() > 0
+                                   && logReader.getNrOfRecords(SENSOR_ACCELEROMETER) == 0;
+    for(int acc_index = 0; acc_index < (int)sensorIdList[SENSOR_ACCELEROMETER].size(); acc_index++)
+    {
+        wbi::ID accId;
+        int logIndex;
+        sensorIdList[SENSOR_ACCELEROMETER].indexToID(acc_index,accId);
+        if( !loggedAccelerometers.idToIndex(accId,logIndex) )
+        {
+            replayAccelerometersFromIMUs = true;
+        }
+    }
+
+    // Map the added sensors to the sensors in the log
+    sensorIndexInLog.resize(wbi::SENSOR_TYPE_SIZE);
+    currentRecord.assign(wbi::SENSOR_TYPE_SIZE,-1);
+    for(int st = 0; st < wbi::SENSOR_TYPE_SIZE; st++)
+    {
+        const IDList & replayedList = getReplayedSensorList((SensorType)st);
+        const IDList & loggedList = logReader.getSensorList((SensorType)st);
+        sensorIndexInLog[st].resize(replayedList.size());
+        for(int i = 0; i < (int)replayedList.size(); i++)
+        {
+            wbi::ID sensorId;
+            replayedList.indexToID(i,sensorId);
+            if( st == SENSOR_ACCELEROMETER && replayAccelerometersFromIMUs )
+            {
+                sensorIndexInLog[st][i] = -1;
+            }
+            else if( !loggedList.idToIndex(sensorId,sensorIndexInLog[st][i]) )
+            {
+                yError() << "yarpWholeBodySensorsReplay: sensor " << sensorId.toString()
+                         << " of type " << st << " not found in " << logFile;
+                logReader.close();
+                return false;
+            }
+        }
+    }
+
+    replayTime = logReader.getStartTime();
+    replayStarted = false;
+    lastSteppedRecord = -1;
+
+    yInfo() << "yarpWholeBodySensorsReplay: replaying " << logReader.getNrOfRecords()
+            << " records (" << logReader.getEndTime()-logReader.getStartTime() << " seconds) from " << logFile;
+
+    initDone = true;
+    return true;
+}
+
+bool yarpWholeBodySensorsReplay::close()
+{
+    initDone = false;
+    return logReader.close();
+}
+
+int yarpWholeBodySensorsReplay::updateCurrentRecord(const SensorType st, bool advance, bool blocking)
+{
+    int nrOfRecords = logReader.getNrOfRecords(st);
+    int & record = currentRecord[st];
+
+    if( nrOfRecords == 0 )
+    {
+        return -1;
+    }
+
+    if( replayMode == REPLAY_AS_FAST_AS_POSSIBLE )
+    {
+        if( (advance || record < 0) && record+1 < nrOfRecords )
+        {
+            record++;
+            replayTime = logReader.getRecordTime(st,record);
+        }
+        return record;
+    }
+
+    if( replayMode == REPLAY_REAL_TIME )
+    {
+        double now = yarp::os::Time::now();
+        if( !replayStarted )
+        {
+            replayWallClockStart = now - (replayTime-logReader.getStartTime())/replaySpeed;
+            replayStarted = true;
+        }
+
+        // blocking reads wait for the first record of this type
+        if( record < 0 && blocking )
+        {
+            double firstRecordWallClock = replayWallClockStart
+                                          + (logReader.getRecordTime(st,0)-logReader.getStartTime())/replaySpeed;
+            if( firstRecordWallClock > now )
+            {
+                yarp::os::Time::delay(firstRecordWallClock-now);
+                now = yarp::os::Time::now();
+            }
+        }
+
+        replayTime = logReader.getStartTime() + (now-replayWallClockStart)*replaySpeed;
+    }
+
+    while( record+1 < nrOfRecords && logReader.getRecordTime(st,record+1) <= replayTime )
+    {
+        record++;
+    }
+
+    return record;
+}
+
+void yarpWholeBodySensorsReplay::copyRecord(const SensorType st, const int record, const int sensor,
+                                            double *data, double *stamps)
+{
+    int dataSize = sensorsLogDataSize(st);
+    const double * recordData = logReader.getRecordData(st,record);
+    const double * recordStamps = logReader.getRecordStamps(st,record);
+
+    int firstSensor = (sensor < 0) ? 0 : sensor;
+    int endSensor = (sensor < 0) ? (int)sensorIndexInLog[st].size() : sensor+1;
+    for(int i = firstSensor; i < endSensor; i++)
+    {
+        int logIndex = sensorIndexInLog[st][i];
+        memcpy(data+(i-firstSensor)*dataSize, recordData+logIndex*dataSize, dataSize*sizeof(double));
+        if( stamps != 0 )
+        {
+            stamps[i-firstSensor] = recordStamps[logIndex];
+        }
+    }
+}
+
+void yarpWholeBodySensorsReplay::copyAccelerometersFromIMURecord(const int imuRecord, const int sensor,
+                                                                 double *data, double *stamps)
+{
+    // components of the wbi IMU reading used by yarpWholeBodySensors::readAccelerometer
+    // (elements 4 to 6 of the yarp IMU reading, shifted by the conversion of the orientation)
+    const int accelerationOffset = 5;
+    int imuDataSize = sensorsLogDataSize(SENSOR_IMU);
+    int accDataSize = sensorsLogDataSize(SENSOR_ACCELEROMETER);
+    const double * imuData = logReader.getRecordData(SENSOR_IMU,imuRecord);
+    const double * imuStamps = logReader.getRecordStamps(SENSOR_IMU,imuRecord);
+
+    int firstSensor = (sensor < 0) ? 0 : sensor;
+    int endSensor = (sensor < 0) ? (int)sensorIndexInLog[SENSOR_ACCELEROMETER].size() : sensor+1;
+    for(int i = firstSensor; i < endSensor; i++)
+    {
+        int imuIndex = accelerometersReferenceIndeces[i].type_reference_index;
+        int logIndex = sensorIndexInLog[SENSOR_IMU][imuIndex];
+        memcpy(data+(i-firstSensor)*accDataSize, imuData+logIndex*imuDataSize+accelerationOffset,
+               accDataSize*sizeof(double));
+        if( stamps != 0 )
+        {
+            stamps[i-firstSensor] = imuStamps[logIndex];
+        }
+    }
+}
+
+bool yarpWholeBodySensorsReplay::readAccelerometersFromIMUs(const int sensor, double *data, double *stamps, bool blocking)
+{
+    // as for the live sensors, reading the accelerometers does not consume the readings of the IMUs
+    int record = updateCurrentRecord(SENSOR_IMU,false,blocking);
+    if( record < 0 )
+    {
+        return false;
+    }
+
+    copyAccelerometersFromIMURecord(record,sensor,data,stamps);
+    return true;
+}
+
+bool yarpWholeBodySensorsReplay::readSensor(const SensorType st, const int sensor, double *data, double *stamps, bool blocking)
+{
+    if( !initDone || st < 0 || st >= wbi::SENSOR_TYPE_SIZE
+        || sensor < 0 || sensor >= (int)sensorIndexInLog[st].size() )
+    {
+        return false;
+    }
+
+    if( st == SENSOR_ACCELEROMETER && replayAccelerometersFromIMUs )
+    {
+        return readAccelerometersFromIMUs(sensor,data,stamps,blocking);
+    }
+
+    // reading a single sensor does not consume records in fast mode
+    int record = updateCurrentRecord(st,false,blocking);
+    if( record < 0 )
+    {
+        return false;
+    }
+
+    copyRecord(st,record,sensor,data,stamps);
+    return true;
+}
+
+bool yarpWholeBodySensorsReplay::readSensors(const SensorType st, double *data, double *stamps, bool blocking)
+{
+    if( !initDone || st < 0 || st >= wbi::SENSOR_TYPE_SIZE )
+    {
+        return false;
+    }
+
+    if( sensorIndexInLog[st].size() == 0 )
+    {
+        return true;
+    }
+
+    if( st == SENSOR_ACCELEROMETER && replayAccelerometersFromIMUs )
+    {
+        return readAccelerometersFromIMUs(-1,data,stamps,blocking);
+    }
+
+    int record = updateCurrentRecord(st,true,blocking);
+    if( record < 0 )
+    {
+        return false;
+    }
+
+    copyRecord(st,record,-1,data,stamps);
+    return true;
+}
+
+bool yarpWholeBodySensorsReplay::step()
+{
+    if( !initDone || lastSteppedRecord+1 >= logReader.getNrOfRecords() )
+    {
+        return false;
+    }
+
+    lastSteppedRecord++;
+    replayTime = logReader.getRecordTime(lastSteppedRecord);
+    return true;
+}
+
+bool yarpWholeBodySensorsReplay::setReplayTime(const double time)
+{
+    if( !initDone )
+    {
+        return false;
+    }
+
+    replayTime = time;
+    replayStarted = false;
+
+    // records are searched again from the beginning of the log
+    for(int st = 0; st < wbi::SENSOR_TYPE_SIZE; st++)
+    {
+        currentRecord[st] = -1;
+        while( currentRecord[st]+1 < logReader.getNrOfRecords((SensorType)st)
+               && logReader.getRecordTime((SensorType)st,currentRecord[st]+1) <= replayTime )
+        {
+            currentRecord[st]++;
+        }
+    }
+
+    lastSteppedRecord = -1;
+    while( lastSteppedRecord+1 < logReader.getNrOfRecords()
+           && logReader.getRecordTime(lastSteppedRecord+1) <= replayTime )
+    {
+        lastSteppedRecord++;
+    }
+
+    return true;
+}
+
+double yarpWholeBodySensorsReplay::getReplayTime() const
+{
+    return replayTime;
+}
+
+bool yarpWholeBodySensorsReplay::isReplayFinished() const
+{
+    if( replayMode == REPLAY_AS_FAST_AS_POSSIBLE )
+    {
+        for(int st = 0; st < (int)currentRecord.size(); st++)
+        {
+            if( st == SENSOR_ACCELEROMETER && replayAccelerometersFromIMUs )
+            {
+                continue;
+            }
+            if( sensorIndexInLog[st].size() > 0
+                && currentRecord[st]+1 < logReader.getNrOfRecords((SensorType)st) )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    return replayTime >= logReader.getEndTime();
+}
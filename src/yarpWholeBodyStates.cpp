@@ -17,6 +17,7 @@
 
 #include "yarpWholeBodyStates.h"
 #include "yarpWholeBodySensors.h"
+#include "yarpWholeBodySensorsReplay.h"
 #include "yarpWbiUtil.h"
 
 #include <wbi/iWholeBodyModel.h>
@@ -248,6 +249,18 @@ bool yarpWholeBodyStates::configureFloatingBaseStateEstimator()
         prop.put("remote", state_opt_bot.find("externalFloatingBaseStatePort").asString().c_str());
         std::string local_port_name = "/" + name + "/" +  state_opt_bot.find("externalFloatingBaseStatePort").asString().c_str();
         prop.put("local",local_port_name.c_str());
+        if (state_opt_bot.check("externalFloatingBaseStateBinaryFormat"))
+        {
+            prop.put("binaryFormat",state_opt_bot.find("externalFloatingBaseStateBinaryFormat").asBool() ? 1 : 0);
+        }
+        if (state_opt_bot.check("externalFloatingBaseStateExtrapolation"))
+        {
+            prop.put("extrapolation",state_opt_bot.find("externalFloatingBaseStateExtrapolation").asString().c_str());
+        }
+        if (state_opt_bot.check("externalFloatingBaseStateMaxExtrapolationHorizon"))
+        {
+            prop.put("maxExtrapolationHorizon",state_opt_bot.find("externalFloatingBaseStateMaxExtrapolationHorizon").asDouble());
+        }
 
         estimator->use_remoteFloatingBaseStateEstimator = true;
         if (!estimator->remoteFltBaseStateEstimator.open(prop)) {
@@ -354,7 +367,15 @@ bool yarpWholeBodyStates::init()
 
 
 
-    sensors = new yarpWholeBodySensors(name.c_str(), wbi_yarp_properties);              // sensor interface
+    if( wbi_yarp_properties.findGroup("WBI_SENSORS_OPTIONS").check("replayLogFile") )
+    {
+        yInfo() << "yarpWholeBodyStates : replayLogFile option found, reading sensors from the recorded log";
+        sensors = new yarpWholeBodySensorsReplay(name.c_str(), wbi_yarp_properties);    // replayed sensor interface
+    }
+    else
+    {
+        sensors = new yarpWholeBodySensors(name.c_str(), wbi_yarp_properties);          // sensor interface
+    }
     estimator = new yarpWholeBodyEstimator(estimatorPeriod_in_ms, cutOffFrequencyTorqueInHz, cutOffFrequencyVelocitiesInHz, sensors);  // estimation thread
 
 
@@ -489,6 +510,11 @@ bool yarpWholeBodyStates::close()
     return ok;
 }
 
+bool yarpWholeBodyStates::warmUp()
+{
+    return initDone && sensors->warmUp();
+}
+
 bool yarpWholeBodyStates::addEstimate(const EstimateType et, const ID &sid)
 {
     if( initDone ) return false;
@@ -643,6 +669,20 @@ bool yarpWholeBodyStates::setEstimationParameter(const EstimateType et, const Es
     return estimator->lockAndSetEstimationParameter(et, ep, value);
 }
 
+bool yarpWholeBodyStates::getBaseStateTiming(double & stamp, double & extrapolationHorizon)
+{
+    if( !initDone || !estimator->estimateBaseState || !estimator->use_remoteFloatingBaseStateEstimator )
+    {
+        return false;
+    }
+
+    estimator->mutex.wait();
+    stamp = estimator->estimates.lastBaseStateStamp;
+    extrapolationHorizon = estimator->estimates.lastBaseStateExtrapolationHorizon;
+    estimator->mutex.post();
+    return true;
+}
+
 // *********************************************************************************************************************
 // *********************************************************************************************************************
 //                                          PRIVATE METHODS
@@ -898,7 +938,9 @@ void yarpWholeBodyEstimator::run()
             {
                 bool ok = remoteFltBaseStateEstimator.getBaseState(estimates.lastBasePos.data(),
                                                          estimates.lastBaseVel.data(),
-                                                         estimates.lastBaseAcc.data());
+                                                         estimates.lastBaseAcc.data(),
+                                                         &(estimates.lastBaseStateStamp),
+                                                         &(estimates.lastBaseStateExtrapolationHorizon));
 
                 if( !ok )
                 {
@@ -956,6 +998,8 @@ void yarpWholeBodyEstimator::resizeAll(int n)
     estimates.lastBasePos.resize(BASE_POS_ESTIMATE_SIZE);
     estimates.lastBaseVel.resize(BASE_VEL_ESTIMATE_SIZE);
     estimates.lastBaseAcc.resize(BASE_ACC_ESTIMATE_SIZE);
+    estimates.lastBaseStateStamp = 0.0;
+    estimates.lastBaseStateExtrapolationHorizon = 0.0;
 }
 
 bool yarpWholeBodyEstimator::lockAndCopyVector(const Vector &src, double *dest)
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+ * Tests of the floating base estimators that do not need a robot.
+ */
+
+#include <yarpWholeBodyInterface/floatingBaseEstimators.h>
+
+#include <yarp/os/Network.h>
+#include <yarp/os/Port.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Time.h>
+
+#include <Eigen/Core>
+#include <Eigen/LU>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace yarp::os;
+using namespace yarpWbi;
+
+const double TOL = 1e-9;
+
+bool checkEqual(const char * what, const double * expected, const double * actual, const int size)
+{
+    for(int i = 0; i < size; i++)
+    {
+        if( fabs(expected[i]-actual[i]) > TOL )
+        {
+            fprintf(stderr,"[ERR] floatingBaseEstimatorsTest: element %d of %s is %lf instead of %lf\n",
+                    i,what,actual[i],expected[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Stream a state with a constant twist (a helix around the z axis of the world)
+ * and check that the state extrapolated by remoteFloatingBaseStateEstimator
+ * is the closed form pose of the screw motion.
+ */
+bool testConstantTwistExtrapolation()
+{
+    const double u = 0.4, vz = 0.1, omega = 1.3, alpha = 0.3, horizon = 0.5;
+
+    Port statePort;
+    if( !statePort.open("/floatingBaseEstimatorsTest/state:o") )
+    {
+        fprintf(stderr,"[ERR] floatingBaseEstimatorsTest: impossible to open the state port\n");
+        return false;
+    }
+
+    Property options;
+    options.fromString("(local /floatingBaseEstimatorsTest/state:i) (remote /floatingBaseEstimatorsTest/state:o) "
+                       "(carrier tcp) (binaryFormat 1) (extrapolation constantTwist) (maxExtrapolationHorizon 1.0)");
+    remoteFloatingBaseStateEstimator estimator;
+    if( !estimator.open(options) )
+    {
+        fprintf(stderr,"[ERR] floatingBaseEstimatorsTest: impossible to open the estimator\n");
+        return false;
+    }
+
+    // base rotated of alpha around x, in (1,2,3), moving along a helix around the z axis
+    floatingBaseStateMessage state;
+    double basePosition[16] = { 1.0, 0.0,         0.0,          1.0,
+                                0.0, cos(alpha), -sin(alpha),   2.0,
+                                0.0, sin(alpha),  cos(alpha),   3.0,
+                                0.0, 0.0,         0.0,          1.0 };
+    double baseVelocity[6] = { u, 0.0, vz, 0.0, 0.0, omega };
+    for(int i = 0; i < 16; i++ ) state.basePosition[i] = basePosition[i];
+    for(int i = 0; i < 6; i++ ) state.baseVelocity[i] = baseVelocity[i];
+    state.sequenceNumber = 1;
+    state.timestamp = Time::now();
+    statePort.write(state);
+
+    double pos[16], vel[6], acc[6], sourceTimestamp = 0.0, usedHorizon = 0.0;
+    bool received = false;
+    for(int attempt = 0; attempt < 100 && !received; attempt++ )
+    {
+        Time::delay(0.01);
+        received = estimator.getBaseStateAt(state.timestamp+horizon,pos,vel,acc,&sourceTimestamp,&usedHorizon);
+    }
+
+    bool ok = received;
+    if( !received )
+    {
+        fprintf(stderr,"[ERR] floatingBaseEstimatorsTest: the state was not received\n");
+    }
+
+    // R(h) = Rz(omega*h)*Rx(alpha), p(h) = p(0) + integral of Rz(omega*s)*v for s in [0,h]
+    double c = cos(omega*horizon), s = sin(omega*horizon);
+    double expectedPosition[16] = { c, -s*cos(alpha),  s*sin(alpha), 1.0 + u*s/omega,
+                                    s,  c*cos(alpha), -c*sin(alpha), 2.0 + u*(1.0-c)/omega,
+                                  0.0,  sin(alpha),    cos(alpha),   3.0 + vz*horizon,
+                                  0.0,  0.0,           0.0,          1.0 };
+    double expectedVelocity[6] = { u*c, u*s, vz, 0.0, 0.0, omega };
+    ok = ok && checkEqual("extrapolated position",expectedPosition,pos,16);
+    ok = ok && checkEqual("extrapolated velocity",expectedVelocity,vel,6);
+    ok = ok && checkEqual("extrapolation horizon",&horizon,&usedHorizon,1);
+    ok = ok && checkEqual("source timestamp",&(state.timestamp),&sourceTimestamp,1);
+
+    estimator.close();
+    statePort.close();
+    return ok;
+}
+
+double randomDouble()
+{
+    return 2.0*((double)rand()/RAND_MAX)-1.0;
+}
+
+/**
+ * Check the closed form solution of computeBaseVelocityOfFixedLink against
+ * the solution obtained factorizing the base block of the jacobian,
+ * for random jacobians with the structure of the mixed representation.
+ */
+bool testBaseVelocityOfFixedLink()
+{
+    const int dof = 25;
+    const int nrOfTrials = 100;
+    srand(0);
+
+    typedef Eigen::Matrix<double,6,Eigen::Dynamic,Eigen::RowMajor> JacobianType;
+    JacobianType jacobian(6,dof+6);
+    Eigen::VectorXd dq(dof);
+    Eigen::Matrix<double,6,1> expectedBaseVelocity, baseVelocity;
+
+    for(int trial = 0; trial < nrOfTrials; trial++ )
+    {
+        Eigen::Vector3d r(randomDouble(),randomDouble(),randomDouble());
+        Eigen::Matrix3d minusSkewR;
+        minusSkewR <<  0.0,   r(2), -r(1),
+                     -r(2),   0.0,   r(0),
+                      r(1), -r(0),   0.0;
+        jacobian.leftCols<6>().setIdentity();
+        jacobian.block<3,3>(0,3) = minusSkewR;
+        for(int row = 0; row < 6; row++ )
+        {
+            for(int col = 6; col < dof+6; col++ )
+            {
+                jacobian(row,col) = randomDouble();
+            }
+        }
+        for(int i = 0; i < dof; i++ )
+        {
+            dq(i) = randomDouble();
+        }
+
+        Eigen::PartialPivLU<Eigen::MatrixXd> luDecompositionOfBaseJacobian(jacobian.leftCols<6>());
+        expectedBaseVelocity = -luDecompositionOfBaseJacobian.solve(jacobian.rightCols(dof) * dq);
+
+        computeBaseVelocityOfFixedLink(jacobian.data(),dof,dq.data(),baseVelocity.data());
+
+        if( !checkEqual("base velocity of fixed link",expectedBaseVelocity.data(),baseVelocity.data(),6) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char * argv[])
+{
+    Network::setLocalMode(true);
+    Network yarpNet;
+
+    bool ok = testConstantTwistExtrapolation();
+    ok = testBaseVelocityOfFixedLink() && ok;
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+ * Tests of the helpers of yarpWbiUtil.h that do not need a robot.
+ */
+
+#include <yarpWholeBodyInterface/yarpWbiUtil.h>
+
+#include <yarp/os/Bottle.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace yarpWbi;
+
+const double TOL = 1e-9;
+
+bool checkEqual(const char * what, const double * expected, const double * actual, const int size)
+{
+    for(int i = 0; i < size; i++)
+    {
+        if( fabs(expected[i]-actual[i]) > TOL )
+        {
+            fprintf(stderr,"[ERR] yarpWbiUtilTest: element %d of %s is %lf instead of %lf\n",
+                    i,what,actual[i],expected[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Readings of 13 values as the IMU ones: an orientation in axis-angle followed by 9 values.
+ */
+bool testSensorReadingsHistory()
+{
+    const int dataSize = 13;
+    sensorReadingsHistory history;
+    history.resize(dataSize,4);
+
+    std::vector<double> first(dataSize,0.0), second(dataSize,0.0), reading(dataSize);
+    // rotations of 0.2 and 0.6 rad around z, linear values i and 3*i
+    first[2] = second[2] = 1.0;
+    first[3] = 0.2;
+    second[3] = 0.6;
+    for(int i = 4; i < dataSize; i++)
+    {
+        first[i] = i;
+        second[i] = 3*i;
+    }
+
+    bool ok = history.push(&first[0],1.0) && history.push(&second[0],2.0);
+    ok = ok && !history.push(&first[0],1.5);
+
+    // a quarter of the way: 0.3 rad around z, linear values 1.5*i
+    std::vector<double> expected(dataSize,0.0);
+    expected[2] = 1.0;
+    expected[3] = 0.3;
+    for(int i = 4; i < dataSize; i++)
+    {
+        expected[i] = 1.5*i;
+    }
+
+    double stamp = 0.0;
+    ok = ok && history.getReadingAt(1.25,true,&reading[0],&stamp,true);
+    ok = ok && checkEqual("slerp reading",&expected[0],&reading[0],dataSize);
+    ok = ok && (stamp == 1.0);
+
+    // without interpolation the nearest sample is returned
+    ok = ok && history.getReadingAt(1.75,false,&reading[0],&stamp,true);
+    ok = ok && checkEqual("nearest reading",&second[0],&reading[0],dataSize);
+    ok = ok && (stamp == 2.0);
+
+    // outside of the history, no extrapolation
+    ok = ok && history.getReadingAt(3.0,true,&reading[0],0,true);
+    ok = ok && checkEqual("newest reading",&second[0],&reading[0],dataSize);
+
+    if( !ok )
+    {
+        fprintf(stderr,"[ERR] yarpWbiUtilTest: sensorReadingsHistory test failed\n");
+    }
+    return ok;
+}
+
+/**
+ * The lookups in configurationGroupIndex give the same values of yarp::os::Bottle::find on the group.
+ */
+bool testConfigurationGroupIndex()
+{
+    yarp::os::Bottle group;
+    group.fromString("(torso_yaw (torso 0)) (torso_roll (torso 1)) (torso_yaw (head 2)) (long_element 1 2 3) (name_only) not_a_list");
+    configurationGroupIndex index(group);
+
+    bool ok = true;
+
+    // the first element with a given name hides the following ones
+    yarp::os::Bottle * mapping = index.find("torso_yaw").asList();
+    if( !mapping || mapping->toString() != "torso 0" || index.find("torso_yaw").toString() != group.find("torso_yaw").toString() )
+    {
+        fprintf(stderr,"[ERR] yarpWbiUtilTest: the index does not return the first torso_yaw element\n");
+        ok = false;
+    }
+
+    // the names not in the group give a null value
+    if( !index.find("l_elbow").isNull() || index.check("l_elbow") || !index.find("not_a_list").isNull() )
+    {
+        fprintf(stderr,"[ERR] yarpWbiUtilTest: the index finds a name not in the group\n");
+        ok = false;
+    }
+
+    // the elements not in the (name value) form are found as Bottle::find does
+    const char * names[] = { "torso_roll", "long_element", "name_only" };
+    for(int name = 0; name < 3; name++)
+    {
+        std::string expected = group.find(names[name]).toString().c_str();
+        std::string actual = index.find(names[name]).toString().c_str();
+        if( !index.check(names[name]) || actual != expected )
+        {
+            fprintf(stderr,"[ERR] yarpWbiUtilTest: the index returns \"%s\" for %s instead of \"%s\"\n",
+                    actual.c_str(),names[name],expected.c_str());
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+int main(int argc, char * argv[])
+{
+    bool ok = testSensorReadingsHistory();
+    ok = testConfigurationGroupIndex() && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
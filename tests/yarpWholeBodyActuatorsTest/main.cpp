@@ -0,0 +1,516 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+ * Check how yarpWholeBodyActuators sends the references to the in-process
+ * fakeControlBoard, using the command statistics to count the calls
+ * to each interface of each control board, and how it shares the
+ * drivers of the control boards with yarpWholeBodySensors.
+ */
+
+#include "fakeControlBoard.h"
+
+#include <yarpWholeBodyInterface/yarpWholeBodySensors.h>
+#include <yarpWholeBodyInterface/yarpWholeBodyActuators.h>
+#include <yarpWholeBodyInterface/yarpWbiUtil.h>
+#include <yarpWholeBodyInterface/PIDList.h>
+
+#include <yarp/dev/PolyDriver.h>
+#include <yarp/os/Network.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Time.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace yarp::os;
+using namespace wbi;
+using namespace yarpWbi;
+
+const double TOL = 1e-8;
+const double UPDATE_PERIOD = 0.001;
+// robot whose parts are opened only by testSharedDrivers, so that the devices open for it can be counted
+const char * SHARED_DRIVERS_ROBOT = "fakeSharedRobot";
+// robot whose left leg refuses the torque pids
+const char * REJECTING_PIDS_ROBOT = "fakeRejectingPidsRobot";
+
+// all the axes of the torso are controlled, only four of the six axes of the leg
+const char * FAKE_ROBOT_CONFIGURATION =
+"robot fakeRobot\n"
+"controlBoardDevice fakeControlBoard\n"
+"[WBI_YARP_JOINTS]\n"
+"torso_yaw     = (torso,0)\n"
+"torso_roll    = (torso,1)\n"
+"torso_pitch   = (torso,2)\n"
+"l_hip_pitch   = (left_leg,0)\n"
+"l_hip_roll    = (left_leg,1)\n"
+"l_hip_yaw     = (left_leg,2)\n"
+"l_knee        = (left_leg,3)\n"
+"[WBI_ID_LISTS]\n"
+"ACTUATORS_TEST_JOINTS = (torso_yaw,torso_roll,torso_pitch,l_hip_pitch,l_hip_roll,l_hip_yaw,l_knee)\n";
+
+Property getOptions(const std::string & actuatorsOptions)
+{
+    Property options;
+    options.fromConfig((std::string(FAKE_ROBOT_CONFIGURATION) + "[WBI_ACTUATORS_OPTIONS]\n" + actuatorsOptions).c_str());
+    return options;
+}
+
+long long getNrOfCommands(yarpWholeBodyActuators & actuators, const std::string & controlBoard,
+                          const yarpWBACommandInterface commandInterface)
+{
+    actuatorsCommandHealth health;
+    return actuators.getCommandHealth(controlBoard,commandInterface,health) ? health.nrOfCommands : 0;
+}
+
+bool checkNrOfCommands(const char * test, yarpWholeBodyActuators & actuators, const std::string & controlBoard,
+                       const yarpWBACommandInterface commandInterface, const long long expected)
+{
+    long long nrOfCommands = getNrOfCommands(actuators,controlBoard,commandInterface);
+    if( nrOfCommands != expected )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: %lld commands sent to interface %d of %s instead of %lld\n",
+                test,nrOfCommands,(int)commandInterface,controlBoard.c_str(),expected);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Check that the encoders of the joints from firstJoint to lastJoint are at the expected position.
+ */
+bool checkEncoders(const char * test, yarpWholeBodySensors & sensors, const std::vector<double> & expected,
+                   const int firstJoint, const int lastJoint)
+{
+    Time::delay(2*UPDATE_PERIOD);
+    std::vector<double> q(expected.size());
+    if( !sensors.readSensors(SENSOR_ENCODER_POS,&q[0],0,false) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: impossible to read the encoders\n",test);
+        return false;
+    }
+    for(int i = firstJoint; i <= lastJoint; i++)
+    {
+        if( fabs(q[i]-expected[i]) > TOL )
+        {
+            fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: joint %d is at %lf instead of %lf\n",test,i,q[i],expected[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * With all the joints in the same mode, each control board receives
+ * the references with a single call, also if only some of its axes are controlled.
+ * Switching a joint to another mode adds a call only for its control board.
+ */
+bool testCommandPlan(yarpWholeBodySensors & sensors, const IDList & joints)
+{
+    const char * test = "command plan";
+    Property options = getOptions("");
+    yarpWholeBodyActuators actuators("actuatorsTestCommandPlan",options);
+    actuators.addActuators(joints);
+    if( !actuators.init() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: impossible to open the actuators\n",test);
+        return false;
+    }
+
+    int dof = joints.size();
+    std::vector<double> qRef(dof);
+    for(int i = 0; i < dof; i++)
+    {
+        qRef[i] = 0.1*(i+1);
+    }
+
+    bool ok = actuators.setControlMode(CTRL_MODE_DIRECT_POSITION);
+    actuators.resetCommandHealth();
+    ok = ok && actuators.setControlReference(&qRef[0]);
+    ok = ok && checkNrOfCommands(test,actuators,"torso",COMMAND_POSITION_DIRECT,1);
+    ok = ok && checkNrOfCommands(test,actuators,"left_leg",COMMAND_POSITION_DIRECT,1);
+    ok = ok && checkEncoders(test,sensors,qRef,0,dof-1);
+
+    // torso_yaw in velocity mode (at zero velocity), the other joints still in direct position
+    double zeroVelocity = 0.0;
+    ok = ok && actuators.setControlMode(CTRL_MODE_VEL,&zeroVelocity,0);
+    actuators.resetCommandHealth();
+    for(int i = 0; i < dof; i++)
+    {
+        qRef[i] = -0.1*(i+1);
+    }
+    qRef[0] = 0.0;
+    ok = ok && actuators.setControlReference(&qRef[0]);
+    ok = ok && checkNrOfCommands(test,actuators,"torso",COMMAND_POSITION_DIRECT,1);
+    ok = ok && checkNrOfCommands(test,actuators,"torso",COMMAND_VELOCITY,1);
+    ok = ok && checkNrOfCommands(test,actuators,"left_leg",COMMAND_POSITION_DIRECT,1);
+    ok = ok && checkNrOfCommands(test,actuators,"left_leg",COMMAND_VELOCITY,0);
+    ok = ok && checkEncoders(test,sensors,qRef,1,dof-1);
+
+    ok = actuators.close() && ok;
+    return ok;
+}
+
+/**
+ * With referenceDeduplication, a control board receives the references only if
+ * one of them changed, or if the keep alive period passed since the last call.
+ */
+bool testReferenceDeduplication(yarpWholeBodySensors & sensors, const IDList & joints)
+{
+    const char * test = "reference deduplication";
+    const double keepAlivePeriod = 0.2;
+    Property options = getOptions("referenceDeduplication true\nreferenceKeepAlivePeriod 0.2\n");
+    yarpWholeBodyActuators actuators("actuatorsTestDeduplication",options);
+    actuators.addActuators(joints);
+    if( !actuators.init() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: impossible to open the actuators\n",test);
+        return false;
+    }
+
+    int dof = joints.size();
+    std::vector<double> qRef(dof);
+    for(int i = 0; i < dof; i++)
+    {
+        qRef[i] = 0.05*(i+1);
+    }
+
+    bool ok = actuators.setControlMode(CTRL_MODE_DIRECT_POSITION);
+    actuators.resetCommandHealth();
+    ok = ok && actuators.setControlReference(&qRef[0]);
+    ok = ok && checkNrOfCommands(test,actuators,"torso",COMMAND_POSITION_DIRECT,1);
+    ok = ok && checkNrOfCommands(test,actuators,"left_leg",COMMAND_POSITION_DIRECT,1);
+
+    // the same references are not sent again
+    ok = ok && actuators.setControlReference(&qRef[0]);
+    ok = ok && checkNrOfCommands(test,actuators,"torso",COMMAND_POSITION_DIRECT,1);
+    ok = ok && checkNrOfCommands(test,actuators,"left_leg",COMMAND_POSITION_DIRECT,1);
+
+    // a new reference of the knee is sent only to the leg
+    qRef[dof-1] += 0.1;
+    ok = ok && actuators.setControlReference(&qRef[0]);
+    ok = ok && checkNrOfCommands(test,actuators,"torso",COMMAND_POSITION_DIRECT,1);
+    ok = ok && checkNrOfCommands(test,actuators,"left_leg",COMMAND_POSITION_DIRECT,2);
+    ok = ok && checkEncoders(test,sensors,qRef,0,dof-1);
+
+    // after the keep alive period all the references are sent again
+    Time::delay(keepAlivePeriod+0.05);
+    ok = ok && actuators.setControlReference(&qRef[0]);
+    ok = ok && checkNrOfCommands(test,actuators,"torso",COMMAND_POSITION_DIRECT,2);
+    ok = ok && checkNrOfCommands(test,actuators,"left_leg",COMMAND_POSITION_DIRECT,3);
+
+    ok = actuators.close() && ok;
+    return ok;
+}
+
+/**
+ * With nonBlockingControlReference, the references are sent by the sender thread:
+ * the last one queued reaches the control boards, and each queued reference is either sent
+ * or dropped. References queued before a change of control mode are never sent in the new mode.
+ */
+bool testNonBlockingControlReference(yarpWholeBodySensors & sensors, const IDList & joints)
+{
+    const char * test = "non blocking control reference";
+    const int nrOfReferences = 100;
+    const int nrOfModeSwitches = 20;
+    Property options = getOptions("nonBlockingControlReference true\n");
+    yarpWholeBodyActuators actuators("actuatorsTestNonBlocking",options);
+    actuators.addActuators(joints);
+    if( !actuators.init() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: impossible to open the actuators\n",test);
+        return false;
+    }
+
+    int dof = joints.size();
+    std::vector<double> qRef(dof);
+    bool ok = actuators.setControlMode(CTRL_MODE_DIRECT_POSITION);
+    for(int k = 1; ok && k <= nrOfReferences; k++)
+    {
+        for(int i = 0; i < dof; i++)
+        {
+            qRef[i] = 0.001*k*(i+1);
+        }
+        ok = actuators.setControlReference(&qRef[0]);
+    }
+    ok = ok && actuators.waitControlReference();
+    ok = ok && checkEncoders(test,sensors,qRef,0,dof-1);
+
+    controlReferenceQueueStats stats;
+    ok = ok && actuators.getControlReferenceQueueStats(stats);
+    if( ok && (stats.nrOfQueuedReferences != nrOfReferences
+               || stats.nrOfSentReferences+stats.nrOfDroppedReferences != nrOfReferences
+               || stats.nrOfFailedReferences != 0 || stats.queueDepth != 0) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: %lld references queued, %lld sent, %lld dropped, %lld failed, %d waiting\n",
+                test,stats.nrOfQueuedReferences,stats.nrOfSentReferences,stats.nrOfDroppedReferences,
+                stats.nrOfFailedReferences,stats.queueDepth);
+        ok = false;
+    }
+
+    // a position reference sent after the switch to torque mode would be read as a torque
+    std::vector<double> zeroTorques(dof,0.0), torques(dof);
+    for(int trial = 0; ok && trial < nrOfModeSwitches; trial++)
+    {
+        ok = actuators.setControlMode(CTRL_MODE_DIRECT_POSITION);
+        ok = ok && actuators.setControlReference(&qRef[0]);
+        ok = ok && actuators.setControlMode(CTRL_MODE_TORQUE,&zeroTorques[0]);
+        ok = ok && actuators.waitControlReference();
+        ok = ok && sensors.readSensors(SENSOR_TORQUE,&torques[0],0,false);
+        for(int i = 0; ok && i < dof; i++)
+        {
+            if( fabs(torques[i]) > TOL )
+            {
+                fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: torque of joint %d is %lf after the switch to torque mode\n",
+                        test,i,torques[i]);
+                ok = false;
+            }
+        }
+    }
+
+    if( !ok )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s failed\n",test);
+    }
+
+    ok = actuators.close() && ok;
+    return ok;
+}
+
+/**
+ * Sensors giving access to the driver of each control board.
+ */
+class driversOfSensors: public yarpWholeBodySensors
+{
+public:
+    driversOfSensors(const char * name, const Property & options): yarpWholeBodySensors(name,options) {}
+
+    yarp::dev::PolyDriver * getDriver(const std::string & controlBoard)
+    {
+        for(int ctrlBoard = 0; ctrlBoard < (int)controlBoardNames.size(); ctrlBoard++)
+        {
+            if( controlBoardNames[ctrlBoard] == controlBoard ) return dd[ctrlBoard];
+        }
+        return 0;
+    }
+};
+
+/**
+ * Actuators giving access to the driver of each control board.
+ */
+class driversOfActuators: public yarpWholeBodyActuators
+{
+public:
+    driversOfActuators(const char * name, const Property & options): yarpWholeBodyActuators(name,options) {}
+
+    yarp::dev::PolyDriver * getDriver(const std::string & controlBoard)
+    {
+        for(int ctrlBoard = 0; ctrlBoard < (int)controlBoardNames.size(); ctrlBoard++)
+        {
+            if( controlBoardNames[ctrlBoard] == controlBoard ) return dd[ctrlBoard];
+        }
+        return 0;
+    }
+};
+
+/**
+ * With shareControlBoardDrivers, the sensors and the actuators of the same parts use the same drivers:
+ * closing the actuators leaves the drivers open for the sensors, and the last close releases them.
+ */
+bool testSharedDrivers(const IDList & joints)
+{
+    const char * test = "shared drivers";
+    const char * parts[] = { "torso", "left_leg" };
+    Property options;
+    options.fromConfig(("shareControlBoardDrivers true\n" + std::string(FAKE_ROBOT_CONFIGURATION)).c_str());
+    options.put("robot",SHARED_DRIVERS_ROBOT);
+
+    driversOfSensors sensors("sharedDriversSensors",options);
+    sensors.addSensors(SENSOR_ENCODER_POS,joints);
+    driversOfActuators actuators("sharedDriversActuators",options);
+    actuators.addActuators(joints);
+    if( !sensors.init() || !actuators.init() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: impossible to open the sensors and the actuators\n",test);
+        sensors.close();
+        actuators.close();
+        return false;
+    }
+
+    bool ok = true;
+    for(int part = 0; part < 2; part++)
+    {
+        yarp::dev::PolyDriver * driver = sensors.getDriver(parts[part]);
+        int nrOfDevices = fakeControlBoard::getNrOfOpenDevices(SHARED_DRIVERS_ROBOT,parts[part]);
+        if( driver == 0 || driver != actuators.getDriver(parts[part]) || nrOfDevices != 1 )
+        {
+            fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: the driver of %s is not shared (%d devices open)\n",
+                    test,parts[part],nrOfDevices);
+            ok = false;
+        }
+    }
+
+    // the sensors still read the references sent before closing the actuators
+    int dof = joints.size();
+    std::vector<double> qRef(dof);
+    for(int i = 0; i < dof; i++)
+    {
+        qRef[i] = -0.1*(i+1);
+    }
+    ok = ok && actuators.setControlMode(CTRL_MODE_DIRECT_POSITION);
+    ok = ok && actuators.setControlReference(&qRef[0]);
+    ok = actuators.close() && ok;
+    ok = ok && checkEncoders(test,sensors,qRef,0,dof-1);
+
+    ok = sensors.close() && ok;
+    for(int part = 0; part < 2; part++)
+    {
+        int nrOfDevices = fakeControlBoard::getNrOfOpenDevices(SHARED_DRIVERS_ROBOT,parts[part]);
+        if( nrOfDevices != 0 )
+        {
+            fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: %d devices of %s still open after the last close\n",
+                    test,nrOfDevices,parts[part]);
+            ok = false;
+        }
+    }
+
+    if( !ok )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s failed\n",test);
+    }
+    return ok;
+}
+
+/**
+ * A gain schedule refused by the second control board (the left leg) is not applied:
+ * the first control board (the torso) gets back the gains it had before.
+ */
+bool testGainScheduleRollback(const IDList & joints)
+{
+    const char * test = "gain schedule rollback";
+    Property options = getOptions("");
+    options.put("robot",REJECTING_PIDS_ROBOT);
+    driversOfActuators actuators("actuatorsTestGainSchedule",options);
+    actuators.addActuators(joints);
+    if( !actuators.init() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: impossible to open the actuators\n",test);
+        return false;
+    }
+
+    yarp::dev::ITorqueControl * torsoTorqueControl = 0;
+    yarp::dev::PolyDriver * torsoDriver = actuators.getDriver("torso");
+    if( !torsoDriver || !torsoDriver->view(torsoTorqueControl) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: impossible to access the torso\n",test);
+        actuators.close();
+        return false;
+    }
+
+    // gains of the torso before the schedule
+    const int nrOfTorsoAxes = 3;
+    std::vector<yarp::dev::Pid> previousPids(nrOfTorsoAxes), pids(nrOfTorsoAxes);
+    bool ok = true;
+    for(int j = 0; j < nrOfTorsoAxes; j++)
+    {
+        previousPids[j].setKp(1.0+j);
+        previousPids[j].setKd(0.1*j);
+        ok = torsoTorqueControl->setTorquePid(j,previousPids[j]) && ok;
+    }
+
+    PIDList gains(joints.size());
+    for(int i = 0; i < (int)joints.size(); i++)
+    {
+        gains.pidList()[i].setKp(10.0*(i+1));
+        gains.pidList()[i].setKd(1.0*(i+1));
+    }
+    if( ok && actuators.applyGainSchedule(gains) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: the schedule refused by the left leg was applied\n",test);
+        ok = false;
+    }
+
+    ok = ok && torsoTorqueControl->getTorquePids(&pids[0]);
+    for(int j = 0; ok && j < nrOfTorsoAxes; j++)
+    {
+        if( fabs(pids[j].kp-previousPids[j].kp) > TOL || fabs(pids[j].kd-previousPids[j].kd) > TOL )
+        {
+            fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s: torso axis %d has kp %lf and kd %lf instead of %lf and %lf\n",
+                    test,j,pids[j].kp,pids[j].kd,previousPids[j].kp,previousPids[j].kd);
+            ok = false;
+        }
+    }
+
+    if( !ok )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: %s failed\n",test);
+    }
+
+    ok = actuators.close() && ok;
+    return ok;
+}
+
+int main(int argc, char * argv[])
+{
+    Network::setLocalMode(true);
+    Network yarpNet;
+
+    fakeControlBoardConfiguration torsoConf, legConf;
+    torsoConf.nrOfAxes = 3;
+    legConf.nrOfAxes = 6;
+    torsoConf.updatePeriod = legConf.updatePeriod = UPDATE_PERIOD;
+    fakeControlBoard::setPartConfiguration("fakeRobot","torso",torsoConf);
+    fakeControlBoard::setPartConfiguration("fakeRobot","left_leg",legConf);
+    fakeControlBoard::setPartConfiguration(SHARED_DRIVERS_ROBOT,"torso",torsoConf);
+    fakeControlBoard::setPartConfiguration(SHARED_DRIVERS_ROBOT,"left_leg",legConf);
+
+    fakeControlBoardConfiguration rejectingLegConf(legConf);
+    rejectingLegConf.rejectTorquePids = true;
+    fakeControlBoard::setPartConfiguration(REJECTING_PIDS_ROBOT,"torso",torsoConf);
+    fakeControlBoard::setPartConfiguration(REJECTING_PIDS_ROBOT,"left_leg",rejectingLegConf);
+    registerFakeControlBoardDevice();
+
+    Property options = getOptions("");
+    IDList joints;
+    if( !loadIdListFromConfig("ACTUATORS_TEST_JOINTS",options,joints) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: impossible to load the joint list\n");
+        return EXIT_FAILURE;
+    }
+
+    yarpWholeBodySensors sensors("actuatorsTestSensors",options);
+    sensors.addSensors(SENSOR_ENCODER_POS,joints);
+    sensors.addSensors(SENSOR_TORQUE,joints);
+    if( !sensors.init() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyActuatorsTest: impossible to open the sensors\n");
+        return EXIT_FAILURE;
+    }
+
+    bool ok = testCommandPlan(sensors,joints);
+    ok = testReferenceDeduplication(sensors,joints) && ok;
+    ok = testNonBlockingControlReference(sensors,joints) && ok;
+    ok = testSharedDrivers(joints) && ok;
+    ok = testGainScheduleRollback(joints) && ok;
+
+    ok = sensors.close() && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
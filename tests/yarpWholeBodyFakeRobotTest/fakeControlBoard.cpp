@@ -0,0 +1,1201 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#include "fakeControlBoard.h"
+
+#include <yarp/dev/Drivers.h>
+#include <yarp/os/LockGuard.h>
+#include <yarp/os/Log.h>
+#include <yarp/os/Time.h>
+
+#include <map>
+#include <cmath>
+
+using namespace yarp::os;
+using namespace yarp::dev;
+using namespace yarpWbi;
+
+namespace yarpWbi
+{
+    /**
+     * State of a part of the fake robot, shared by all the fakeControlBoard
+     * devices opened for the same robot and part.
+     */
+    class fakeControlBoardState
+    {
+    public:
+        fakeControlBoardConfiguration conf;
+        yarp::os::Mutex mutex;
+        int users;
+
+        double lastUpdate;
+        std::vector<double> q, dq, ddq;
+        std::vector<int> controlModes;
+        std::vector<InteractionModeEnum> interactionModes;
+        std::vector<double> positionRefs, positionDirectRefs, velocityRefs, torqueRefs, outputRefs;
+        std::vector<double> refSpeeds, refAccelerations;
+        std::vector<double> stiffness, damping, impedanceOffsets;
+        std::vector<double> minLimits, maxLimits, minVelLimits, maxVelLimits;
+        std::vector<double> torqueErrorLimits;
+        std::vector<Pid> torquePids, velocityPids;
+        std::vector<MotorTorqueParameters> motorTorqueParameters;
+
+        fakeControlBoardState(const fakeControlBoardConfiguration & _conf): conf(_conf), users(0), lastUpdate(Time::now())
+        {
+            int n = conf.nrOfAxes;
+            q.assign(n,0.0); dq.assign(n,0.0); ddq.assign(n,0.0);
+            controlModes.assign(n,VOCAB_CM_POSITION);
+            interactionModes.assign(n,VOCAB_IM_STIFF);
+            positionRefs.assign(n,0.0); positionDirectRefs.assign(n,0.0);
+            velocityRefs.assign(n,0.0); torqueRefs.assign(n,0.0); outputRefs.assign(n,0.0);
+            refSpeeds.assign(n,10.0); refAccelerations.assign(n,100.0);
+            stiffness.assign(n,0.0); damping.assign(n,0.0); impedanceOffsets.assign(n,0.0);
+            minLimits.assign(n,-180.0); maxLimits.assign(n,180.0);
+            minVelLimits.assign(n,-100.0); maxVelLimits.assign(n,100.0);
+            torqueErrorLimits.assign(n,0.0);
+            torquePids.resize(n); velocityPids.resize(n);
+            motorTorqueParameters.resize(n);
+        }
+
+        /** Update the state, if at least updatePeriod seconds passed since the last update */
+        void update(double now)
+        {
+            // the state is created when the first device is opened, so also the
+            // references sent before the first read are applied at the first update
+            double dt = now - lastUpdate;
+            if( dt < conf.updatePeriod )
+            {
+                return;
+            }
+
+            for(int j = 0; j < conf.nrOfAxes; j++)
+            {
+                double oldQ = q[j], oldDq = dq[j];
+                switch( controlModes[j] )
+                {
+                case VOCAB_CM_POSITION_DIRECT:
+                    q[j] = positionDirectRefs[j];
+                    break;
+                case VOCAB_CM_VELOCITY:
+                    q[j] += velocityRefs[j]*dt;
+                    break;
+                case VOCAB_CM_POSITION:
+                    {
+                        double step = refSpeeds[j]*dt;
+                        double error = positionRefs[j]-q[j];
+                        q[j] = (fabs(error) <= step) ? positionRefs[j] : q[j] + (error > 0 ? step : -step);
+                    }
+                    break;
+                default:
+                    break;
+                }
+                dq[j] = (q[j]-oldQ)/dt;
+                ddq[j] = (dq[j]-oldDq)/dt;
+            }
+
+            lastUpdate = now;
+        }
+    };
+}
+
+namespace
+{
+    yarp::os::Mutex registryMutex;
+    std::map<std::string, fakeControlBoardConfiguration> partConfigurations;
+    std::map<std::string, fakeControlBoardState *> partStates;
+
+    bool copyAll(const std::vector<double> & from, double * to)
+    {
+        for(size_t j = 0; j < from.size(); j++) to[j] = from[j];
+        return true;
+    }
+
+    bool setAll(std::vector<double> & to, const double * from)
+    {
+        for(size_t j = 0; j < to.size(); j++) to[j] = from[j];
+        return true;
+    }
+
+    bool setSome(std::vector<double> & to, const int n_joint, const int * joints, const double * from)
+    {
+        for(int i = 0; i < n_joint; i++)
+        {
+            if( joints[i] < 0 || joints[i] >= (int)to.size() ) return false;
+            to[joints[i]] = from[i];
+        }
+        return true;
+    }
+
+    bool getSome(const std::vector<double> & from, const int n_joint, const int * joints, double * to)
+    {
+        for(int i = 0; i < n_joint; i++)
+        {
+            if( joints[i] < 0 || joints[i] >= (int)from.size() ) return false;
+            to[i] = from[joints[i]];
+        }
+        return true;
+    }
+}
+
+void fakeControlBoard::setPartConfiguration(const std::string & robot, const std::string & part,
+                                            const fakeControlBoardConfiguration & conf)
+{
+    LockGuard guard(registryMutex);
+    partConfigurations["/" + robot + "/" + part] = conf;
+}
+
+int fakeControlBoard::getNrOfOpenDevices(const std::string & robot, const std::string & part)
+{
+    LockGuard guard(registryMutex);
+    std::map<std::string, fakeControlBoardState *>::iterator it = partStates.find("/" + robot + "/" + part);
+    return (it == partStates.end()) ? 0 : it->second->users;
+}
+
+void yarpWbi::registerFakeControlBoardDevice()
+{
+    Drivers::factory().add(new DriverCreatorOf<fakeControlBoard>("fakeControlBoard",
+                                                                 "controlboardwrapper2",
+                                                                 "fakeControlBoard"));
+}
+
+fakeControlBoard::fakeControlBoard(): state(0)
+{
+}
+
+fakeControlBoard::~fakeControlBoard()
+{
+    close();
+}
+
+bool fakeControlBoard::open(yarp::os::Searchable & config)
+{
+    std::string robot = config.check("robot",Value("fakeRobot")).asString().c_str();
+    std::string part = config.check("part",Value("part")).asString().c_str();
+    std::string key = "/" + robot + "/" + part;
+
+    LockGuard guard(registryMutex);
+    if( partStates.find(key) == partStates.end() )
+    {
+        fakeControlBoardConfiguration conf;
+        if( partConfigurations.find(key) != partConfigurations.end() )
+        {
+            conf = partConfigurations[key];
+        }
+        else
+        {
+            yWarning("fakeControlBoard: no configuration found for %s, using a single axis", key.c_str());
+        }
+        partStates[key] = new fakeControlBoardState(conf);
+    }
+    state = partStates[key];
+    state->users++;
+    return true;
+}
+
+bool fakeControlBoard::close()
+{
+    if( !state )
+    {
+        return true;
+    }
+
+    LockGuard guard(registryMutex);
+    state->users--;
+    if( state->users == 0 )
+    {
+        for(std::map<std::string, fakeControlBoardState *>::iterator it = partStates.begin();
+            it != partStates.end(); it++)
+        {
+            if( it->second == state )
+            {
+                partStates.erase(it);
+                break;
+            }
+        }
+        delete state;
+    }
+    state = 0;
+    return true;
+}
+
+bool fakeControlBoard::read() const
+{
+    if( state->conf.readLatency > 0.0 )
+    {
+        Time::delay(state->conf.readLatency);
+    }
+    state->update(Time::now());
+    return true;
+}
+
+bool fakeControlBoard::command() const
+{
+    if( state->conf.commandLatency > 0.0 )
+    {
+        Time::delay(state->conf.commandLatency);
+    }
+    return true;
+}
+
+bool fakeControlBoard::validAxis(int j) const
+{
+    return j >= 0 && j < state->conf.nrOfAxes;
+}
+
+// *********************************** IEncodersTimed ***********************************
+bool fakeControlBoard::getAxes(int *ax)
+{
+    *ax = state->conf.nrOfAxes;
+    return true;
+}
+
+bool fakeControlBoard::resetEncoder(int j) { return setEncoder(j,0.0); }
+
+bool fakeControlBoard::resetEncoders()
+{
+    LockGuard guard(state->mutex);
+    state->q.assign(state->conf.nrOfAxes,0.0);
+    return true;
+}
+
+bool fakeControlBoard::setEncoder(int j, double val)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    state->q[j] = val;
+    return true;
+}
+
+bool fakeControlBoard::setEncoders(const double *vals)
+{
+    LockGuard guard(state->mutex);
+    return setAll(state->q,vals);
+}
+
+bool fakeControlBoard::getEncoder(int j, double *v)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    read();
+    *v = state->q[j];
+    return true;
+}
+
+bool fakeControlBoard::getEncoders(double *encs)
+{
+    LockGuard guard(state->mutex);
+    read();
+    return copyAll(state->q,encs);
+}
+
+bool fakeControlBoard::getEncoderSpeed(int j, double *sp)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    read();
+    *sp = state->dq[j];
+    return true;
+}
+
+bool fakeControlBoard::getEncoderSpeeds(double *spds)
+{
+    LockGuard guard(state->mutex);
+    read();
+    return copyAll(state->dq,spds);
+}
+
+bool fakeControlBoard::getEncoderAcceleration(int j, double *acc)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    read();
+    *acc = state->ddq[j];
+    return true;
+}
+
+bool fakeControlBoard::getEncoderAccelerations(double *accs)
+{
+    LockGuard guard(state->mutex);
+    read();
+    return copyAll(state->ddq,accs);
+}
+
+bool fakeControlBoard::getEncodersTimed(double *encs, double *time)
+{
+    LockGuard guard(state->mutex);
+    read();
+    for(int j = 0; j < state->conf.nrOfAxes; j++)
+    {
+        time[j] = state->lastUpdate;
+    }
+    return copyAll(state->q,encs);
+}
+
+bool fakeControlBoard::getEncoderTimed(int j, double *enc, double *time)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    read();
+    *enc = state->q[j];
+    *time = state->lastUpdate;
+    return true;
+}
+
+// *********************************** ITorqueControl ***********************************
+bool fakeControlBoard::setTorqueMode()
+{
+    LockGuard guard(state->mutex);
+    command();
+    state->controlModes.assign(state->conf.nrOfAxes,VOCAB_CM_TORQUE);
+    return true;
+}
+
+bool fakeControlBoard::getRefTorques(double *t)
+{
+    LockGuard guard(state->mutex);
+    return copyAll(state->torqueRefs,t);
+}
+
+bool fakeControlBoard::getRefTorque(int j, double *t)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *t = state->torqueRefs[j];
+    return true;
+}
+
+bool fakeControlBoard::setRefTorques(const double *t)
+{
+    LockGuard guard(state->mutex);
+    command();
+    return setAll(state->torqueRefs,t);
+}
+
+bool fakeControlBoard::setRefTorque(int j, double t)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->torqueRefs[j] = t;
+    return true;
+}
+
+bool fakeControlBoard::setRefTorques(const int n_joint, const int *joints, const double *t)
+{
+    LockGuard guard(state->mutex);
+    command();
+    return setSome(state->torqueRefs,n_joint,joints,t);
+}
+
+bool fakeControlBoard::getBemfParam(int j, double *bemf)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *bemf = state->motorTorqueParameters[j].bemf;
+    return true;
+}
+
+bool fakeControlBoard::setBemfParam(int j, double bemf)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->motorTorqueParameters[j].bemf = bemf;
+    return true;
+}
+
+bool fakeControlBoard::getMotorTorqueParams(int j, MotorTorqueParameters *params)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *params = state->motorTorqueParameters[j];
+    return true;
+}
+
+bool fakeControlBoard::setMotorTorqueParams(int j, const MotorTorqueParameters params)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->motorTorqueParameters[j] = params;
+    return true;
+}
+
+bool fakeControlBoard::setTorquePid(int j, const Pid &pid)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    if( state->conf.rejectTorquePids ) return false;
+    state->torquePids[j] = pid;
+    return true;
+}
+
+bool fakeControlBoard::getTorque(int j, double *t)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    read();
+    *t = (state->controlModes[j] == VOCAB_CM_TORQUE) ? state->torqueRefs[j] : 0.0;
+    return true;
+}
+
+bool fakeControlBoard::getTorques(double *t)
+{
+    LockGuard guard(state->mutex);
+    read();
+    for(int j = 0; j < state->conf.nrOfAxes; j++)
+    {
+        t[j] = (state->controlModes[j] == VOCAB_CM_TORQUE) ? state->torqueRefs[j] : 0.0;
+    }
+    return true;
+}
+
+bool fakeControlBoard::getTorqueRange(int j, double *min, double *max)
+{
+    if( !validAxis(j) ) return false;
+    *min = -100.0;
+    *max = 100.0;
+    return true;
+}
+
+bool fakeControlBoard::getTorqueRanges(double *min, double *max)
+{
+    for(int j = 0; j < state->conf.nrOfAxes; j++)
+    {
+        getTorqueRange(j,min+j,max+j);
+    }
+    return true;
+}
+
+bool fakeControlBoard::setTorquePids(const Pid *pids)
+{
+    LockGuard guard(state->mutex);
+    command();
+    if( state->conf.rejectTorquePids ) return false;
+    for(int j = 0; j < state->conf.nrOfAxes; j++)
+    {
+        state->torquePids[j] = pids[j];
+    }
+    return true;
+}
+
+bool fakeControlBoard::setTorqueErrorLimit(int j, double limit)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    state->torqueErrorLimits[j] = limit;
+    return true;
+}
+
+bool fakeControlBoard::setTorqueErrorLimits(const double *limits)
+{
+    LockGuard guard(state->mutex);
+    return setAll(state->torqueErrorLimits,limits);
+}
+
+bool fakeControlBoard::getTorqueError(int j, double *err)
+{
+    if( !validAxis(j) ) return false;
+    *err = 0.0;
+    return true;
+}
+
+bool fakeControlBoard::getTorqueErrors(double *errs)
+{
+    for(int j = 0; j < state->conf.nrOfAxes; j++) errs[j] = 0.0;
+    return true;
+}
+
+bool fakeControlBoard::getTorquePidOutput(int j, double *out)
+{
+    return getOutput(j,out);
+}
+
+bool fakeControlBoard::getTorquePidOutputs(double *outs)
+{
+    return getOutputs(outs);
+}
+
+bool fakeControlBoard::getTorquePid(int j, Pid *pid)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *pid = state->torquePids[j];
+    return true;
+}
+
+bool fakeControlBoard::getTorquePids(Pid *pids)
+{
+    LockGuard guard(state->mutex);
+    for(int j = 0; j < state->conf.nrOfAxes; j++)
+    {
+        pids[j] = state->torquePids[j];
+    }
+    return true;
+}
+
+bool fakeControlBoard::getTorqueErrorLimit(int j, double *limit)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *limit = state->torqueErrorLimits[j];
+    return true;
+}
+
+bool fakeControlBoard::getTorqueErrorLimits(double *limits)
+{
+    LockGuard guard(state->mutex);
+    return copyAll(state->torqueErrorLimits,limits);
+}
+
+bool fakeControlBoard::resetTorquePid(int j) { return validAxis(j); }
+bool fakeControlBoard::disableTorquePid(int j) { return validAxis(j); }
+bool fakeControlBoard::enableTorquePid(int j) { return validAxis(j); }
+bool fakeControlBoard::setTorqueOffset(int j, double v) { return validAxis(j); }
+
+// *********************************** IPositionControl2 ***********************************
+bool fakeControlBoard::setPositionMode()
+{
+    LockGuard guard(state->mutex);
+    command();
+    state->controlModes.assign(state->conf.nrOfAxes,VOCAB_CM_POSITION);
+    return true;
+}
+
+bool fakeControlBoard::positionMove(int j, double ref)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->positionRefs[j] = ref;
+    return true;
+}
+
+bool fakeControlBoard::positionMove(const double *refs)
+{
+    LockGuard guard(state->mutex);
+    command();
+    return setAll(state->positionRefs,refs);
+}
+
+bool fakeControlBoard::positionMove(const int n_joint, const int *joints, const double *refs)
+{
+    LockGuard guard(state->mutex);
+    command();
+    return setSome(state->positionRefs,n_joint,joints,refs);
+}
+
+bool fakeControlBoard::relativeMove(int j, double delta)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->positionRefs[j] += delta;
+    return true;
+}
+
+bool fakeControlBoard::relativeMove(const double *deltas)
+{
+    LockGuard guard(state->mutex);
+    command();
+    for(int j = 0; j < state->conf.nrOfAxes; j++) state->positionRefs[j] += deltas[j];
+    return true;
+}
+
+bool fakeControlBoard::relativeMove(const int n_joint, const int *joints, const double *deltas)
+{
+    LockGuard guard(state->mutex);
+    command();
+    for(int i = 0; i < n_joint; i++)
+    {
+        if( !validAxis(joints[i]) ) return false;
+        state->positionRefs[joints[i]] += deltas[i];
+    }
+    return true;
+}
+
+bool fakeControlBoard::checkMotionDone(int j, bool *flag)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    read();
+    *flag = (state->q[j] == state->positionRefs[j]);
+    return true;
+}
+
+bool fakeControlBoard::checkMotionDone(bool *flag)
+{
+    LockGuard guard(state->mutex);
+    read();
+    *flag = (state->q == state->positionRefs);
+    return true;
+}
+
+bool fakeControlBoard::checkMotionDone(const int n_joint, const int *joints, bool *flags)
+{
+    LockGuard guard(state->mutex);
+    read();
+    bool done = true;
+    for(int i = 0; i < n_joint; i++)
+    {
+        if( !validAxis(joints[i]) ) return false;
+        done = done && (state->q[joints[i]] == state->positionRefs[joints[i]]);
+    }
+    *flags = done;
+    return true;
+}
+
+bool fakeControlBoard::setRefSpeed(int j, double sp)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->refSpeeds[j] = sp;
+    return true;
+}
+
+bool fakeControlBoard::setRefSpeeds(const double *spds)
+{
+    LockGuard guard(state->mutex);
+    command();
+    return setAll(state->refSpeeds,spds);
+}
+
+bool fakeControlBoard::setRefSpeeds(const int n_joint, const int *joints, const double *spds)
+{
+    LockGuard guard(state->mutex);
+    command();
+    return setSome(state->refSpeeds,n_joint,joints,spds);
+}
+
+bool fakeControlBoard::setRefAcceleration(int j, double acc)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->refAccelerations[j] = acc;
+    return true;
+}
+
+bool fakeControlBoard::setRefAccelerations(const double *accs)
+{
+    LockGuard guard(state->mutex);
+    command();
+    return setAll(state->refAccelerations,accs);
+}
+
+bool fakeControlBoard::setRefAccelerations(const int n_joint, const int *joints, const double *accs)
+{
+    LockGuard guard(state->mutex);
+    command();
+    return setSome(state->refAccelerations,n_joint,joints,accs);
+}
+
+bool fakeControlBoard::getRefSpeed(int j, double *ref)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *ref = state->refSpeeds[j];
+    return true;
+}
+
+bool fakeControlBoard::getRefSpeeds(double *spds)
+{
+    LockGuard guard(state->mutex);
+    return copyAll(state->refSpeeds,spds);
+}
+
+bool fakeControlBoard::getRefSpeeds(const int n_joint, const int *joints, double *spds)
+{
+    LockGuard guard(state->mutex);
+    return getSome(state->refSpeeds,n_joint,joints,spds);
+}
+
+bool fakeControlBoard::getRefAcceleration(int j, double *acc)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *acc = state->refAccelerations[j];
+    return true;
+}
+
+bool fakeControlBoard::getRefAccelerations(double *accs)
+{
+    LockGuard guard(state->mutex);
+    return copyAll(state->refAccelerations,accs);
+}
+
+bool fakeControlBoard::getRefAccelerations(const int n_joint, const int *joints, double *accs)
+{
+    LockGuard guard(state->mutex);
+    return getSome(state->refAccelerations,n_joint,joints,accs);
+}
+
+bool fakeControlBoard::stop(int j)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->positionRefs[j] = state->q[j];
+    state->velocityRefs[j] = 0.0;
+    return true;
+}
+
+bool fakeControlBoard::stop()
+{
+    for(int j = 0; j < state->conf.nrOfAxes; j++)
+    {
+        stop(j);
+    }
+    return true;
+}
+
+bool fakeControlBoard::stop(const int n_joint, const int *joints)
+{
+    bool ok = true;
+    for(int i = 0; i < n_joint; i++)
+    {
+        ok = stop(joints[i]) && ok;
+    }
+    return ok;
+}
+
+// *********************************** IPositionDirect ***********************************
+bool fakeControlBoard::setPositionDirectMode()
+{
+    LockGuard guard(state->mutex);
+    command();
+    state->controlModes.assign(state->conf.nrOfAxes,VOCAB_CM_POSITION_DIRECT);
+    return true;
+}
+
+bool fakeControlBoard::setPosition(int j, double ref)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->positionDirectRefs[j] = ref;
+    return true;
+}
+
+bool fakeControlBoard::setPositions(const int n_joint, const int *joints, double *refs)
+{
+    return setPositions(n_joint,joints,(const double *)refs);
+}
+
+bool fakeControlBoard::setPositions(const int n_joint, const int *joints, const double *refs)
+{
+    LockGuard guard(state->mutex);
+    command();
+    return setSome(state->positionDirectRefs,n_joint,joints,refs);
+}
+
+bool fakeControlBoard::setPositions(const double *refs)
+{
+    LockGuard guard(state->mutex);
+    command();
+    return setAll(state->positionDirectRefs,refs);
+}
+
+// *********************************** IVelocityControl2 ***********************************
+bool fakeControlBoard::setVelocityMode()
+{
+    LockGuard guard(state->mutex);
+    command();
+    state->controlModes.assign(state->conf.nrOfAxes,VOCAB_CM_VELOCITY);
+    return true;
+}
+
+bool fakeControlBoard::velocityMove(int j, double sp)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->velocityRefs[j] = sp;
+    return true;
+}
+
+bool fakeControlBoard::velocityMove(const double *sp)
+{
+    LockGuard guard(state->mutex);
+    command();
+    return setAll(state->velocityRefs,sp);
+}
+
+bool fakeControlBoard::velocityMove(const int n_joint, const int *joints, const double *spds)
+{
+    LockGuard guard(state->mutex);
+    command();
+    return setSome(state->velocityRefs,n_joint,joints,spds);
+}
+
+bool fakeControlBoard::getRefVelocity(const int joint, double *vel)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(joint) ) return false;
+    *vel = state->velocityRefs[joint];
+    return true;
+}
+
+bool fakeControlBoard::getRefVelocities(double *vels)
+{
+    LockGuard guard(state->mutex);
+    return copyAll(state->velocityRefs,vels);
+}
+
+bool fakeControlBoard::getRefVelocities(const int n_joint, const int *joints, double *vels)
+{
+    LockGuard guard(state->mutex);
+    return getSome(state->velocityRefs,n_joint,joints,vels);
+}
+
+bool fakeControlBoard::setVelPid(int j, const Pid &pid)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->velocityPids[j] = pid;
+    return true;
+}
+
+bool fakeControlBoard::setVelPids(const Pid *pids)
+{
+    LockGuard guard(state->mutex);
+    command();
+    for(int j = 0; j < state->conf.nrOfAxes; j++) state->velocityPids[j] = pids[j];
+    return true;
+}
+
+bool fakeControlBoard::getVelPid(int j, Pid *pid)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *pid = state->velocityPids[j];
+    return true;
+}
+
+bool fakeControlBoard::getVelPids(Pid *pids)
+{
+    LockGuard guard(state->mutex);
+    for(int j = 0; j < state->conf.nrOfAxes; j++) pids[j] = state->velocityPids[j];
+    return true;
+}
+
+// *********************************** IControlMode2 ***********************************
+bool fakeControlBoard::setPositionMode(int j) { return setControlMode(j,VOCAB_CM_POSITION); }
+bool fakeControlBoard::setVelocityMode(int j) { return setControlMode(j,VOCAB_CM_VELOCITY); }
+bool fakeControlBoard::setTorqueMode(int j) { return setControlMode(j,VOCAB_CM_TORQUE); }
+bool fakeControlBoard::setImpedancePositionMode(int j) { return setControlMode(j,VOCAB_CM_IMPEDANCE_POS); }
+bool fakeControlBoard::setImpedanceVelocityMode(int j) { return setControlMode(j,VOCAB_CM_IMPEDANCE_VEL); }
+bool fakeControlBoard::setOpenLoopMode(int j) { return setControlMode(j,VOCAB_CM_OPENLOOP); }
+
+bool fakeControlBoard::getControlMode(int j, int *mode)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *mode = state->controlModes[j];
+    return true;
+}
+
+bool fakeControlBoard::getControlModes(int *modes)
+{
+    LockGuard guard(state->mutex);
+    for(int j = 0; j < state->conf.nrOfAxes; j++) modes[j] = state->controlModes[j];
+    return true;
+}
+
+bool fakeControlBoard::getControlModes(const int n_joint, const int *joints, int *modes)
+{
+    LockGuard guard(state->mutex);
+    for(int i = 0; i < n_joint; i++)
+    {
+        if( !validAxis(joints[i]) ) return false;
+        modes[i] = state->controlModes[joints[i]];
+    }
+    return true;
+}
+
+bool fakeControlBoard::setControlMode(const int j, const int mode)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    // as the real boards, the position references are reset to the current position
+    state->positionRefs[j] = state->q[j];
+    state->positionDirectRefs[j] = state->q[j];
+    state->controlModes[j] = mode;
+    return true;
+}
+
+bool fakeControlBoard::setControlModes(const int n_joint, const int *joints, int *modes)
+{
+    LockGuard guard(state->mutex);
+    command();
+    for(int i = 0; i < n_joint; i++)
+    {
+        int j = joints[i];
+        if( !validAxis(j) ) return false;
+        state->positionRefs[j] = state->q[j];
+        state->positionDirectRefs[j] = state->q[j];
+        state->controlModes[j] = modes[i];
+    }
+    return true;
+}
+
+bool fakeControlBoard::setControlModes(int *modes)
+{
+    LockGuard guard(state->mutex);
+    command();
+    for(int j = 0; j < state->conf.nrOfAxes; j++)
+    {
+        state->positionRefs[j] = state->q[j];
+        state->positionDirectRefs[j] = state->q[j];
+        state->controlModes[j] = modes[j];
+    }
+    return true;
+}
+
+// *********************************** IOpenLoopControl ***********************************
+bool fakeControlBoard::setRefOutput(int j, double v)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->outputRefs[j] = v;
+    return true;
+}
+
+bool fakeControlBoard::setRefOutputs(const double *v)
+{
+    LockGuard guard(state->mutex);
+    command();
+    return setAll(state->outputRefs,v);
+}
+
+bool fakeControlBoard::getRefOutput(int j, double *v)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *v = state->outputRefs[j];
+    return true;
+}
+
+bool fakeControlBoard::getRefOutputs(double *v)
+{
+    LockGuard guard(state->mutex);
+    return copyAll(state->outputRefs,v);
+}
+
+bool fakeControlBoard::getOutput(int j, double *v)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    read();
+    *v = (state->controlModes[j] == VOCAB_CM_OPENLOOP) ? state->outputRefs[j] : 0.0;
+    return true;
+}
+
+bool fakeControlBoard::getOutputs(double *v)
+{
+    LockGuard guard(state->mutex);
+    read();
+    for(int j = 0; j < state->conf.nrOfAxes; j++)
+    {
+        v[j] = (state->controlModes[j] == VOCAB_CM_OPENLOOP) ? state->outputRefs[j] : 0.0;
+    }
+    return true;
+}
+
+bool fakeControlBoard::setOpenLoopMode()
+{
+    LockGuard guard(state->mutex);
+    command();
+    state->controlModes.assign(state->conf.nrOfAxes,VOCAB_CM_OPENLOOP);
+    return true;
+}
+
+// *********************************** IImpedanceControl ***********************************
+bool fakeControlBoard::getImpedance(int j, double *stiffness, double *damping)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *stiffness = state->stiffness[j];
+    *damping = state->damping[j];
+    return true;
+}
+
+bool fakeControlBoard::setImpedance(int j, double stiffness, double damping)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->stiffness[j] = stiffness;
+    state->damping[j] = damping;
+    return true;
+}
+
+bool fakeControlBoard::setImpedanceOffset(int j, double offset)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->impedanceOffsets[j] = offset;
+    return true;
+}
+
+bool fakeControlBoard::getImpedanceOffset(int j, double *offset)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *offset = state->impedanceOffsets[j];
+    return true;
+}
+
+bool fakeControlBoard::getCurrentImpedanceLimit(int j, double *min_stiff, double *max_stiff, double *min_damp, double *max_damp)
+{
+    if( !validAxis(j) ) return false;
+    *min_stiff = 0.0; *max_stiff = 10.0;
+    *min_damp = 0.0; *max_damp = 1.0;
+    return true;
+}
+
+// *********************************** IInteractionMode ***********************************
+bool fakeControlBoard::getInteractionMode(int j, InteractionModeEnum *mode)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *mode = state->interactionModes[j];
+    return true;
+}
+
+bool fakeControlBoard::getInteractionModes(int n_joints, int *joints, InteractionModeEnum *modes)
+{
+    LockGuard guard(state->mutex);
+    for(int i = 0; i < n_joints; i++)
+    {
+        if( !validAxis(joints[i]) ) return false;
+        modes[i] = state->interactionModes[joints[i]];
+    }
+    return true;
+}
+
+bool fakeControlBoard::getInteractionModes(InteractionModeEnum *modes)
+{
+    LockGuard guard(state->mutex);
+    for(int j = 0; j < state->conf.nrOfAxes; j++) modes[j] = state->interactionModes[j];
+    return true;
+}
+
+bool fakeControlBoard::setInteractionMode(int j, InteractionModeEnum mode)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    command();
+    state->interactionModes[j] = mode;
+    return true;
+}
+
+bool fakeControlBoard::setInteractionModes(int n_joints, int *joints, InteractionModeEnum *modes)
+{
+    LockGuard guard(state->mutex);
+    command();
+    for(int i = 0; i < n_joints; i++)
+    {
+        if( !validAxis(joints[i]) ) return false;
+        state->interactionModes[joints[i]] = modes[i];
+    }
+    return true;
+}
+
+bool fakeControlBoard::setInteractionModes(InteractionModeEnum *modes)
+{
+    LockGuard guard(state->mutex);
+    command();
+    for(int j = 0; j < state->conf.nrOfAxes; j++) state->interactionModes[j] = modes[j];
+    return true;
+}
+
+// *********************************** IControlLimits ***********************************
+bool fakeControlBoard::setLimits(int j, double min, double max)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    state->minLimits[j] = min;
+    state->maxLimits[j] = max;
+    return true;
+}
+
+bool fakeControlBoard::getLimits(int j, double *min, double *max)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    read();
+    *min = state->minLimits[j];
+    *max = state->maxLimits[j];
+    return true;
+}
+
+bool fakeControlBoard::setVelLimits(int j, double min, double max)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    state->minVelLimits[j] = min;
+    state->maxVelLimits[j] = max;
+    return true;
+}
+
+bool fakeControlBoard::getVelLimits(int j, double *min, double *max)
+{
+    LockGuard guard(state->mutex);
+    if( !validAxis(j) ) return false;
+    *min = state->minVelLimits[j];
+    *max = state->maxVelLimits[j];
+    return true;
+}
+
+// *********************************** fakeSensorPort ***********************************
+fakeSensorPort::fakeSensorPort(const std::string & _portName, const int period_in_ms, const int measureSize):
+RateThread(period_in_ms), portName(_portName), measure(measureSize,0.0)
+{
+}
+
+bool fakeSensorPort::threadInit()
+{
+    return port.open(portName.c_str());
+}
+
+void fakeSensorPort::run()
+{
+    yarp::sig::Vector & output = port.prepare();
+    measureMutex.lock();
+    output = measure;
+    measureMutex.unlock();
+    port.write();
+}
+
+void fakeSensorPort::threadRelease()
+{
+    port.close();
+}
+
+void fakeSensorPort::setMeasure(const yarp::sig::Vector & newMeasure)
+{
+    LockGuard guard(measureMutex);
+    measure = newMeasure;
+}
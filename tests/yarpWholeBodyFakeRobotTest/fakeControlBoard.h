@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+#ifndef WBI_FAKE_CONTROLBOARD_H
+#define WBI_FAKE_CONTROLBOARD_H
+
+#include <yarp/dev/DeviceDriver.h>
+#include <yarp/dev/ControlBoardInterfaces.h>
+#include <yarp/dev/IVelocityControl2.h>
+#include <yarp/os/BufferedPort.h>
+#include <yarp/os/RateThread.h>
+#include <yarp/os/Mutex.h>
+#include <yarp/sig/Vector.h>
+
+#include <string>
+#include <vector>
+
+namespace yarpWbi
+{
+    /**
+     * Configuration of a part of the fake robot.
+     */
+    struct fakeControlBoardConfiguration
+    {
+        int nrOfAxes;
+        double updatePeriod;   ///< period (in seconds) with which the state of the part is updated
+        double readLatency;    ///< delay (in seconds) added to every read call
+        double commandLatency; ///< delay (in seconds) added to every command call
+        bool rejectTorquePids; ///< if true, setTorquePid and setTorquePids fail without changing the gains
+
+        fakeControlBoardConfiguration(): nrOfAxes(1), updatePeriod(0.001), readLatency(0.0), commandLatency(0.0),
+                                         rejectTorquePids(false) {}
+    };
+
+    class fakeControlBoardState;
+
+    /**
+     * In-process fake control board, to be used for testing and benchmarking
+     * yarpWholeBodySensors and yarpWholeBodyActuators without a robot or a simulator.
+     *
+     * The device is registered with the name fakeControlBoard (see registerFakeControlBoardDevice)
+     * and it can be used by setting the controlBoardDevice option of the yarpWholeBodyInterface
+     * configuration. All the devices opened for the same robot and part share
+     * the same state, so a reference sent by yarpWholeBodyActuators can be read
+     * by yarpWholeBodySensors.
+     *
+     * The state is updated every updatePeriod seconds: in position direct mode the
+     * position is set to the reference, in position and velocity mode it is integrated,
+     * while in torque and open loop mode the measured torque and pwm are equal to the references.
+     */
+    class fakeControlBoard: public yarp::dev::DeviceDriver,
+                            public yarp::dev::IEncodersTimed,
+                            public yarp::dev::ITorqueControl,
+                            public yarp::dev::IPositionControl2,
+                            public yarp::dev::IPositionDirect,
+                            public yarp::dev::IVelocityControl2,
+                            public yarp::dev::IControlMode2,
+                            public yarp::dev::IOpenLoopControl,
+                            public yarp::dev::IImpedanceControl,
+                            public yarp::dev::IInteractionMode,
+                            public yarp::dev::IControlLimits
+    {
+    private:
+        fakeControlBoardState * state;
+
+        bool read() const;    // update the state and apply the read latency
+        bool command() const; // apply the command latency
+        bool validAxis(int j) const;
+
+    public:
+        fakeControlBoard();
+        virtual ~fakeControlBoard();
+
+        /**
+         * Set the configuration used by the devices opened for a given robot and part.
+         * @note it should be called before opening the devices.
+         */
+        static void setPartConfiguration(const std::string & robot, const std::string & part,
+                                         const fakeControlBoardConfiguration & conf);
+
+        /**
+         * Get the number of devices currently open for a given robot and part.
+         */
+        static int getNrOfOpenDevices(const std::string & robot, const std::string & part);
+
+        // DeviceDriver
+        virtual bool open(yarp::os::Searchable & config);
+        virtual bool close();
+
+        // IEncodersTimed
+        virtual bool getAxes(int *ax);
+        virtual bool resetEncoder(int j);
+        virtual bool resetEncoders();
+        virtual bool setEncoder(int j, double val);
+        virtual bool setEncoders(const double *vals);
+        virtual bool getEncoder(int j, double *v);
+        virtual bool getEncoders(double *encs);
+        virtual bool getEncoderSpeed(int j, double *sp);
+        virtual bool getEncoderSpeeds(double *spds);
+        virtual bool getEncoderAcceleration(int j, double *spds);
+        virtual bool getEncoderAccelerations(double *accs);
+        virtual bool getEncodersTimed(double *encs, double *time);
+        virtual bool getEncoderTimed(int j, double *encs, double *time);
+
+        // ITorqueControl
+        virtual bool setTorqueMode();
+        virtual bool getRefTorques(double *t);
+        virtual bool getRefTorque(int j, double *t);
+        virtual bool setRefTorques(const double *t);
+        virtual bool setRefTorque(int j, double t);
+        virtual bool setRefTorques(const int n_joint, const int *joints, const double *t);
+        virtual bool getBemfParam(int j, double *bemf);
+        virtual bool setBemfParam(int j, double bemf);
+        virtual bool getMotorTorqueParams(int j, yarp::dev::MotorTorqueParameters *params);
+        virtual bool setMotorTorqueParams(int j, const yarp::dev::MotorTorqueParameters params);
+        virtual bool setTorquePid(int j, const yarp::dev::Pid &pid);
+        virtual bool getTorque(int j, double *t);
+        virtual bool getTorques(double *t);
+        virtual bool getTorqueRange(int j, double *min, double *max);
+        virtual bool getTorqueRanges(double *min, double *max);
+        virtual bool setTorquePids(const yarp::dev::Pid *pids);
+        virtual bool setTorqueErrorLimit(int j, double limit);
+        virtual bool setTorqueErrorLimits(const double *limits);
+        virtual bool getTorqueError(int j, double *err);
+        virtual bool getTorqueErrors(double *errs);
+        virtual bool getTorquePidOutput(int j, double *out);
+        virtual bool getTorquePidOutputs(double *outs);
+        virtual bool getTorquePid(int j, yarp::dev::Pid *pid);
+        virtual bool getTorquePids(yarp::dev::Pid *pids);
+        virtual bool getTorqueErrorLimit(int j, double *limit);
+        virtual bool getTorqueErrorLimits(double *limits);
+        virtual bool resetTorquePid(int j);
+        virtual bool disableTorquePid(int j);
+        virtual bool enableTorquePid(int j);
+        virtual bool setTorqueOffset(int j, double v);
+
+        // IPositionControl2
+        virtual bool setPositionMode();
+        virtual bool positionMove(int j, double ref);
+        virtual bool positionMove(const double *refs);
+        virtual bool positionMove(const int n_joint, const int *joints, const double *refs);
+        virtual bool relativeMove(int j, double delta);
+        virtual bool relativeMove(const double *deltas);
+        virtual bool relativeMove(const int n_joint, const int *joints, const double *deltas);
+        virtual bool checkMotionDone(int j, bool *flag);
+        virtual bool checkMotionDone(bool *flag);
+        virtual bool checkMotionDone(const int n_joint, const int *joints, bool *flags);
+        virtual bool setRefSpeed(int j, double sp);
+        virtual bool setRefSpeeds(const double *spds);
+        virtual bool setRefSpeeds(const int n_joint, const int *joints, const double *spds);
+        virtual bool setRefAcceleration(int j, double acc);
+        virtual bool setRefAccelerations(const double *accs);
+        virtual bool setRefAccelerations(const int n_joint, const int *joints, const double *accs);
+        virtual bool getRefSpeed(int j, double *ref);
+        virtual bool getRefSpeeds(double *spds);
+        virtual bool getRefSpeeds(const int n_joint, const int *joints, double *spds);
+        virtual bool getRefAcceleration(int j, double *acc);
+        virtual bool getRefAccelerations(double *accs);
+        virtual bool getRefAccelerations(const int n_joint, const int *joints, double *accs);
+        virtual bool stop(int j);
+        virtual bool stop();
+        virtual bool stop(const int n_joint, const int *joints);
+
+        // IPositionDirect
+        virtual bool setPositionDirectMode();
+        virtual bool setPosition(int j, double ref);
+        virtual bool setPositions(const int n_joint, const int *joints, double *refs);
+        virtual bool setPositions(const int n_joint, const int *joints, const double *refs);
+        virtual bool setPositions(const double *refs);
+
+        // IVelocityControl2
+        virtual bool setVelocityMode();
+        virtual bool velocityMove(int j, double sp);
+        virtual bool velocityMove(const double *sp);
+        virtual bool velocityMove(const int n_joint, const int *joints, const double *spds);
+        virtual bool getRefVelocity(const int joint, double *vel);
+        virtual bool getRefVelocities(double *vels);
+        virtual bool getRefVelocities(const int n_joint, const int *joints, double *vels);
+        virtual bool setVelPid(int j, const yarp::dev::Pid &pid);
+        virtual bool setVelPids(const yarp::dev::Pid *pids);
+        virtual bool getVelPid(int j, yarp::dev::Pid *pid);
+        virtual bool getVelPids(yarp::dev::Pid *pids);
+
+        // IControlMode2
+        virtual bool setPositionMode(int j);
+        virtual bool setVelocityMode(int j);
+        virtual bool setTorqueMode(int j);
+        virtual bool setImpedancePositionMode(int j);
+        virtual bool setImpedanceVelocityMode(int j);
+        virtual bool setOpenLoopMode(int j);
+        virtual bool getControlMode(int j, int *mode);
+        virtual bool getControlModes(int *modes);
+        virtual bool getControlModes(const int n_joint, const int *joints, int *modes);
+        virtual bool setControlMode(const int j, const int mode);
+        virtual bool setControlModes(const int n_joint, const int *joints, int *modes);
+        virtual bool setControlModes(int *modes);
+
+        // IOpenLoopControl
+        virtual bool setRefOutput(int j, double v);
+        virtual bool setRefOutputs(const double *v);
+        virtual bool getRefOutput(int j, double *v);
+        virtual bool getRefOutputs(double *v);
+        virtual bool getOutput(int j, double *v);
+        virtual bool getOutputs(double *v);
+        virtual bool setOpenLoopMode();
+
+        // IImpedanceControl
+        virtual bool getImpedance(int j, double *stiffness, double *damping);
+        virtual bool setImpedance(int j, double stiffness, double damping);
+        virtual bool setImpedanceOffset(int j, double offset);
+        virtual bool getImpedanceOffset(int j, double *offset);
+        virtual bool getCurrentImpedanceLimit(int j, double *min_stiff, double *max_stiff, double *min_damp, double *max_damp);
+
+        // IInteractionMode
+        virtual bool getInteractionMode(int j, yarp::dev::InteractionModeEnum *mode);
+        virtual bool getInteractionModes(int n_joints, int *joints, yarp::dev::InteractionModeEnum *modes);
+        virtual bool getInteractionModes(yarp::dev::InteractionModeEnum *modes);
+        virtual bool setInteractionMode(int j, yarp::dev::InteractionModeEnum mode);
+        virtual bool setInteractionModes(int n_joints, int *joints, yarp::dev::InteractionModeEnum *modes);
+        virtual bool setInteractionModes(yarp::dev::InteractionModeEnum *modes);
+
+        // IControlLimits
+        virtual bool setLimits(int j, double min, double max);
+        virtual bool getLimits(int j, double *min, double *max);
+        virtual bool setVelLimits(int j, double min, double max);
+        virtual bool getVelLimits(int j, double *min, double *max);
+    };
+
+    /**
+     * Register the fakeControlBoard device in the YARP device factory.
+     */
+    void registerFakeControlBoardDevice();
+
+    /**
+     * Thread that periodically publishes a constant yarp::sig::Vector on a port,
+     * to emulate the ports of the F/T sensors and of the IMUs.
+     */
+    class fakeSensorPort: public yarp::os::RateThread
+    {
+    private:
+        yarp::os::BufferedPort<yarp::sig::Vector> port;
+        std::string portName;
+        yarp::sig::Vector measure;
+        yarp::os::Mutex measureMutex;
+
+    public:
+        fakeSensorPort(const std::string & portName, const int period_in_ms, const int measureSize);
+
+        virtual bool threadInit();
+        virtual void run();
+        virtual void threadRelease();
+
+        void setMeasure(const yarp::sig::Vector & newMeasure);
+    };
+}
+
+#endif
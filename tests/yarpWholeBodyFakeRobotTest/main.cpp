@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+ * Open yarpWholeBodySensors and yarpWholeBodyActuators against the in-process
+ * fakeControlBoard, check that the references sent are read back and
+ * measure the overhead of the wrapper for each read and command.
+ */
+
+#include "fakeControlBoard.h"
+
+#include <yarpWholeBodyInterface/yarpWholeBodySensors.h>
+#include <yarpWholeBodyInterface/yarpWholeBodyActuators.h>
+#include <yarpWholeBodyInterface/yarpWbiUtil.h>
+
+#include <yarp/os/Network.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Time.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace yarp::os;
+using namespace wbi;
+using namespace yarpWbi;
+
+const double TOL = 1e-8;
+const int NR_OF_BENCHMARK_ITERATIONS = 10000;
+
+const char * FAKE_ROBOT_CONFIGURATION =
+"robot fakeRobot\n"
+"controlBoardDevice fakeControlBoard\n"
+"[WBI_YARP_JOINTS]\n"
+"torso_yaw     = (torso,0)\n"
+"torso_roll    = (torso,1)\n"
+"torso_pitch   = (torso,2)\n"
+"l_hip_pitch   = (left_leg,0)\n"
+"l_hip_roll    = (left_leg,1)\n"
+"l_hip_yaw     = (left_leg,2)\n"
+"l_knee        = (left_leg,3)\n"
+"l_ankle_pitch = (left_leg,4)\n"
+"l_ankle_roll  = (left_leg,5)\n"
+"[WBI_ID_LISTS]\n"
+"FAKE_ROBOT_JOINTS = (torso_yaw,torso_roll,torso_pitch,l_hip_pitch,l_hip_roll,l_hip_yaw,l_knee,l_ankle_pitch,l_ankle_roll)\n";
+
+int main(int argc, char * argv[])
+{
+    Network::setLocalMode(true);
+    Network yarpNet;
+
+    Property cmdOptions;
+    cmdOptions.fromCommand(argc,argv);
+
+    fakeControlBoardConfiguration torsoConf, legConf;
+    torsoConf.nrOfAxes = 3;
+    legConf.nrOfAxes = 6;
+    legConf.readLatency = torsoConf.readLatency = cmdOptions.check("readLatency",Value(0.0)).asDouble();
+    legConf.commandLatency = torsoConf.commandLatency = cmdOptions.check("commandLatency",Value(0.0)).asDouble();
+    fakeControlBoard::setPartConfiguration("fakeRobot","torso",torsoConf);
+    fakeControlBoard::setPartConfiguration("fakeRobot","left_leg",legConf);
+    registerFakeControlBoardDevice();
+
+    Property yarpWbiOptions;
+    yarpWbiOptions.fromConfig(FAKE_ROBOT_CONFIGURATION);
+
+    IDList joints;
+    if( !loadIdListFromConfig("FAKE_ROBOT_JOINTS",yarpWbiOptions,joints) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyFakeRobotTest: impossible to load the joint list\n");
+        return EXIT_FAILURE;
+    }
+    int dof = joints.size();
+
+    yarpWholeBodySensors sensors("fakeRobotTestSensors",yarpWbiOptions);
+    yarpWholeBodyActuators actuators("fakeRobotTestActuators",yarpWbiOptions);
+    sensors.addSensors(SENSOR_ENCODER_POS,joints);
+    actuators.addActuators(joints);
+
+    if( !sensors.init() || !actuators.init() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyFakeRobotTest: impossible to open the fake robot\n");
+        return EXIT_FAILURE;
+    }
+
+    // Position direct references should be read back by the encoders
+    std::vector<double> qRef(dof), q(dof);
+    for(int i = 0; i < dof; i++)
+    {
+        qRef[i] = 0.1*(i+1);
+    }
+
+    bool ok = actuators.setControlMode(CTRL_MODE_DIRECT_POSITION);
+    ok = ok && actuators.setControlReference(&qRef[0]);
+    Time::delay(2*legConf.updatePeriod);
+    ok = ok && sensors.readSensors(SENSOR_ENCODER_POS,&q[0],0,false);
+
+    if( !ok )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyFakeRobotTest: error in commanding or reading the fake robot\n");
+        return EXIT_FAILURE;
+    }
+
+    for(int i = 0; i < dof; i++)
+    {
+        if( fabs(q[i]-qRef[i]) > TOL )
+        {
+            fprintf(stderr,"[ERR] yarpWholeBodyFakeRobotTest: joint %d is at %lf instead of %lf\n",i,q[i],qRef[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Overhead of the wrapper
+    double tic = Time::now();
+    for(int it = 0; it < NR_OF_BENCHMARK_ITERATIONS; it++)
+    {
+        sensors.readSensors(SENSOR_ENCODER_POS,&q[0],0,false);
+    }
+    double readTime = (Time::now()-tic)/NR_OF_BENCHMARK_ITERATIONS;
+
+    tic = Time::now();
+    for(int it = 0; it < NR_OF_BENCHMARK_ITERATIONS; it++)
+    {
+        actuators.setControlReference(&qRef[0]);
+    }
+    double commandTime = (Time::now()-tic)/NR_OF_BENCHMARK_ITERATIONS;
+
+    printf("yarpWholeBodyFakeRobotTest: %d joints, %d iterations\n",dof,NR_OF_BENCHMARK_ITERATIONS);
+    printf("    readSensors(SENSOR_ENCODER_POS): %lf us per call\n",readTime*1e6);
+    printf("    setControlReference:             %lf us per call\n",commandTime*1e6);
+
+    ok = actuators.close();
+    ok = sensors.close() && ok;
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
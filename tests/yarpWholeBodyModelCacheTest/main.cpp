@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+ * Save a small KDL tree in the binary model cache, load it back and check
+ * that the loaded tree is the saved one, and that the caches of a different
+ * URDF or truncated caches are refused.
+ * Then initialize yarpWholeBodyModel twice with modelCacheDirectory, writing
+ * the cache and loading it, and check that the two models are the same.
+ */
+
+#include <yarpWholeBodyInterface/yarpWholeBodyModelCache.h>
+#include <yarpWholeBodyInterface/yarpWholeBodyModel.h>
+#include <yarpWholeBodyInterface/yarpWbiUtil.h>
+
+#include <yarp/os/Property.h>
+#include <yarp/os/ResourceFinder.h>
+
+#include <wbi/wbiUtil.h>
+
+#include <kdl/tree.hpp>
+#include <kdl/segment.hpp>
+#include <kdl/joint.hpp>
+#include <kdl/frames.hpp>
+#include <kdl/rigidbodyinertia.hpp>
+#include <kdl/rotationalinertia.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace yarpWbi;
+
+const double TOL = 1e-12;
+const unsigned long long URDF_HASH = 0x0123456789abcdefULL;
+const char * CACHE_FILE = "yarpWholeBodyModelCacheTest.bin";
+const char * TRUNCATED_CACHE_FILE = "yarpWholeBodyModelCacheTest_truncated.bin";
+const char * HASHED_FILE = "yarpWholeBodyModelCacheTest_hash.txt";
+const char * MODEL_CACHE_DIRECTORY = ".";
+
+/**
+ * Tree with a revolute and a prismatic joint in a chain, and a fixed joint on another branch.
+ */
+KDL::Tree buildTestTree()
+{
+    KDL::Tree tree("root_link");
+
+    KDL::RigidBodyInertia inertia1(1.5,KDL::Vector(0.1,0.0,-0.05),KDL::RotationalInertia(0.01,0.02,0.03,0.001,0.0,0.002));
+    KDL::Segment link1("link1",
+                       KDL::Joint("joint1",KDL::Vector(0.0,0.0,0.1),KDL::Vector(0.0,0.0,1.0),KDL::Joint::RotAxis),
+                       KDL::Frame(KDL::Rotation::RPY(0.1,0.2,0.3),KDL::Vector(0.0,0.0,0.2)),
+                       inertia1);
+
+    KDL::RigidBodyInertia inertia2(0.7,KDL::Vector(0.0,0.02,0.0),KDL::RotationalInertia(0.004,0.005,0.006,0.0,0.0001,0.0));
+    KDL::Segment link2("link2",
+                       KDL::Joint("joint2",KDL::Vector(0.05,0.0,0.0),KDL::Vector(1.0,0.0,0.0),KDL::Joint::TransAxis),
+                       KDL::Frame(KDL::Vector(0.3,0.0,0.0)),
+                       inertia2);
+
+    KDL::RigidBodyInertia inertia3(0.2,KDL::Vector(0.0,0.0,0.01),KDL::RotationalInertia(0.001,0.001,0.001,0.0,0.0,0.0));
+    KDL::Segment link3("link3",
+                       KDL::Joint("fixed3",KDL::Joint::None),
+                       KDL::Frame(KDL::Rotation::RotX(M_PI/2),KDL::Vector(0.0,-0.1,0.0)),
+                       inertia3);
+
+    tree.addSegment(link1,"root_link");
+    tree.addSegment(link2,"link1");
+    tree.addSegment(link3,"root_link");
+    return tree;
+}
+
+bool checkEqual(const std::string & what, const double * expected, const double * actual, const int size)
+{
+    for(int i = 0; i < size; i++)
+    {
+        if( fabs(expected[i]-actual[i]) > TOL )
+        {
+            fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: element %d of %s is %lf instead of %lf\n",
+                    i,what.c_str(),actual[i],expected[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkSegment(const KDL::Segment & expected, const KDL::Segment & actual)
+{
+    const std::string & name = expected.getName();
+    const KDL::Joint & expectedJoint = expected.getJoint();
+    const KDL::Joint & actualJoint = actual.getJoint();
+    if( actualJoint.getName() != expectedJoint.getName() || actualJoint.getType() != expectedJoint.getType() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: the joint of %s is %s instead of %s\n",
+                name.c_str(),actualJoint.getName().c_str(),expectedJoint.getName().c_str());
+        return false;
+    }
+
+    // the pose of the segment depends on the joint origin and axis and on the frame to the tip
+    const double q = 0.3;
+    KDL::Frame expectedPose = expected.pose(q), actualPose = actual.pose(q);
+    bool ok = checkEqual("position of "+name,expectedPose.p.data,actualPose.p.data,3);
+    ok = ok && checkEqual("rotation of "+name,expectedPose.M.data,actualPose.M.data,9);
+
+    const KDL::RigidBodyInertia & expectedInertia = expected.getInertia();
+    const KDL::RigidBodyInertia & actualInertia = actual.getInertia();
+    double expectedMass = expectedInertia.getMass(), actualMass = actualInertia.getMass();
+    ok = ok && checkEqual("mass of "+name,&expectedMass,&actualMass,1);
+    ok = ok && checkEqual("center of mass of "+name,expectedInertia.getCOG().data,actualInertia.getCOG().data,3);
+    ok = ok && checkEqual("inertia of "+name,expectedInertia.getRotationalInertia().data,
+                          actualInertia.getRotationalInertia().data,9);
+    return ok;
+}
+
+/**
+ * Check that the trees have the same segments, with the same children.
+ */
+bool checkTree(const KDL::Tree & expected, const KDL::Tree & actual)
+{
+    if( actual.getRootSegment()->first != expected.getRootSegment()->first
+        || actual.getNrOfSegments() != expected.getNrOfSegments()
+        || actual.getNrOfJoints() != expected.getNrOfJoints() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: the loaded tree has root %s, %d segments and %d joints\n",
+                actual.getRootSegment()->first.c_str(),(int)actual.getNrOfSegments(),(int)actual.getNrOfJoints());
+        return false;
+    }
+
+    const KDL::SegmentMap & expectedSegments = expected.getSegments();
+    const KDL::SegmentMap & actualSegments = actual.getSegments();
+    bool ok = true;
+    for(KDL::SegmentMap::const_iterator segment = expectedSegments.begin(); ok && segment != expectedSegments.end(); segment++ )
+    {
+        KDL::SegmentMap::const_iterator loaded = actualSegments.find(segment->first);
+        if( loaded == actualSegments.end() || loaded->second.children.size() != segment->second.children.size() )
+        {
+            fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: segment %s not loaded, or loaded with other children\n",
+                    segment->first.c_str());
+            return false;
+        }
+        for(size_t child = 0; ok && child < segment->second.children.size(); child++ )
+        {
+            const std::string & childName = segment->second.children[child]->first;
+            bool found = false;
+            for(size_t loadedChild = 0; loadedChild < loaded->second.children.size(); loadedChild++ )
+            {
+                found = found || (loaded->second.children[loadedChild]->first == childName);
+            }
+            if( !found )
+            {
+                fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: %s is not a child of %s in the loaded tree\n",
+                        childName.c_str(),segment->first.c_str());
+                ok = false;
+            }
+        }
+        if( segment != expected.getRootSegment() )
+        {
+            ok = ok && checkSegment(segment->second.segment,loaded->second.segment);
+        }
+    }
+    return ok;
+}
+
+/**
+ * Copy the first half of a file in another file.
+ */
+bool truncateCopy(const char * from, const char * to)
+{
+    FILE * in = fopen(from,"rb");
+    if( !in )
+    {
+        return false;
+    }
+    std::vector<char> content;
+    int c;
+    while( (c = fgetc(in)) != EOF )
+    {
+        content.push_back((char)c);
+    }
+    fclose(in);
+
+    FILE * out = fopen(to,"wb");
+    if( !out )
+    {
+        return false;
+    }
+    bool ok = fwrite(&(content[0]),1,content.size()/2,out) == content.size()/2;
+    return (fclose(out) == 0) && ok;
+}
+
+bool testModelCache()
+{
+    KDL::Tree tree = buildTestTree();
+    std::vector<double> jointBoundMin(2), jointBoundMax(2);
+    jointBoundMin[0] = -1.0; jointBoundMax[0] = 1.5;
+    jointBoundMin[1] = -0.1; jointBoundMax[1] = 0.2;
+
+    if( !saveModelCache(CACHE_FILE,URDF_HASH,tree,jointBoundMin,jointBoundMax) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: impossible to save the cache\n");
+        return false;
+    }
+
+    KDL::Tree loadedTree;
+    std::vector<double> loadedBoundMin, loadedBoundMax;
+    if( !loadModelCache(CACHE_FILE,URDF_HASH,loadedTree,loadedBoundMin,loadedBoundMax) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: impossible to load the cache\n");
+        return false;
+    }
+
+    bool ok = checkTree(tree,loadedTree);
+    if( loadedBoundMin.size() != jointBoundMin.size() || loadedBoundMax.size() != jointBoundMax.size() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: %d joint limits loaded instead of %d\n",
+                (int)loadedBoundMin.size(),(int)jointBoundMin.size());
+        return false;
+    }
+    ok = ok && checkEqual("minimum joint limits",&(jointBoundMin[0]),&(loadedBoundMin[0]),jointBoundMin.size());
+    ok = ok && checkEqual("maximum joint limits",&(jointBoundMax[0]),&(loadedBoundMax[0]),jointBoundMax.size());
+
+    // the cache of another URDF, or a partial cache, should not be loaded
+    if( loadModelCache(CACHE_FILE,URDF_HASH+1,loadedTree,loadedBoundMin,loadedBoundMax) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: the cache of another URDF was loaded\n");
+        ok = false;
+    }
+    if( !truncateCopy(CACHE_FILE,TRUNCATED_CACHE_FILE)
+        || loadModelCache(TRUNCATED_CACHE_FILE,URDF_HASH,loadedTree,loadedBoundMin,loadedBoundMax) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: a truncated cache was loaded\n");
+        ok = false;
+    }
+
+    remove(CACHE_FILE);
+    remove(TRUNCATED_CACHE_FILE);
+    return ok;
+}
+
+/**
+ * The hash of the URDF is the 64 bit FNV-1a hash of its content.
+ */
+bool testFileHash()
+{
+    FILE * file = fopen(HASHED_FILE,"wb");
+    if( !file || fputs("a",file) < 0 || fclose(file) != 0 )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: impossible to write %s\n",HASHED_FILE);
+        return false;
+    }
+
+    unsigned long long hash = 0;
+    bool ok = computeFileHash(HASHED_FILE,hash) && hash == 0xaf63dc4c8601ec8cULL;
+    ok = ok && getModelCacheFileName("cache",hash) == "cache/yarpWholeBodyModel-af63dc4c8601ec8c.bin";
+    if( !ok )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: wrong hash %016llx of %s\n",hash,HASHED_FILE);
+    }
+
+    remove(HASHED_FILE);
+    return ok;
+}
+
+/**
+ * Quantities compared between the model parsed from the urdf and the one loaded from the cache.
+ */
+struct modelOutputs
+{
+    int nrOfDOFs;
+    std::vector<double> jointLimitsMin;
+    std::vector<double> jointLimitsMax;
+    std::vector<double> comJacobian;
+    std::vector<double> massMatrix;
+};
+
+bool computeModelOutputs(const yarp::os::Property & yarpWbiOptions, const wbi::IDList & joints, modelOutputs & outputs)
+{
+    yarpWbi::yarpWholeBodyModel model("yarpWholeBodyModelCacheTest",yarpWbiOptions);
+    model.addJoints(joints);
+    if( !model.init() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: impossible to initialize yarpWholeBodyModel\n");
+        return false;
+    }
+
+    int n = model.getDoFs();
+    outputs.nrOfDOFs = n;
+    outputs.jointLimitsMin.resize(n);
+    outputs.jointLimitsMax.resize(n);
+    outputs.comJacobian.resize(6*(6+n));
+    outputs.massMatrix.resize((6+n)*(6+n));
+
+    // a configuration far from the zero one, so that all the joints and the base pose matter
+    std::vector<double> q(n);
+    for(int i = 0; i < n; i++)
+    {
+        q[i] = 0.5*sin(1.0+i);
+    }
+    wbi::Frame xB(wbi::Rotation::RPY(0.1,-0.2,0.3));
+    xB.p[0] = 0.1; xB.p[1] = -0.2; xB.p[2] = 0.5;
+
+    bool ok = model.getJointLimits(&(outputs.jointLimitsMin[0]),&(outputs.jointLimitsMax[0]));
+    ok = ok && model.computeJacobian(&(q[0]),xB,wbi::iWholeBodyModel::COM_LINK_ID,&(outputs.comJacobian[0]));
+    ok = ok && model.computeMassMatrix(&(q[0]),xB,&(outputs.massMatrix[0]));
+    if( !ok )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: impossible to compute the outputs of yarpWholeBodyModel\n");
+    }
+    model.close();
+    return ok;
+}
+
+bool testModelInitFromCache()
+{
+    yarp::os::ResourceFinder rf;
+    yarp::os::Property yarpWbiOptions;
+    yarpWbiOptions.fromConfigFile(rf.findFile("yarpWholeBodyInterface.ini"));
+    // the limits stored in the cache are the ones of the urdf
+    yarpWbiOptions.unput("getLimitsFromControlBoard");
+    yarpWbiOptions.put("modelCacheDirectory",MODEL_CACHE_DIRECTORY);
+
+    wbi::IDList joints;
+    if( !yarpWbi::loadIdListFromConfig("ROBOT_DYNAMIC_MODEL_JOINTS",yarpWbiOptions,joints) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: impossible to load the ROBOT_DYNAMIC_MODEL_JOINTS list\n");
+        return false;
+    }
+
+    unsigned long long urdfHash = 0;
+    if( !computeFileHash(rf.findFile(yarpWbiOptions.find("urdf").asString().c_str()),urdfHash) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: impossible to read the urdf\n");
+        return false;
+    }
+    std::string cacheFile = getModelCacheFileName(MODEL_CACHE_DIRECTORY,urdfHash);
+    remove(cacheFile.c_str());
+
+    // the first model parses the urdf and writes the cache, the second one loads it
+    modelOutputs fromUrdf, fromCache;
+    if( !computeModelOutputs(yarpWbiOptions,joints,fromUrdf) )
+    {
+        return false;
+    }
+    FILE * cache = fopen(cacheFile.c_str(),"rb");
+    if( !cache )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: the cache %s was not written\n",cacheFile.c_str());
+        return false;
+    }
+    fclose(cache);
+    if( !computeModelOutputs(yarpWbiOptions,joints,fromCache) )
+    {
+        remove(cacheFile.c_str());
+        return false;
+    }
+
+    bool ok = true;
+    if( fromCache.nrOfDOFs != fromUrdf.nrOfDOFs )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyModelCacheTest: the model loaded from the cache has %d DOFs instead of %d\n",
+                fromCache.nrOfDOFs,fromUrdf.nrOfDOFs);
+        ok = false;
+    }
+    ok = ok && checkEqual("minimum joint limits of the model",&(fromUrdf.jointLimitsMin[0]),&(fromCache.jointLimitsMin[0]),fromUrdf.nrOfDOFs);
+    ok = ok && checkEqual("maximum joint limits of the model",&(fromUrdf.jointLimitsMax[0]),&(fromCache.jointLimitsMax[0]),fromUrdf.nrOfDOFs);
+    ok = ok && checkEqual("com jacobian",&(fromUrdf.comJacobian[0]),&(fromCache.comJacobian[0]),fromUrdf.comJacobian.size());
+    ok = ok && checkEqual("mass matrix",&(fromUrdf.massMatrix[0]),&(fromCache.massMatrix[0]),fromUrdf.massMatrix.size());
+
+    remove(cacheFile.c_str());
+    return ok;
+}
+
+int main(int argc, char * argv[])
+{
+    bool ok = testModelCache();
+    ok = testFileHash() && ok;
+    ok = testModelInitFromCache() && ok;
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
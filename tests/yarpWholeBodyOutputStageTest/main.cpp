@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+ * Tests of the filters and of the decimation of referenceOutputStage,
+ * driven with an explicit time so that the expected outputs are exact.
+ */
+
+#include <yarpWholeBodyInterface/yarpWholeBodyOutputStage.h>
+
+#include <yarp/os/Bottle.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace yarpWbi;
+
+const double TOL = 1e-9;
+const double DT = 0.001;
+
+bool checkEqual(const char * test, const char * what, const double expected, const double actual)
+{
+    if( fabs(expected-actual) > TOL )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyOutputStageTest: %s: %s is %lf instead of %lf\n",test,what,actual,expected);
+        return false;
+    }
+    return true;
+}
+
+bool configure(const char * test, referenceOutputStage & stage, const char * options, const int nrOfJoints)
+{
+    yarp::os::Bottle actuators_opt_bot;
+    actuators_opt_bot.fromString(options);
+    if( !stage.configure(actuators_opt_bot,nrOfJoints) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyOutputStageTest: %s: impossible to configure the stage with %s\n",test,options);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * A step of the references is followed at the maximum rate, with a different rate
+ * for each joint, and the output stops on the reference.
+ * After resetJoint the output of the joint jumps to the new reference.
+ */
+bool testMaxRate()
+{
+    const char * test = "max rate";
+    referenceOutputStage stage;
+    if( !configure(test,stage,"(referenceMaxRate (2.0 4.0))",2) )
+    {
+        return false;
+    }
+
+    double zero[2] = { 0.0, 0.0 };
+    double step[2] = { 1.0, -1.0 };
+    double time = 0.0;
+    const double * output = stage.process(zero,time);
+    bool ok = checkEqual(test,"initial output",0.0,output[0]);
+
+    for(int k = 1; k <= 100; k++)
+    {
+        time += DT;
+        output = stage.process(step,time);
+    }
+    ok = ok && checkEqual(test,"output of joint 0",2.0*100*DT,output[0]);
+    ok = ok && checkEqual(test,"output of joint 1",-4.0*100*DT,output[1]);
+
+    for(int k = 101; k <= 1000; k++)
+    {
+        time += DT;
+        output = stage.process(step,time);
+    }
+    ok = ok && checkEqual(test,"final output of joint 0",step[0],output[0]);
+    ok = ok && checkEqual(test,"final output of joint 1",step[1],output[1]);
+
+    double newReference[2] = { 0.0, 0.0 };
+    stage.resetJoint(0);
+    time += DT;
+    output = stage.process(newReference,time);
+    ok = ok && checkEqual(test,"output of the reset joint",newReference[0],output[0]);
+    ok = ok && checkEqual(test,"output of the other joint",step[1]+4.0*DT,output[1]);
+
+    return ok;
+}
+
+/**
+ * Without rate limits the output is the first order response to the step.
+ */
+bool testSmoothing()
+{
+    const char * test = "smoothing";
+    const double timeConstant = 0.05;
+    referenceOutputStage stage;
+    if( !configure(test,stage,"(referenceSmoothingTimeConstant 0.05)",1) )
+    {
+        return false;
+    }
+
+    double reference = 0.0;
+    double time = 0.0;
+    stage.process(&reference,time);
+
+    reference = 1.0;
+    const double * output = 0;
+    const int nrOfSteps = 50;
+    for(int k = 1; k <= nrOfSteps; k++)
+    {
+        time += DT;
+        output = stage.process(&reference,time);
+    }
+
+    // discrete time response of smoothed += dt/(tau+dt)*(reference-smoothed)
+    double expected = 1.0 - pow(timeConstant/(timeConstant+DT),nrOfSteps);
+    return checkEqual(test,"output",expected,output[0]);
+}
+
+/**
+ * With a limited acceleration the output reaches the reference without
+ * overshooting it, and neither its rate nor its acceleration exceed the limits.
+ */
+bool testMaxAcceleration()
+{
+    const char * test = "max acceleration";
+    const double maxRate = 1.0, maxAcceleration = 10.0;
+    referenceOutputStage stage;
+    if( !configure(test,stage,"(referenceMaxRate 1.0) (referenceMaxAcceleration 10.0)",1) )
+    {
+        return false;
+    }
+
+    double reference = 0.0;
+    double time = 0.0;
+    stage.process(&reference,time);
+
+    reference = 0.5;
+    double lastOutput = 0.0, lastVelocity = 0.0;
+    bool ok = true;
+    for(int k = 1; ok && k <= 2000; k++)
+    {
+        time += DT;
+        double output = stage.process(&reference,time)[0];
+        double velocity = (output-lastOutput)/DT;
+        if( output > reference + TOL )
+        {
+            fprintf(stderr,"[ERR] yarpWholeBodyOutputStageTest: %s: the output overshoots to %lf\n",test,output);
+            ok = false;
+        }
+        if( fabs(velocity) > maxRate*(1.0+1e-6) )
+        {
+            fprintf(stderr,"[ERR] yarpWholeBodyOutputStageTest: %s: the rate is %lf\n",test,velocity);
+            ok = false;
+        }
+        if( fabs(velocity-lastVelocity) > maxAcceleration*DT*(1.0+1e-6) )
+        {
+            fprintf(stderr,"[ERR] yarpWholeBodyOutputStageTest: %s: the acceleration is %lf\n",test,(velocity-lastVelocity)/DT);
+            ok = false;
+        }
+        lastOutput = output;
+        lastVelocity = velocity;
+    }
+
+    return ok && checkEqual(test,"final output",reference,lastOutput);
+}
+
+/**
+ * The references are sent once every referenceDecimation calls, starting from the first one.
+ */
+bool testDecimation()
+{
+    const char * test = "decimation";
+    referenceOutputStage stage;
+    if( !configure(test,stage,"(referenceDecimation 3)",1) )
+    {
+        return false;
+    }
+
+    bool ok = stage.isEnabled() && !stage.isFiltering();
+    for(int k = 0; ok && k < 9; k++)
+    {
+        if( stage.decimationTick() != (k % 3 == 0) )
+        {
+            fprintf(stderr,"[ERR] yarpWholeBodyOutputStageTest: %s: wrong decimation at call %d\n",test,k);
+            ok = false;
+        }
+    }
+
+    stage.decimationTick();
+    stage.reset();
+    ok = ok && stage.decimationTick();
+
+    // not valid options
+    yarp::os::Bottle notValidOptions;
+    notValidOptions.fromString("(referenceDecimation 0)");
+    ok = ok && !stage.configure(notValidOptions,1);
+    notValidOptions.fromString("(referenceMaxRate (1.0 2.0 3.0))");
+    ok = ok && !stage.configure(notValidOptions,2);
+
+    if( !ok )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodyOutputStageTest: %s failed\n",test);
+    }
+    return ok;
+}
+
+int main(int argc, char * argv[])
+{
+    bool ok = testMaxRate();
+    ok = testSmoothing() && ok;
+    ok = testMaxAcceleration() && ok;
+    ok = testDecimation() && ok;
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2016 RBCS Department & iCub Facility - Istituto Italiano di Tecnologia
+ * Author: Silvio Traversaro
+ * email: silvio.traversaro@iit.it
+ *
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+ * Record the readings of the in-process fakeControlBoard (and of a fake IMU port)
+ * with the sensorsLogFile option of yarpWholeBodySensors, and check that
+ * yarpWholeBodySensorsReplay returns the same readings.
+ */
+
+#include "fakeControlBoard.h"
+
+#include <yarpWholeBodyInterface/yarpWholeBodySensors.h>
+#include <yarpWholeBodyInterface/yarpWholeBodySensorsReplay.h>
+#include <yarpWholeBodyInterface/yarpWholeBodyActuators.h>
+#include <yarpWholeBodyInterface/yarpWbiUtil.h>
+
+#include <yarp/os/Network.h>
+#include <yarp/os/Property.h>
+#include <yarp/os/Time.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace yarp::os;
+using namespace wbi;
+using namespace yarpWbi;
+
+const double TOL = 1e-12;
+const int NR_OF_RECORDED_READINGS = 20;
+const int IMU_PORT_PERIOD_IN_MS = 1;
+const int YARP_IMU_READING_SIZE = 12;
+
+const char * FAKE_ROBOT_CONFIGURATION =
+"robot fakeRobot\n"
+"controlBoardDevice fakeControlBoard\n"
+"[WBI_YARP_JOINTS]\n"
+"torso_yaw     = (torso,0)\n"
+"torso_roll    = (torso,1)\n"
+"torso_pitch   = (torso,2)\n"
+"[WBI_YARP_IMU_PORTS]\n"
+"root_link_imu /inertial\n"
+"[WBI_YARP_ACCELEROMETERS]\n"
+"root_link_imu_acc (imu,root_link_imu)\n"
+"[WBI_ID_LISTS]\n"
+"REPLAY_TEST_JOINTS = (torso_yaw,torso_roll,torso_pitch)\n";
+
+struct recordedReadings
+{
+    std::vector< std::vector<double> > q, imu, acc;
+    double qSingle; // reading of the second joint obtained with readSensor after all the other readings
+};
+
+Property getOptions(const std::string & sensorsOptions)
+{
+    Property options;
+    options.fromConfig((std::string(FAKE_ROBOT_CONFIGURATION) + "[WBI_SENSORS_OPTIONS]\n" + sensorsOptions).c_str());
+    return options;
+}
+
+bool checkEqual(const char * what, const int reading, const double * expected, const double * actual, const int size)
+{
+    for(int i = 0; i < size; i++)
+    {
+        if( fabs(expected[i]-actual[i]) > TOL )
+        {
+            fprintf(stderr,"[ERR] yarpWholeBodySensorsReplayTest: element %d of %s reading %d is %lf instead of %lf\n",
+                    i,what,reading,actual[i],expected[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Move the fake robot and record its readings in logFile.
+ * If readAccelerometers is false only the IMUs are read, so the accelerometers
+ * have no records in the log.
+ */
+bool record(const std::string & logFile, const bool readAccelerometers, fakeSensorPort & imuPort,
+            recordedReadings & readings)
+{
+    Property options = getOptions("sensorsLogFile " + logFile + "\nsensorsLogMaxSizeInMB 1\n");
+
+    IDList joints;
+    if( !loadIdListFromConfig("REPLAY_TEST_JOINTS",options,joints) )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodySensorsReplayTest: impossible to load the joint list\n");
+        return false;
+    }
+
+    yarpWholeBodySensors sensors("replayTestRecorder",options);
+    yarpWholeBodyActuators actuators("replayTestActuators",options);
+    sensors.addSensors(SENSOR_ENCODER_POS,joints);
+    sensors.addSensor(SENSOR_ACCELEROMETER,ID("root_link_imu_acc"));
+    actuators.addActuators(joints);
+
+    if( !sensors.init() || !actuators.init() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodySensorsReplayTest: impossible to open the fake robot\n");
+        return false;
+    }
+
+    int dof = joints.size();
+    int nrOfImus = sensors.getSensorNumber(SENSOR_IMU);
+    if( nrOfImus != 1 )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodySensorsReplayTest: the IMU of the accelerometer was not added\n");
+        return false;
+    }
+
+    std::vector<double> qRef(dof), imuMeasure(YARP_IMU_READING_SIZE);
+    bool ok = actuators.setControlMode(CTRL_MODE_DIRECT_POSITION);
+    for(int k = 0; ok && k < NR_OF_RECORDED_READINGS; k++)
+    {
+        for(int i = 0; i < dof; i++)
+        {
+            qRef[i] = 0.01*(k+1)*(i+1);
+        }
+        for(int i = 0; i < YARP_IMU_READING_SIZE; i++)
+        {
+            imuMeasure[i] = 0.001*(k+1)*(i+1);
+        }
+        imuPort.setMeasure(yarp::sig::Vector(YARP_IMU_READING_SIZE,&imuMeasure[0]));
+
+        ok = ok && actuators.setControlReference(&qRef[0]);
+        Time::delay(0.002);
+
+        readings.q.push_back(std::vector<double>(dof));
+        readings.imu.push_back(std::vector<double>(sensorTypeDescriptions[SENSOR_IMU].dataSize*nrOfImus));
+        ok = ok && sensors.readSensors(SENSOR_ENCODER_POS,&(readings.q.back()[0]),0,false);
+        ok = ok && sensors.readSensors(SENSOR_IMU,&(readings.imu.back()[0]),0,true);
+        if( readAccelerometers )
+        {
+            readings.acc.push_back(std::vector<double>(sensorTypeDescriptions[SENSOR_ACCELEROMETER].dataSize));
+            ok = ok && sensors.readSensors(SENSOR_ACCELEROMETER,&(readings.acc.back()[0]),0,false);
+        }
+    }
+
+    // a single sensor reading is recorded as a record in which only that sensor changed
+    qRef[1] = -1.0;
+    ok = ok && actuators.setControlReference(&qRef[0]);
+    Time::delay(0.002);
+    ok = ok && sensors.readSensor(SENSOR_ENCODER_POS,1,&(readings.qSingle),0,false);
+
+    if( !ok )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodySensorsReplayTest: error in commanding or reading the fake robot\n");
+    }
+
+    ok = actuators.close() && ok;
+    ok = sensors.close() && ok;
+    return ok;
+}
+
+/**
+ * Replay logFile as fast as possible and check that the readings are the recorded ones.
+ */
+bool replay(const std::string & logFile, const recordedReadings & readings)
+{
+    Property options = getOptions("replayLogFile " + logFile + "\nreplayMode fast\n");
+
+    IDList joints;
+    loadIdListFromConfig("REPLAY_TEST_JOINTS",options,joints);
+
+    yarpWholeBodySensorsReplay sensors("replayTestPlayer",options);
+    sensors.addSensors(SENSOR_ENCODER_POS,joints);
+    sensors.addSensor(SENSOR_ACCELEROMETER,ID("root_link_imu_acc"));
+    if( !sensors.init() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodySensorsReplayTest: impossible to replay %s\n",logFile.c_str());
+        return false;
+    }
+
+    int dof = joints.size();
+    int imuSize = sensorTypeDescriptions[SENSOR_IMU].dataSize;
+    int accSize = sensorTypeDescriptions[SENSOR_ACCELEROMETER].dataSize;
+    if( sensors.getSensorNumber(SENSOR_IMU) != 1 )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodySensorsReplayTest: the replayed IMUs differ from the recorded ones\n");
+        return false;
+    }
+
+    std::vector<double> q(dof), imu(imuSize), acc(accSize);
+    bool ok = true;
+    for(int k = 0; ok && k < (int)readings.q.size(); k++)
+    {
+        ok = ok && sensors.readSensors(SENSOR_ENCODER_POS,&q[0]);
+        ok = ok && checkEqual("encoders",k,&(readings.q[k][0]),&q[0],dof);
+        ok = ok && sensors.readSensors(SENSOR_IMU,&imu[0]);
+        ok = ok && checkEqual("imu",k,&(readings.imu[k][0]),&imu[0],imuSize);
+        ok = ok && sensors.readSensors(SENSOR_ACCELEROMETER,&acc[0]);
+        if( readings.acc.size() > 0 )
+        {
+            ok = ok && checkEqual("accelerometer",k,&(readings.acc[k][0]),&acc[0],accSize);
+        }
+        else
+        {
+            // replayed from the IMU, as yarpWholeBodySensors::readAccelerometer does
+            ok = ok && checkEqual("accelerometer",k,&(readings.imu[k][5]),&acc[0],accSize);
+        }
+    }
+
+    std::vector<double> qExpected = readings.q.back();
+    qExpected[1] = readings.qSingle;
+    ok = ok && sensors.readSensors(SENSOR_ENCODER_POS,&q[0]);
+    ok = ok && checkEqual("single encoder",0,&qExpected[0],&q[0],dof);
+    ok = ok && sensors.isReplayFinished();
+
+    if( !ok )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodySensorsReplayTest: error in replaying %s\n",logFile.c_str());
+    }
+
+    return sensors.close() && ok;
+}
+
+int main(int argc, char * argv[])
+{
+    Network::setLocalMode(true);
+    Network yarpNet;
+
+    fakeControlBoardConfiguration torsoConf;
+    torsoConf.nrOfAxes = 3;
+    fakeControlBoard::setPartConfiguration("fakeRobot","torso",torsoConf);
+    registerFakeControlBoardDevice();
+
+    fakeSensorPort imuPort("/fakeRobot/inertial",IMU_PORT_PERIOD_IN_MS,YARP_IMU_READING_SIZE);
+    if( !imuPort.start() )
+    {
+        fprintf(stderr,"[ERR] yarpWholeBodySensorsReplayTest: impossible to open the fake IMU port\n");
+        return EXIT_FAILURE;
+    }
+
+    recordedReadings withAccelerometers, withoutAccelerometers;
+    bool ok = record("yarpWholeBodySensorsReplayTest_acc.log",true,imuPort,withAccelerometers)
+              && replay("yarpWholeBodySensorsReplayTest_acc.log",withAccelerometers);
+    ok = ok && record("yarpWholeBodySensorsReplayTest_imu.log",false,imuPort,withoutAccelerometers)
+            && replay("yarpWholeBodySensorsReplayTest_imu.log",withoutAccelerometers);
+
+    imuPort.stop();
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}